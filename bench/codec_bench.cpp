@@ -0,0 +1,309 @@
+/**
+ * Benchmark do codec de cabeçalhos: compara, em ns por pacote, o codec original (byte a byte,
+ * com um vetor alocado por pacote e o payload copiado nos dois sentidos), o lote escalar
+ * (encode_header/decode_into, um pacote por vez) e os lotes vetorizados (SSE4.1, AVX2) que a
+ * CPU suportar. Todos os pacotes levam um payload máximo; só o codec original o copia.
+ *
+ * Antes de medir, cada caminho passa por um teste de ida e volta sobre todas as combinações de
+ * valores de borda dos campos (inclusive sttl acima de 27 bits e flags acima de 5 bits, que
+ * devem ser truncados), comparando os bytes com os do encode_header e os campos decodificados
+ * com os esperados. Qualquer divergência encerra o programa com erro.
+ *
+ * Uso: slow_codec_bench [pacotes=5000000] [lote=256]
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include "../src/slow_codec.hpp"
+
+// --- Codec original, como era antes do SLOWPacketView (referência da medição) ---
+
+namespace original {
+
+struct Packet {
+    std::array<uint8_t, 16> sid;
+    uint8_t  flags;
+    uint32_t sttl;
+    uint32_t seqnum;
+    uint32_t acknum;
+    uint16_t window;
+    uint8_t  fid;
+    uint8_t  fo;
+    std::vector<uint8_t> data;
+
+    std::vector<uint8_t> serialize() const {
+        if (data.size() > 1440) {
+            throw std::runtime_error("O campo 'data' excede o limite máximo de 1440 bytes.");
+        }
+        std::vector<uint8_t> buf;
+        buf.reserve(32 + data.size());
+        buf.insert(buf.end(), sid.begin(), sid.end());
+        uint32_t sttl_flags = ((sttl & 0x07FFFFFF) << 5) | (flags & 0x1F);
+        for (int i = 0; i < 4; ++i) buf.push_back((sttl_flags >> (i * 8)) & 0xFF);
+        for (int i = 0; i < 4; ++i) buf.push_back((seqnum >> (i * 8)) & 0xFF);
+        for (int i = 0; i < 4; ++i) buf.push_back((acknum >> (i * 8)) & 0xFF);
+        uint32_t win_fid_fo = (static_cast<uint32_t>(fo) << 24) | (static_cast<uint32_t>(fid) << 16) | (window & 0xFFFF);
+        for (int i = 0; i < 4; ++i) buf.push_back((win_fid_fo >> (i * 8)) & 0xFF);
+        buf.insert(buf.end(), data.begin(), data.end());
+        return buf;
+    }
+
+    static Packet deserialize(const std::vector<uint8_t>& buf) {
+        if (buf.size() < 32) throw std::runtime_error("Buffer muito pequeno para o cabeçalho SLOW");
+        Packet pkt;
+        size_t offset = 0;
+        std::copy_n(buf.begin(), 16, pkt.sid.begin());
+        offset += 16;
+        uint32_t sttl_flags = 0;
+        std::memcpy(&sttl_flags, &buf[offset], 4);
+        pkt.flags = sttl_flags & 0x1F;
+        pkt.sttl = sttl_flags >> 5;
+        offset += 4;
+        std::memcpy(&pkt.seqnum, &buf[offset], 4);
+        offset += 4;
+        std::memcpy(&pkt.acknum, &buf[offset], 4);
+        offset += 4;
+        uint32_t win_fid_fo = 0;
+        std::memcpy(&win_fid_fo, &buf[offset], 4);
+        pkt.window = win_fid_fo & 0xFFFF;
+        pkt.fid = (win_fid_fo >> 16) & 0xFF;
+        pkt.fo = (win_fid_fo >> 24) & 0xFF;
+        offset += 4;
+        pkt.data.assign(buf.begin() + offset, buf.end());
+        return pkt;
+    }
+};
+
+} // namespace original
+
+static const CodecPath ALL_PATHS[] = {CodecPath::Scalar, CodecPath::Sse41, CodecPath::Avx2};
+
+// --- Ida e volta sobre os valores de borda ---
+
+static bool same_fields(const SLOWPacketView& a, const SLOWPacketView& b) {
+    return a.sid == b.sid && a.flags == b.flags && a.sttl == b.sttl && a.seqnum == b.seqnum
+        && a.acknum == b.acknum && a.window == b.window && a.fid == b.fid && a.fo == b.fo
+        && a.data.data() == b.data.data() && a.data.size() == b.data.size();
+}
+
+static void report(const char* what, CodecPath path, const SLOWPacketView& v) {
+    std::cerr << "[" << codec_path_name(path) << "] " << what << ": flags=" << int(v.flags) << " sttl=" << v.sttl
+              << " seqnum=" << v.seqnum << " acknum=" << v.acknum << " window=" << v.window
+              << " fid=" << int(v.fid) << " fo=" << int(v.fo) << std::endl;
+}
+
+// Verifica um lote: codifica com 'path', compara com o escalar e decodifica de volta.
+static bool check_chunk(CodecPath path, const std::vector<SLOWPacketView>& in,
+                        std::vector<std::array<uint8_t, SLOW_MAX_PACKET_SIZE>>& bufs) {
+    size_t n = in.size();
+    std::vector<uint8_t*> outs(n);
+    std::vector<ByteSpan> spans(n);
+    std::vector<SLOWPacketView> decoded(n);
+    std::array<uint8_t, SLOW_HEADER_SIZE> ref;
+    for (size_t i = 0; i < n; ++i) outs[i] = bufs[i].data();
+    encode_headers(in.data(), outs.data(), n, path);
+
+    for (size_t i = 0; i < n; ++i) {
+        in[i].encode_header(ref.data());
+        if (std::memcmp(ref.data(), outs[i], SLOW_HEADER_SIZE) != 0) {
+            report("bytes divergentes do encode_header", path, in[i]);
+            return false;
+        }
+        // Tamanhos de payload variados, inclusive vazio e máximo.
+        size_t payload = (i % 3 == 0) ? 0 : (i % 3 == 1) ? 1 : SLOW_MAX_DATA_SIZE;
+        spans[i] = {outs[i], SLOW_HEADER_SIZE + payload};
+    }
+
+    decode_headers(spans.data(), decoded.data(), n, path);
+    for (size_t i = 0; i < n; ++i) {
+        SLOWPacketView want = in[i];
+        want.sttl &= 0x07FFFFFF;
+        want.flags &= 0x1F;
+        want.data = spans[i].subspan(SLOW_HEADER_SIZE, spans[i].size() - SLOW_HEADER_SIZE);
+        if (!same_fields(want, decoded[i]) || !same_fields(decoded[i], SLOWPacketView::decode(spans[i].data(), spans[i].size()))) {
+            report("campos decodificados incorretos", path, in[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool round_trip(CodecPath path, uint64_t& checked) {
+    const uint32_t sttls[] = {0, 1, 0x03FFFFFF, 0x04000000, 0x07FFFFFF, 0x08000000, 0xFFFFFFFF};
+    const uint32_t seqs[] = {0, 1, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF};
+    const uint16_t windows[] = {0, 1, 0x7FFF, 0x8000, 0xFFFF};
+    const uint8_t bytes[] = {0, 1, 0x7F, 0x80, 0xFF};
+    std::vector<uint8_t> flags;
+    for (int f = 0; f < 32; ++f) flags.push_back(static_cast<uint8_t>(f));
+    flags.push_back(0x20);
+    flags.push_back(0xFF);
+
+    // Lote ímpar, para exercitar também o resto do laço de dois em dois do AVX2.
+    constexpr size_t CHUNK = 255;
+    std::vector<std::array<uint8_t, SLOW_MAX_PACKET_SIZE>> bufs(CHUNK);
+    std::vector<SLOWPacketView> chunk;
+    chunk.reserve(CHUNK);
+    uint64_t count = 0;
+    for (uint32_t sttl : sttls)
+    for (uint8_t f : flags)
+    for (uint32_t seq : seqs)
+    for (uint32_t ack : seqs)
+    for (uint16_t win : windows)
+    for (uint8_t fid : bytes)
+    for (uint8_t fo : bytes) {
+        SLOWPacketView v;
+        for (size_t k = 0; k < v.sid.size(); ++k) v.sid[k] = static_cast<uint8_t>(count * 31 + k * 17);
+        v.flags = f;
+        v.sttl = sttl;
+        v.seqnum = seq;
+        v.acknum = ack;
+        v.window = win;
+        v.fid = fid;
+        v.fo = fo;
+        chunk.push_back(v);
+        ++count;
+        if (chunk.size() == CHUNK) {
+            if (!check_chunk(path, chunk, bufs)) return false;
+            chunk.clear();
+        }
+    }
+    if (!chunk.empty() && !check_chunk(path, chunk, bufs)) return false;
+    checked = count;
+    return true;
+}
+
+// --- Medição ---
+
+static volatile uint64_t sink;
+
+// Impede o compilador de descartar 'v' (e o trabalho que o produziu), como o DoNotOptimize do
+// Google Benchmark.
+template <typename T>
+static void do_not_optimize(const T& v) {
+    asm volatile("" : : "r,m"(v) : "memory");
+}
+
+template <typename Fn>
+static double ns_per_packet(size_t total, size_t batch, Fn&& fn) {
+    size_t rounds = std::max<size_t>(1, total / batch);
+    fn(); // aquecimento
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; ++r) fn();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / (rounds * batch);
+}
+
+int main(int argc, char* argv[]) {
+    size_t total = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000000;
+    size_t batch = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 256;
+    if (batch == 0) {
+        std::cerr << "O lote deve ter ao menos um pacote." << std::endl;
+        return 1;
+    }
+
+    std::cout << "=== SLOW codec bench: " << total << " cabeçalhos em lotes de " << batch
+              << " | melhor caminho nesta CPU: " << codec_path_name(best_codec_path()) << " ===" << std::endl;
+
+    for (CodecPath path : ALL_PATHS) {
+        if (!codec_path_supported(path)) continue;
+        uint64_t checked = 0;
+        if (!round_trip(path, checked)) {
+            std::cerr << "Falha no teste de ida e volta do caminho " << codec_path_name(path) << std::endl;
+            return 1;
+        }
+        std::cout << "ida e volta " << std::left << std::setw(8) << codec_path_name(path) << std::right
+                  << ": " << checked << " combinações de borda OK" << std::endl;
+    }
+
+    // Cabeçalhos variados, com payload já posicionado no buffer (como na fila de retransmissão).
+    std::vector<SLOWPacketView> views(batch);
+    std::vector<original::Packet> packets(batch);
+    std::vector<std::array<uint8_t, SLOW_MAX_PACKET_SIZE>> bufs(batch);
+    std::vector<uint8_t*> outs(batch);
+    std::vector<ByteSpan> spans(batch);
+    std::vector<SLOWPacketView> decoded(batch);
+    for (size_t i = 0; i < batch; ++i) {
+        SLOWPacketView& v = views[i];
+        for (size_t k = 0; k < v.sid.size(); ++k) v.sid[k] = static_cast<uint8_t>(i + k);
+        v.flags = FLAG_ACK | (i % 2 ? FLAG_MORE_BITS : 0);
+        v.sttl = 30000 + static_cast<uint32_t>(i);
+        v.seqnum = 1000000 + static_cast<uint32_t>(i);
+        v.acknum = 2000000 + static_cast<uint32_t>(i);
+        v.window = static_cast<uint16_t>(23040 - i);
+        v.fid = static_cast<uint8_t>(i / 4);
+        v.fo = static_cast<uint8_t>(i % 4);
+        outs[i] = bufs[i].data();
+        for (size_t k = 0; k < SLOW_MAX_DATA_SIZE; ++k) outs[i][SLOW_HEADER_SIZE + k] = static_cast<uint8_t>(i * 7 + k);
+        v.data = {outs[i] + SLOW_HEADER_SIZE, SLOW_MAX_DATA_SIZE};
+        original::Packet& p = packets[i];
+        p.sid = v.sid;
+        p.flags = v.flags;
+        p.sttl = v.sttl;
+        p.seqnum = v.seqnum;
+        p.acknum = v.acknum;
+        p.window = v.window;
+        p.fid = v.fid;
+        p.fo = v.fo;
+        p.data.assign(v.data.begin(), v.data.end());
+        v.encode_header(outs[i]);
+        spans[i] = {outs[i], SLOW_MAX_PACKET_SIZE};
+    }
+
+    std::cout << std::left << std::setw(24) << "caminho" << std::right
+              << std::setw(16) << "encode ns/pkt" << std::setw(16) << "decode ns/pkt" << std::endl;
+    auto row = [](const std::string& name, double enc, double dec) {
+        std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(16) << enc << std::setw(16) << dec << std::endl;
+    };
+
+    // Codec original: um std::vector alocado por pacote em cada sentido, com o payload copiado.
+    // O resultado inteiro (tamanho e último byte do payload) é consumido, senão o compilador
+    // pode descartar a cópia.
+    std::vector<std::vector<uint8_t>> wire(batch);
+    for (size_t i = 0; i < batch; ++i) wire[i] = packets[i].serialize();
+    double enc = ns_per_packet(total, batch, [&] {
+        uint64_t acc = 0;
+        for (size_t i = 0; i < batch; ++i) {
+            std::vector<uint8_t> w = packets[i].serialize();
+            do_not_optimize(w.data());
+            acc += w.size() + w[16] + w.back();
+        }
+        do_not_optimize(acc);
+        sink = acc;
+    });
+    double dec = ns_per_packet(total, batch, [&] {
+        uint64_t acc = 0;
+        for (size_t i = 0; i < batch; ++i) {
+            original::Packet p = original::Packet::deserialize(wire[i]);
+            do_not_optimize(p.data.data());
+            acc += p.sid[0] + p.flags + p.sttl + p.seqnum + p.acknum + p.window + p.fid + p.fo + p.data.size() + p.data.data()[p.data.size() - 1];
+        }
+        do_not_optimize(acc);
+        sink = acc;
+    });
+    row("original (byte a byte)", enc, dec);
+
+    for (CodecPath path : ALL_PATHS) {
+        if (!codec_path_supported(path)) continue;
+        enc = ns_per_packet(total, batch, [&] {
+            encode_headers(views.data(), outs.data(), batch, path);
+            do_not_optimize(bufs.data());
+            sink = outs[batch - 1][16];
+        });
+        dec = ns_per_packet(total, batch, [&] {
+            decode_headers(spans.data(), decoded.data(), batch, path);
+            do_not_optimize(decoded.data());
+            const SLOWPacketView& p = decoded[batch - 1];
+            sink = p.sid[0] + p.flags + p.sttl + p.seqnum + p.acknum + p.window + p.fid + p.fo + p.data.size() + p.data.data()[p.data.size() - 1];
+        });
+        row(std::string("lote ") + codec_path_name(path), enc, dec);
+    }
+    return 0;
+}
@@ -0,0 +1,211 @@
+/**
+ * Benchmark ponta a ponta: peripheral (WorkerPool) contra o central local sobre loopback.
+ *
+ * O central roda numa thread do próprio processo. Cada sessão mantém 'pipeline' mensagens em
+ * trânsito e envia a próxima assim que uma é confirmada, até completar 'messages'; depois
+ * encerra. São reportados o goodput (bytes de mensagens confirmadas por segundo), os
+ * percentis da latência por mensagem (do send() até o ACK do último fragmento) e as
+ * retransmissões. Com --echo o central devolve cada mensagem, e a próxima só sai quando o eco
+ * chega: a latência passa a ser a de ida e volta e o goodput conta os dois sentidos.
+ * --cc escolhe o controle de congestionamento das sessões (none, o padrão, é o envio limitado
+ * só pela janela do central) e --no-pacing desliga o espaçamento dos envios. --record grava o
+ * trace do peripheral sobre o socket real, handshakes inclusive; o slow_sim --replay com a mesma
+ * carga o confere pacote a pacote.
+ *
+ * Uso: slow_bench [--sessions=8] [--messages=200] [--size=15000] [--pipeline=1] [--workers=1]
+ *                 [--window=23040] [--loss=0] [--io=auto] [--timeout=60] [--echo]
+ *                 [--cc=none|newreno|delay] [--no-pacing] [--record=ARQUIVO]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include "../src/central_server.hpp"
+#include "../src/congestion.hpp"
+#include "../src/worker_pool.hpp"
+
+struct BenchConfig {
+    size_t sessions = 8;
+    size_t messages = 200;
+    size_t size = 15000;
+    size_t pipeline = 1;
+    size_t workers = 1;
+    uint16_t window = 16 * 1440;
+    double loss = 0.0;
+    IOBackend backend = IOBackend::Auto;
+    int timeout_s = 60;
+    bool echo = false;
+    CongestionAlgorithm congestion = CongestionAlgorithm::None;
+    bool pacing = true;
+    std::string record_path;
+};
+
+// Mensagens ainda por enviar de cada sessão; só a thread do worker dono da sessão mexe nela.
+struct alignas(64) SessionProgress {
+    size_t remaining = 0;
+    size_t in_flight = 0;
+    std::vector<TimePoint> sent_at; // no modo eco, instante de envio de cada mensagem em trânsito
+};
+
+static bool parse_args(int argc, char* argv[], BenchConfig& cfg) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&](const char* prefix) -> const char* {
+            size_t n = std::char_traits<char>::length(prefix);
+            return arg.compare(0, n, prefix) == 0 ? argv[i] + n : nullptr;
+        };
+        if (const char* v = value("--sessions=")) cfg.sessions = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+        else if (const char* v = value("--messages=")) cfg.messages = std::strtoull(v, nullptr, 10);
+        else if (const char* v = value("--size=")) cfg.size = std::strtoull(v, nullptr, 10);
+        else if (const char* v = value("--pipeline=")) cfg.pipeline = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+        else if (const char* v = value("--workers=")) cfg.workers = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+        else if (const char* v = value("--window=")) cfg.window = static_cast<uint16_t>(std::strtoul(v, nullptr, 10));
+        else if (const char* v = value("--loss=")) cfg.loss = std::strtod(v, nullptr);
+        else if (const char* v = value("--timeout=")) cfg.timeout_s = std::atoi(v);
+        else if (arg == "--echo") cfg.echo = true;
+        else if (arg == "--no-pacing") cfg.pacing = false;
+        else if (const char* v = value("--record=")) cfg.record_path = v;
+        else if (const char* v = value("--cc=")) {
+            if (!parse_congestion_algorithm(v, cfg.congestion)) return false;
+        }
+        else if (const char* v = value("--io=")) {
+            if (!parse_io_backend(v, cfg.backend)) return false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t idx = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig cfg;
+    if (!parse_args(argc, argv, cfg)) {
+        std::cerr << "Uso: " << argv[0] << " [--sessions=N] [--messages=N] [--size=BYTES] [--pipeline=N]"
+                  << " [--workers=N] [--window=BYTES] [--loss=FRAÇÃO] [--io=simple|mmsg|gso|uring|auto] [--timeout=S] [--echo]"
+                  << " [--cc=none|newreno|delay] [--no-pacing] [--record=ARQUIVO]" << std::endl;
+        return 1;
+    }
+
+    // --- Central local em porta efêmera ---
+    sockaddr_in bind_addr{};
+    bind_addr.sin_family = AF_INET;
+    bind_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    CentralServerConfig central_cfg;
+    central_cfg.central.window = cfg.window;
+    central_cfg.loss = cfg.loss;
+    central_cfg.central.echo = cfg.echo;
+    CentralServer server(reinterpret_cast<sockaddr*>(&bind_addr), sizeof(bind_addr), central_cfg);
+    std::atomic<bool> central_running{true};
+    std::thread central_thread([&] { server.run(central_running); });
+
+    // --- Peripheral ---
+    std::vector<uint8_t> payload(cfg.size);
+    for (size_t i = 0; i < payload.size(); ++i) payload[i] = static_cast<uint8_t>(i * 131 + 7);
+    std::vector<SessionProgress> progress(cfg.sessions);
+    std::vector<std::vector<double>> latencies_us(cfg.workers);
+    std::vector<uint64_t> corrupted(cfg.workers, 0); // ecos diferentes do que foi enviado
+
+    WorkerPoolConfig pool_cfg;
+    pool_cfg.workers = cfg.workers;
+    pool_cfg.backend = cfg.backend;
+    pool_cfg.session.verbose = false;
+    pool_cfg.session.congestion = cfg.congestion;
+    pool_cfg.session.pacing = cfg.pacing;
+    pool_cfg.record_path = cfg.record_path;
+    WorkerPool* pool_ptr = nullptr;
+    // Uma mensagem concluída (confirmada ou, no modo eco, devolvida) libera o envio da próxima.
+    auto on_done = [&](size_t worker, uint64_t key, Duration latency) {
+        latencies_us[worker].push_back(std::chrono::duration<double, std::micro>(latency).count());
+        SessionProgress& p = progress[key];
+        --p.in_flight;
+        if (p.remaining > 0) {
+            --p.remaining;
+            ++p.in_flight;
+            if (cfg.echo) p.sent_at.push_back(SlowClock::now());
+            pool_ptr->send(key, payload);
+        } else if (p.in_flight == 0) {
+            pool_ptr->close(key);
+        }
+    };
+    if (cfg.echo) {
+        pool_cfg.on_message_received = [&](size_t worker, uint64_t key, ByteSpan message) {
+            if (message.size() != payload.size() || !std::equal(message.begin(), message.end(), payload.begin())) {
+                ++corrupted[worker];
+            }
+            SessionProgress& p = progress[key];
+            TimePoint sent = p.sent_at.front();
+            p.sent_at.erase(p.sent_at.begin());
+            on_done(worker, key, SlowClock::now() - sent);
+        };
+    } else {
+        pool_cfg.on_message_acked = [&](size_t worker, uint64_t key, size_t, Duration latency) {
+            on_done(worker, key, latency);
+        };
+    }
+    WorkerPool pool(server.address(), server.address_len(), pool_cfg);
+    pool_ptr = &pool;
+
+    std::cout << "=== SLOW bench: " << cfg.sessions << " sessões x " << cfg.messages << " mensagens de "
+              << cfg.size << " bytes | pipeline " << cfg.pipeline << " | " << cfg.workers << " worker(s)"
+              << " | janela " << cfg.window << " | perda " << cfg.loss * 100 << "% | cc "
+              << congestion_algorithm_name(cfg.congestion) << (cfg.pacing ? " + pacing" : "") << " ===" << std::endl;
+
+    auto start = SlowClock::now();
+    pool.start();
+    for (uint64_t key = 0; key < cfg.sessions; ++key) {
+        SessionProgress& p = progress[key];
+        size_t first = std::min(cfg.pipeline, cfg.messages);
+        p.remaining = cfg.messages - first;
+        p.in_flight = first;
+        if (cfg.echo) p.sent_at.assign(first, SlowClock::now());
+        pool.open(key);
+        for (size_t m = 0; m < first; ++m) pool.send(key, payload);
+        if (first == 0) pool.close(key);
+    }
+    bool finished = pool.wait_all_finished(std::chrono::seconds(cfg.timeout_s));
+    double seconds = std::chrono::duration<double>(SlowClock::now() - start).count();
+    pool.stop();
+    central_running.store(false);
+    central_thread.join();
+
+    std::vector<double> all;
+    for (auto& v : latencies_us) all.insert(all.end(), v.begin(), v.end());
+    std::sort(all.begin(), all.end());
+
+    uint64_t messages = pool.total(&WorkerStats::messages_acked);
+    uint64_t bytes = pool.total(&WorkerStats::bytes_acked) + pool.total(&WorkerStats::bytes_received);
+    const CentralStats& st = server.central().stats();
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "tempo:          " << seconds << " s" << (finished ? "" : " (timeout!)") << std::endl;
+    std::cout << "mensagens:      " << messages << " confirmadas (" << st.messages << " remontadas no central, "
+              << pool.total(&WorkerStats::messages_received) << " recebidas do central)" << std::endl;
+    std::cout << "goodput:        " << bytes / seconds / 1e6 << " MB/s (" << bytes * 8 / seconds / 1e6 << " Mbit/s), "
+              << messages / seconds << " msg/s" << std::endl;
+    std::cout << "latência (ms):  p50 " << percentile(all, 0.50) / 1e3 << " | p90 " << percentile(all, 0.90) / 1e3
+              << " | p99 " << percentile(all, 0.99) / 1e3 << " | p99.9 " << percentile(all, 0.999) / 1e3
+              << " | máx " << (all.empty() ? 0.0 : all.back() / 1e3) << std::endl;
+    std::cout << "sessões:        " << pool.total(&WorkerStats::sessions_finished) << " encerradas, "
+              << pool.total(&WorkerStats::sessions_failed) << " com falha" << std::endl;
+    std::cout << "retransmissões: " << pool.total(&WorkerStats::retransmits) << " ("
+              << pool.total(&WorkerStats::fast_retransmits) << " rápidas) | descartados no central: "
+              << server.dropped() << " | duplicados: " << st.duplicates << " | fora de ordem: "
+              << st.out_of_order << " | retransmitidos pelo central: " << st.tx_retransmits << std::endl;
+    uint64_t bad = 0;
+    for (uint64_t c : corrupted) bad += c;
+    if (bad) std::cout << "ERRO: " << bad << " eco(s) diferente(s) da mensagem enviada" << std::endl;
+    return finished && bad == 0 && pool.total(&WorkerStats::sessions_failed) == 0 ? 0 : 1;
+}
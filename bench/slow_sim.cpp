@@ -0,0 +1,313 @@
+/**
+ * Simulador de rede para testes de regressão de desempenho, sem rede alguma.
+ *
+ * Peripheral (PeripheralEngine) e central (SlowCentral) rodam no mesmo processo, ligados por um
+ * enlace simulado (sim_link.hpp) com atraso, jitter, banda, fila, perda, duplicação e
+ * reordenação, sobre um relógio virtual. Cada sessão mantém 'pipeline' mensagens em trânsito
+ * até completar 'messages' e depois encerra, como no slow_bench. O tempo simulado não depende da
+ * máquina: a mesma semente dá sempre o mesmo resultado, e horas de transferência rodam em
+ * segundos.
+ *
+ * --record grava o trace do peripheral (datagramas e instantes virtuais). --replay reproduz um
+ * trace no lugar do enlace e do central: os datagramas recebidos chegam nos instantes gravados e
+ * os enviados são conferidos com os gravados. Só há conferência pacote a pacote com a mesma carga
+ * da gravação; um trace do slow_peripheral --record (que conecta antes de enviar e depois revive
+ * as sessões) reproduz o padrão de perdas e atrasos da rede real, e as divergências mostram onde
+ * o comportamento se afasta.
+ *
+ * Para CI, --min-goodput e --max-p99 transformam o resultado em aprovado/reprovado: o código de
+ * saída é diferente de zero se algum limite não for atendido, se alguma sessão falhar ou se o
+ * replay divergir.
+ *
+ * Uso: slow_sim [--sessions=4] [--messages=100] [--size=15000] [--pipeline=1] [--window=23040]
+ *               [--latency=MS] [--jitter=MS] [--bandwidth=MBIT] [--queue=BYTES] [--loss=FRAÇÃO]
+ *               [--dup=FRAÇÃO] [--reorder=FRAÇÃO] [--reorder-delay=MS] [--seed=N]
+ *               [--cc=none|newreno|delay] [--no-pacing] [--limit=S]
+ *               [--record=ARQUIVO] [--replay=ARQUIVO] [--min-goodput=MB/s] [--max-p99=MS]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/congestion.hpp"
+#include "../src/sim_link.hpp"
+#include "../src/slow_trace.hpp"
+
+struct SimRunConfig {
+    size_t sessions = 4;
+    size_t messages = 100;
+    size_t size = 15000;
+    size_t pipeline = 1;
+    LinkConfig link;
+    uint16_t window = 16 * 1440;
+    uint32_t seed = 1;
+    CongestionAlgorithm congestion = CongestionAlgorithm::None;
+    bool pacing = true;
+    double limit_s = 24 * 3600;   // tempo simulado máximo
+    std::string record_path;
+    std::string replay_path;
+    double min_goodput = 0;       // MB/s de tempo simulado; 0 = sem limite
+    double max_p99_ms = 0;        // 0 = sem limite
+};
+
+static Duration from_ms(double ms) {
+    return std::chrono::duration_cast<Duration>(std::chrono::duration<double, std::milli>(ms));
+}
+
+static bool parse_args(int argc, char* argv[], SimRunConfig& cfg) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&](const char* prefix) -> const char* {
+            size_t n = std::char_traits<char>::length(prefix);
+            return arg.compare(0, n, prefix) == 0 ? argv[i] + n : nullptr;
+        };
+        if (const char* v = value("--sessions=")) cfg.sessions = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+        else if (const char* v = value("--messages=")) cfg.messages = std::strtoull(v, nullptr, 10);
+        else if (const char* v = value("--size=")) cfg.size = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+        else if (const char* v = value("--pipeline=")) cfg.pipeline = std::max<size_t>(1, std::strtoull(v, nullptr, 10));
+        else if (const char* v = value("--window=")) cfg.window = static_cast<uint16_t>(std::strtoul(v, nullptr, 10));
+        else if (const char* v = value("--latency=")) cfg.link.latency = from_ms(std::strtod(v, nullptr));
+        else if (const char* v = value("--jitter=")) cfg.link.jitter = from_ms(std::strtod(v, nullptr));
+        else if (const char* v = value("--bandwidth=")) cfg.link.bandwidth_bps = std::strtod(v, nullptr) * 1e6;
+        else if (const char* v = value("--queue=")) cfg.link.queue_bytes = std::strtoull(v, nullptr, 10);
+        else if (const char* v = value("--loss=")) cfg.link.loss = std::strtod(v, nullptr);
+        else if (const char* v = value("--dup=")) cfg.link.duplicate = std::strtod(v, nullptr);
+        else if (const char* v = value("--reorder=")) cfg.link.reorder = std::strtod(v, nullptr);
+        else if (const char* v = value("--reorder-delay=")) cfg.link.reorder_delay = from_ms(std::strtod(v, nullptr));
+        else if (const char* v = value("--seed=")) cfg.seed = static_cast<uint32_t>(std::strtoul(v, nullptr, 10));
+        else if (const char* v = value("--limit=")) cfg.limit_s = std::strtod(v, nullptr);
+        else if (const char* v = value("--record=")) cfg.record_path = v;
+        else if (const char* v = value("--replay=")) cfg.replay_path = v;
+        else if (const char* v = value("--min-goodput=")) cfg.min_goodput = std::strtod(v, nullptr);
+        else if (const char* v = value("--max-p99=")) cfg.max_p99_ms = std::strtod(v, nullptr);
+        else if (arg == "--no-pacing") cfg.pacing = false;
+        else if (const char* v = value("--cc=")) {
+            if (!parse_congestion_algorithm(v, cfg.congestion)) return false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t idx = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+// --- Carga: 'sessions' sessões com 'pipeline' mensagens em trânsito cada ---
+//
+// As ações disparadas pelos callbacks (próximo envio, close) ficam para depois do passo do laço,
+// fora do processamento do pacote que as originou.
+class Workload {
+public:
+    Workload(PeripheralEngine& engine, const SimRunConfig& cfg, const TimePoint& now)
+        : engine_(engine), cfg_(cfg), now_(now), payload_(cfg.size), progress_(cfg.sessions) {
+        for (size_t i = 0; i < payload_.size(); ++i) payload_[i] = static_cast<uint8_t>(i * 131 + 7);
+    }
+
+    void start() {
+        SessionConfig scfg;
+        scfg.verbose = false;
+        scfg.congestion = cfg_.congestion;
+        scfg.pacing = cfg_.pacing;
+        for (size_t k = 0; k < cfg_.sessions; ++k) {
+            SlowSession& s = engine_.create_session(scfg);
+            Progress& p = progress_[k];
+            p.session = &s;
+            s.callbacks.on_message_sent = [this, &p](SlowSession&, size_t bytes, Duration latency) {
+                latencies_us_.push_back(std::chrono::duration<double, std::micro>(latency).count());
+                bytes_acked_ += bytes;
+                --p.in_flight;
+                ready_.push_back(&p);
+            };
+            engine_.connect(s);
+            size_t first = std::min(cfg_.pipeline, cfg_.messages);
+            p.remaining = cfg_.messages - first;
+            p.in_flight = first;
+            for (size_t m = 0; m < first; ++m) send(s);
+            if (first == 0) s.close(now_);
+        }
+    }
+
+    // Executa as ações pendentes; retorna true quando todas as sessões terminaram.
+    bool advance() {
+        std::vector<Progress*> batch;
+        batch.swap(ready_);
+        for (Progress* p : batch) {
+            if (p->remaining > 0) {
+                --p->remaining;
+                ++p->in_flight;
+                send(*p->session);
+            } else if (p->in_flight == 0 && !p->closing) {
+                p->closing = true;
+                p->session->close(now_);
+            }
+        }
+        return ready_.empty() && engine_.all_finished();
+    }
+
+    uint64_t failed() const {
+        uint64_t n = 0;
+        for (const Progress& p : progress_) n += p.session->state() != SessionState::Closed;
+        return n;
+    }
+
+    uint64_t total(Counter c) const {
+        uint64_t n = 0;
+        for (const Progress& p : progress_) n += p.session->metrics().get(c);
+        return n;
+    }
+
+    std::vector<double>& latencies_us() { return latencies_us_; }
+    uint64_t bytes_acked() const { return bytes_acked_; }
+
+private:
+    struct Progress {
+        SlowSession* session = nullptr;
+        size_t remaining = 0;
+        size_t in_flight = 0;
+        bool closing = false;
+    };
+
+    void send(SlowSession& s) { s.send(std::make_unique<SpanSource>(ByteSpan(payload_)), now_); }
+
+    PeripheralEngine& engine_;
+    const SimRunConfig& cfg_;
+    const TimePoint& now_;
+    std::vector<uint8_t> payload_;
+    std::vector<Progress> progress_;
+    std::vector<Progress*> ready_;
+    std::vector<double> latencies_us_;
+    uint64_t bytes_acked_ = 0;
+};
+
+// Reproduz um trace: o relógio virtual salta entre as entregas gravadas e os temporizadores.
+static int run_replay(const SimRunConfig& cfg) {
+    std::vector<TraceRecord> records;
+    try {
+        records = read_trace(cfg.replay_path);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    TimePoint start = TimePoint{} + std::chrono::hours(1);
+    TimePoint now = start;
+    auto replay_io = std::make_unique<ReplayIO>(std::move(records), now, start);
+    ReplayIO& replay = *replay_io;
+    PeripheralEngine engine(std::move(replay_io), start);
+    Workload load(engine, cfg, now);
+
+    std::cout << "=== SLOW sim: replay de " << cfg.replay_path << " (" << replay.inbound_count() << " recebidos, "
+              << replay.expected_count() << " enviados gravados) | " << cfg.sessions << " sessões x " << cfg.messages
+              << " mensagens de " << cfg.size << " bytes ===" << std::endl;
+
+    auto wall = std::chrono::steady_clock::now();
+    TimePoint deadline = start + from_ms(cfg.limit_s * 1000);
+    load.start();
+    bool finished = false;
+    for (;;) {
+        engine.step(now);
+        finished = load.advance();
+        if (finished || now >= deadline) break;
+        // Entregue todo o trace, só os temporizadores seguem, até sair o que foi gravado depois
+        // da última recepção (ex.: retransmissões finais do Disconnect).
+        std::optional<TimePoint> next = replay.next_delivery();
+        if (!next && replay.missing() == 0) break;
+        if (auto t = engine.next_timeout(now)) next = next ? std::min(*next, now + *t) : now + *t;
+        if (!next) break;
+        now = std::min(std::max(*next, now + std::chrono::microseconds(1)), deadline);
+    }
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall).count();
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "tempo simulado: " << std::chrono::duration<double>(now - start).count() << " s (" << wall_s
+              << " s reais)" << (finished ? "" : " | carga não concluída") << std::endl;
+    std::cout << "enviados:       " << replay.sent() << " | conferem com o trace: " << replay.matched()
+              << " | divergentes: " << replay.diverged() << " | gravados e não enviados: " << replay.missing() << std::endl;
+    if (replay.diverged() > 0) {
+        std::cout << "primeira divergência no datagrama enviado nº " << replay.first_divergence() << std::endl;
+    }
+    return replay.diverged() == 0 && replay.missing() == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    SimRunConfig cfg;
+    if (!parse_args(argc, argv, cfg)) {
+        std::cerr << "Uso: " << argv[0] << " [--sessions=N] [--messages=N] [--size=BYTES] [--pipeline=N] [--window=BYTES]"
+                  << " [--latency=MS] [--jitter=MS] [--bandwidth=MBIT] [--queue=BYTES] [--loss=FRAÇÃO] [--dup=FRAÇÃO]"
+                  << " [--reorder=FRAÇÃO] [--reorder-delay=MS] [--seed=N] [--cc=none|newreno|delay] [--no-pacing]"
+                  << " [--limit=S] [--record=ARQUIVO] [--replay=ARQUIVO] [--min-goodput=MB/s] [--max-p99=MS]" << std::endl;
+        return 1;
+    }
+    // O fid inicial de cada sessão vem de rand(): com a semente fixa, a execução se repete.
+    srand(cfg.seed);
+    if (!cfg.replay_path.empty()) return run_replay(cfg);
+
+    SimConfig sim_cfg;
+    sim_cfg.uplink = cfg.link;
+    sim_cfg.downlink = cfg.link;
+    sim_cfg.central.window = cfg.window;
+    sim_cfg.seed = cfg.seed;
+    sim_cfg.record_path = cfg.record_path;
+    std::unique_ptr<SimNetwork> net;
+    try {
+        net = std::make_unique<SimNetwork>(sim_cfg);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "=== SLOW sim: " << cfg.sessions << " sessões x " << cfg.messages << " mensagens de " << cfg.size
+              << " bytes | pipeline " << cfg.pipeline << " | atraso " << to_ms_double(cfg.link.latency) << " ms"
+              << " + jitter " << to_ms_double(cfg.link.jitter) << " ms | banda "
+              << (cfg.link.bandwidth_bps > 0 ? std::to_string(static_cast<uint64_t>(cfg.link.bandwidth_bps / 1e6)) + " Mbit/s" : "ilimitada")
+              << " | perda " << cfg.link.loss * 100 << "% | dup " << cfg.link.duplicate * 100 << "% | reordem "
+              << cfg.link.reorder * 100 << "% | cc " << congestion_algorithm_name(cfg.congestion)
+              << (cfg.pacing ? " + pacing" : "") << " | semente " << cfg.seed << " ===" << std::endl;
+
+    auto wall = std::chrono::steady_clock::now();
+    Workload load(net->engine(), cfg, net->clock());
+    load.start();
+    bool finished = net->run_until([&] { return load.advance(); }, from_ms(cfg.limit_s * 1000));
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall).count();
+    double sim_s = std::chrono::duration<double>(net->elapsed()).count();
+
+    std::vector<double>& lat = load.latencies_us();
+    std::sort(lat.begin(), lat.end());
+    double goodput = sim_s > 0 ? load.bytes_acked() / sim_s / 1e6 : 0;
+    double p99_ms = percentile(lat, 0.99) / 1e3;
+    const LinkStats& up = net->uplink().stats();
+    const LinkStats& down = net->downlink().stats();
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "tempo simulado: " << sim_s << " s em " << wall_s << " s reais (" << (wall_s > 0 ? sim_s / wall_s : 0)
+              << "x)" << (finished ? "" : " (limite atingido!)") << std::endl;
+    std::cout << "goodput:        " << goodput << " MB/s (" << goodput * 8 << " Mbit/s), " << lat.size() << " mensagens" << std::endl;
+    std::cout << "latência (ms):  p50 " << percentile(lat, 0.50) / 1e3 << " | p90 " << percentile(lat, 0.90) / 1e3
+              << " | p99 " << p99_ms << " | p99.9 " << percentile(lat, 0.999) / 1e3 << " | máx "
+              << (lat.empty() ? 0.0 : lat.back() / 1e3) << std::endl;
+    std::cout << "sessões:        " << cfg.sessions << ", " << load.failed() << " com falha | retransmissões: "
+              << load.total(Counter::Retransmits) << " (" << load.total(Counter::FastRetransmits) << " rápidas) | RTOs: "
+              << load.total(Counter::Timeouts) << " (" << load.total(Counter::SpuriousTimeouts) << " espúrios)" << std::endl;
+    std::cout << "enlace (subida/descida): " << up.sent << "/" << down.sent << " enviados, " << up.lost << "/" << down.lost
+              << " perdidos, " << up.queue_drops << "/" << down.queue_drops << " descartados na fila, " << up.duplicated
+              << "/" << down.duplicated << " duplicados, " << up.reordered << "/" << down.reordered << " reordenados"
+              << std::endl;
+
+    bool ok = finished && load.failed() == 0;
+    if (cfg.min_goodput > 0 && goodput < cfg.min_goodput) {
+        std::cout << "REPROVADO: goodput " << goodput << " MB/s abaixo do mínimo de " << cfg.min_goodput << std::endl;
+        ok = false;
+    }
+    if (cfg.max_p99_ms > 0 && p99_ms > cfg.max_p99_ms) {
+        std::cout << "REPROVADO: p99 " << p99_ms << " ms acima do máximo de " << cfg.max_p99_ms << std::endl;
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
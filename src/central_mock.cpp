@@ -0,0 +1,92 @@
+/**
+ * Central SLOW local, para testar o peripheral sem depender de slow.gmelodie.com.
+ *
+ * Atende CONNECT/ACCEPT, dados com ACK cumulativo e janela configurável, remontagem de
+ * fragmentos, Disconnect e Revive. A perda induzida descarta datagramas na chegada; com --echo,
+ * cada mensagem recebida é devolvida ao peripheral.
+ *
+ * Uso: slow_central_mock [porta=7033] [--bind=127.0.0.1] [--window=BYTES] [--sttl=MS]
+ *                        [--loss=FRAÇÃO] [--echo] [--verbose]
+ */
+
+#include <atomic>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include "central_server.hpp"
+#include "slow_print.hpp"
+
+static std::atomic<bool> g_running{true};
+
+static void on_signal(int) { g_running.store(false); }
+
+int main(int argc, char* argv[]) {
+    const char* port = "7033";
+    std::string bind_host = "127.0.0.1";
+    CentralServerConfig cfg;
+    bool verbose = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--bind=", 0) == 0) {
+            bind_host = arg.substr(7);
+        } else if (arg.rfind("--window=", 0) == 0) {
+            cfg.central.window = static_cast<uint16_t>(std::strtoul(arg.c_str() + 9, nullptr, 10));
+        } else if (arg.rfind("--sttl=", 0) == 0) {
+            cfg.central.sttl_ms = static_cast<uint32_t>(std::strtoul(arg.c_str() + 7, nullptr, 10));
+        } else if (arg.rfind("--loss=", 0) == 0) {
+            cfg.loss = std::strtod(arg.c_str() + 7, nullptr);
+        } else if (arg == "--echo") {
+            cfg.central.echo = true;
+        } else if (arg == "--verbose") {
+            verbose = true;
+        } else if (arg.rfind("--", 0) != 0) {
+            port = argv[i];
+        } else {
+            std::cerr << "Uso: " << argv[0] << " [porta] [--bind=HOST] [--window=BYTES] [--sttl=MS] [--loss=FRAÇÃO] [--echo] [--verbose]" << std::endl;
+            return 1;
+        }
+    }
+
+    struct addrinfo hints{}, *res;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(bind_host.c_str(), port, &hints, &res) != 0) {
+        perror("getaddrinfo");
+        return 1;
+    }
+
+    try {
+        CentralServer server(res->ai_addr, res->ai_addrlen, cfg);
+        freeaddrinfo(res);
+        if (verbose) {
+            server.central().on_message = [](const SlowCentral::Sid& sid, ByteSpan data) {
+                std::cout << "Mensagem de " << data.size() << " bytes da sessão ";
+                print_sid(sid);
+                std::cout << std::endl;
+            };
+        }
+
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+        std::cout << "=== SLOW Central (mock) em " << bind_host << ":" << server.port()
+                  << " | janela " << cfg.central.window << " bytes, sttl " << cfg.central.sttl_ms
+                  << " ms, perda " << cfg.loss * 100 << "% ===" << std::endl;
+        server.run(g_running);
+
+        const CentralStats& st = server.central().stats();
+        std::cout << "\nconexões: " << st.connects << " | revives: " << st.revives
+                  << " (falhas: " << st.revive_failures << ") | disconnects: " << st.disconnects
+                  << "\nfragmentos: " << st.data_packets << " | duplicados: " << st.duplicates
+                  << " | fora de ordem: " << st.out_of_order << " | descartados: " << server.dropped()
+                  << "\nmensagens: " << st.messages << " (" << st.bytes << " bytes)"
+                  << "\nfragmentos enviados: " << st.tx_packets << " | retransmitidos: " << st.tx_retransmits << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Erro: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
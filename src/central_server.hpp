@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include "slow_central.hpp"
+#include "slow_io.hpp"
+
+struct CentralServerConfig {
+    CentralConfig central;
+    double loss = 0.0;          // probabilidade de descartar cada datagrama recebido
+    uint32_t loss_seed = 1;
+};
+
+// --- Central local sobre UDP ---
+//
+// Envolve o SlowCentral com um socket: recebe em lote (recvmmsg), responde em lote (sendmmsg),
+// cada resposta endereçada a quem enviou o pedido. A perda induzida descarta datagramas na
+// chegada, antes de o central vê-los, o que exercita as retransmissões do peripheral.
+class CentralServer {
+public:
+    static constexpr size_t BATCH = 64;
+
+    // Cria o socket e o associa a 'bind_addr' (porta 0 escolhe uma porta livre).
+    CentralServer(const sockaddr* bind_addr, socklen_t bind_len, const CentralServerConfig& cfg = {})
+        : cfg_(cfg), central_(cfg.central), loss_rng_(cfg.loss_seed),
+          rx_buf_(BATCH), rx_addr_(BATCH), rx_iov_(BATCH), rx_msgs_(BATCH),
+          tx_buf_(BATCH), tx_addr_(BATCH), tx_iov_(BATCH), tx_msgs_(BATCH) {
+        sock_ = socket(bind_addr->sa_family, SOCK_DGRAM, 0);
+        if (sock_ < 0) throw std::runtime_error("socket falhou");
+        int buf = 4 << 20;
+        setsockopt(sock_, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+        setsockopt(sock_, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+        if (bind(sock_, bind_addr, bind_len) < 0) {
+            ::close(sock_);
+            throw std::runtime_error("bind falhou");
+        }
+        addr_len_ = sizeof(addr_);
+        getsockname(sock_, reinterpret_cast<sockaddr*>(&addr_), &addr_len_);
+        set_nonblocking(sock_);
+    }
+
+    ~CentralServer() { ::close(sock_); }
+
+    CentralServer(const CentralServer&) = delete;
+    CentralServer& operator=(const CentralServer&) = delete;
+
+    // Endereço efetivo do socket (útil quando a porta foi escolhida pelo kernel).
+    const sockaddr* address() const { return reinterpret_cast<const sockaddr*>(&addr_); }
+    socklen_t address_len() const { return addr_len_; }
+    uint16_t port() const {
+        return ntohs(addr_.ss_family == AF_INET6
+                         ? reinterpret_cast<const sockaddr_in6*>(&addr_)->sin6_port
+                         : reinterpret_cast<const sockaddr_in*>(&addr_)->sin_port);
+    }
+
+    // Atende até 'running' virar false. O SlowCentral só é tocado por esta thread.
+    void run(const std::atomic<bool>& running) {
+        auto reply = [this](const SLOWPacketView& pkt, const PeerAddress& to) { queue_reply(pkt, to); };
+        while (running.load(std::memory_order_relaxed)) {
+            if (wait_readable(sock_, std::chrono::milliseconds(10))) drain(SlowClock::now());
+            // Retransmissões dos dados enviados pelo central.
+            central_.on_tick(SlowClock::now(), reply);
+            flush();
+        }
+    }
+
+    SlowCentral& central() { return central_; }
+    uint64_t dropped() const { return dropped_; }
+
+private:
+    void drain(TimePoint now) {
+        for (;;) {
+            for (size_t i = 0; i < BATCH; ++i) {
+                rx_iov_[i] = {rx_buf_[i].data(), rx_buf_[i].size()};
+                rx_msgs_[i].msg_hdr = {};
+                rx_msgs_[i].msg_hdr.msg_name = &rx_addr_[i];
+                rx_msgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+                rx_msgs_[i].msg_hdr.msg_iov = &rx_iov_[i];
+                rx_msgs_[i].msg_hdr.msg_iovlen = 1;
+            }
+            int n = recvmmsg(sock_, rx_msgs_.data(), BATCH, MSG_DONTWAIT, nullptr);
+            if (n <= 0) break;
+
+            for (int i = 0; i < n; ++i) {
+                size_t len = rx_msgs_[i].msg_len;
+                if (len < SLOW_HEADER_SIZE) continue;
+                if (cfg_.loss > 0.0 && loss_dist_(loss_rng_) < cfg_.loss) {
+                    ++dropped_;
+                    continue;
+                }
+                PeerAddress from;
+                from.addr = rx_addr_[i];
+                from.len = rx_msgs_[i].msg_hdr.msg_namelen;
+                central_.on_packet(SLOWPacketView::decode(rx_buf_[i].data(), len), from, now,
+                                   [this](const SLOWPacketView& reply, const PeerAddress& to) {
+                                       queue_reply(reply, to);
+                                   });
+            }
+            flush();
+            if (static_cast<size_t>(n) < BATCH) break;
+        }
+    }
+
+    void queue_reply(const SLOWPacketView& reply, const PeerAddress& to) {
+        if (tx_count_ == BATCH) flush();
+        size_t i = tx_count_++;
+        size_t len = reply.encode(tx_buf_[i].data(), tx_buf_[i].size());
+        tx_addr_[i] = to.addr;
+        tx_iov_[i] = {tx_buf_[i].data(), len};
+        tx_msgs_[i].msg_hdr = {};
+        tx_msgs_[i].msg_hdr.msg_name = &tx_addr_[i];
+        tx_msgs_[i].msg_hdr.msg_namelen = to.len;
+        tx_msgs_[i].msg_hdr.msg_iov = &tx_iov_[i];
+        tx_msgs_[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    void flush() {
+        size_t done = 0;
+        while (done < tx_count_) {
+            int n = sendmmsg(sock_, tx_msgs_.data() + done, tx_count_ - done, 0);
+            if (n <= 0) {
+                // Buffer cheio ou erro: o restante se perde, como em qualquer rede.
+                if (n < 0 && errno == EINTR) continue;
+                break;
+            }
+            done += n;
+        }
+        tx_count_ = 0;
+    }
+
+    CentralServerConfig cfg_;
+    SlowCentral central_;
+    int sock_ = -1;
+    sockaddr_storage addr_{};
+    socklen_t addr_len_ = 0;
+
+    std::mt19937 loss_rng_;
+    std::uniform_real_distribution<double> loss_dist_{0.0, 1.0};
+    uint64_t dropped_ = 0;
+
+    std::vector<std::array<uint8_t, SLOW_MAX_PACKET_SIZE>> rx_buf_;
+    std::vector<sockaddr_storage> rx_addr_;
+    std::vector<iovec> rx_iov_;
+    std::vector<mmsghdr> rx_msgs_;
+    std::vector<std::array<uint8_t, SLOW_MAX_PACKET_SIZE>> tx_buf_;
+    std::vector<sockaddr_storage> tx_addr_;
+    std::vector<iovec> tx_iov_;
+    std::vector<mmsghdr> tx_msgs_;
+    size_t tx_count_ = 0;
+};
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include "slow_packet.hpp"
+#include "slow_clock.hpp"
+
+// --- Controle de congestionamento do lado que envia ---
+//
+// A janela do central (peer_window) só protege o buffer dele; o controlador protege o caminho.
+// A sessão nunca deixa mais que min(cwnd, peer_window) bytes em trânsito e, se o controlador
+// informar uma taxa, espaça os envios em vez de despejar a janela de uma vez (pacing).
+//
+// A detecção de perdas fica na sessão (3 ACKs duplicados => retransmissão rápida; RTO); o
+// controlador só é informado dos eventos e decide a janela e a taxa.
+
+enum class CongestionAlgorithm {
+    None,     // só a janela do central, como antes: sem cwnd, sem pacing e sem retransmissão rápida
+    NewReno,  // AIMD (RFC 5681/6582): slow start, prevenção de congestionamento, recuperação rápida
+    Delay     // baseado em atraso, no estilo do BBR: taxa de entrega máxima x RTT mínimo
+};
+
+inline const char* congestion_algorithm_name(CongestionAlgorithm algo) {
+    switch (algo) {
+        case CongestionAlgorithm::None:    return "none";
+        case CongestionAlgorithm::NewReno: return "newreno";
+        case CongestionAlgorithm::Delay:   return "delay";
+    }
+    return "?";
+}
+
+inline bool parse_congestion_algorithm(const std::string& name, CongestionAlgorithm& out) {
+    if (name == "none")         out = CongestionAlgorithm::None;
+    else if (name == "newreno") out = CongestionAlgorithm::NewReno;
+    else if (name == "delay" || name == "bbr") out = CongestionAlgorithm::Delay;
+    else return false;
+    return true;
+}
+
+// O que um ACK que avançou a sequência ensinou ao controlador.
+struct AckSample {
+    size_t acked_bytes = 0;        // bytes de dados recém-confirmados
+    size_t prior_in_flight = 0;    // em trânsito antes do ACK
+    Duration rtt{};                // amostra de RTT deste ACK (zero se não houver, regra de Karn)
+    Duration srtt{};               // RTT suavizado da sessão
+    bool in_recovery = false;      // ainda recuperando uma perda
+    bool app_limited = false;      // faltaram dados para enviar, não janela
+    TimePoint now{};
+};
+
+class CongestionController {
+public:
+    static constexpr size_t MSS = SLOW_MAX_DATA_SIZE;
+
+    virtual ~CongestionController() = default;
+
+    virtual CongestionAlgorithm algorithm() const = 0;
+    // Limite de bytes em trânsito imposto pelo controlador.
+    virtual size_t cwnd() const = 0;
+    // Taxa de envio em bytes/s; 0 desliga o pacing.
+    virtual double pacing_rate() const = 0;
+
+    virtual void on_ack(const AckSample& ack) = 0;
+    // Perda detectada por ACKs duplicados; chamado uma vez por episódio de recuperação.
+    virtual void on_loss(size_t in_flight, TimePoint now) = 0;
+    // O RTO venceu: nada chegou durante um RTO inteiro.
+    virtual void on_timeout(size_t in_flight, TimePoint now) = 0;
+    // O último RTO foi espúrio (os ACKs só estavam atrasados): desfaz a reação a ele.
+    virtual void on_spurious_timeout() = 0;
+};
+
+// Sem controle de congestionamento: a janela do central é o único limite.
+class NoCongestionControl final : public CongestionController {
+public:
+    CongestionAlgorithm algorithm() const override { return CongestionAlgorithm::None; }
+    size_t cwnd() const override { return std::numeric_limits<size_t>::max(); }
+    double pacing_rate() const override { return 0; }
+    void on_ack(const AckSample&) override {}
+    void on_loss(size_t, TimePoint) override {}
+    void on_timeout(size_t, TimePoint) override {}
+    void on_spurious_timeout() override {}
+};
+
+// --- NewReno ---
+// A janela cresce um MSS por byte confirmado no slow start e um MSS por RTT depois do ssthresh;
+// cai pela metade a cada episódio de perda e volta a um MSS no RTO. Só cresce quando está de
+// fato limitando o envio (RFC 7661), senão uma sessão limitada pela aplicação ou pela janela
+// do central inflaria a cwnd sem nunca testá-la. O pacing segue o do Linux: cwnd/srtt, com
+// ganho 2 no slow start e 1,2 depois.
+class NewRenoController final : public CongestionController {
+public:
+    static constexpr size_t INITIAL_WINDOW = 10 * MSS; // RFC 6928
+
+    CongestionAlgorithm algorithm() const override { return CongestionAlgorithm::NewReno; }
+    size_t cwnd() const override { return cwnd_; }
+
+    double pacing_rate() const override {
+        if (srtt_ <= Duration::zero()) return 0;
+        double gain = cwnd_ < ssthresh_ ? 2.0 : 1.2;
+        return gain * cwnd_ / std::chrono::duration<double>(srtt_).count();
+    }
+
+    void on_ack(const AckSample& ack) override {
+        if (ack.srtt > Duration::zero()) srtt_ = ack.srtt;
+        if (ack.in_recovery || ack.prior_in_flight * 2 < cwnd_) return;
+        if (cwnd_ < ssthresh_) {
+            cwnd_ += std::min(ack.acked_bytes, 2 * MSS);
+        } else {
+            // Prevenção de congestionamento: +1 MSS a cada cwnd de bytes confirmados.
+            acked_in_ca_ += ack.acked_bytes;
+            if (acked_in_ca_ >= cwnd_) {
+                acked_in_ca_ -= cwnd_;
+                cwnd_ += MSS;
+            }
+        }
+    }
+
+    void on_loss(size_t in_flight, TimePoint) override {
+        ssthresh_ = std::max(in_flight / 2, 2 * MSS);
+        cwnd_ = ssthresh_;
+        acked_in_ca_ = 0;
+    }
+
+    void on_timeout(size_t in_flight, TimePoint) override {
+        prior_cwnd_ = cwnd_;
+        prior_ssthresh_ = ssthresh_;
+        ssthresh_ = std::max(in_flight / 2, 2 * MSS);
+        cwnd_ = MSS;
+        acked_in_ca_ = 0;
+    }
+
+    // Volta à janela de antes do RTO (RFC 4015); o que ela cresceu desde então é mantido.
+    void on_spurious_timeout() override {
+        cwnd_ = std::max(cwnd_, prior_cwnd_);
+        ssthresh_ = std::max(ssthresh_, prior_ssthresh_);
+    }
+
+private:
+    size_t cwnd_ = INITIAL_WINDOW;
+    size_t ssthresh_ = std::numeric_limits<size_t>::max();
+    size_t acked_in_ca_ = 0;
+    size_t prior_cwnd_ = 0;      // antes do último RTO, para desfazê-lo se for espúrio
+    size_t prior_ssthresh_ = 0;
+    Duration srtt_{};
+};
+
+// --- Baseado em atraso (estilo BBR) ---
+// Modela o caminho pela maior taxa de entrega recente (btl_bw) e pelo menor RTT visto
+// (min_rtt), e envia a btl_bw com cwnd de ~2 BDP, sem reagir a perdas isoladas: perda aleatória
+// não derruba a taxa, só fila crescendo (RTT acima do mínimo) ou queda na taxa de entrega.
+//
+// A taxa de entrega é medida a cada rodada de min_rtt, com no mínimo 1 ms (a resolução do
+// pacing), como bytes confirmados / tempo. Rodadas em que faltaram dados para enviar só contam
+// se superarem a estimativa: não dizem nada sobre o caminho, só sobre a aplicação. As fases
+// seguem o BBR: Startup (ganho 2,89 até a banda parar de crescer 25% em 3 rodadas), Drain
+// (esvazia a fila criada no Startup) e ProbeBW, que alterna ganhos 1,25 / 0,75 / 1 x 6.
+class DelayBasedController final : public CongestionController {
+public:
+    static constexpr size_t MIN_CWND = 4 * MSS;
+
+    CongestionAlgorithm algorithm() const override { return CongestionAlgorithm::Delay; }
+
+    size_t cwnd() const override {
+        if (after_timeout_) return MIN_CWND;
+        if (btl_bw_ <= 0 || min_rtt_ == Duration::max()) return INITIAL_WINDOW;
+        return std::max(MIN_CWND, static_cast<size_t>(cwnd_gain() * bdp()));
+    }
+
+    double pacing_rate() const override {
+        if (btl_bw_ <= 0) return 0;
+        // Piso de MIN_CWND por rodada, para que uma estimativa ruim não paralise a sessão.
+        double floor = MIN_CWND / std::chrono::duration<double>(round_length(Duration::zero())).count();
+        return std::max(floor, pacing_gain() * btl_bw_);
+    }
+
+    void on_ack(const AckSample& ack) override {
+        if (ack.acked_bytes > 0) after_timeout_ = false;
+        if (ack.rtt > Duration::zero() && ack.rtt < min_rtt_) min_rtt_ = ack.rtt;
+
+        if (interval_start_ == TimePoint{}) interval_start_ = ack.now;
+        interval_bytes_ += ack.acked_bytes;
+        interval_app_limited_ |= ack.app_limited;
+        Duration elapsed = ack.now - interval_start_;
+        if (elapsed < round_length(ack.srtt)) return;
+
+        // Fim de uma rodada: nova amostra de taxa de entrega.
+        double rate = interval_bytes_ / std::chrono::duration<double>(elapsed).count();
+        bool app_limited = interval_app_limited_;
+        interval_start_ = ack.now;
+        interval_bytes_ = 0;
+        interval_app_limited_ = false;
+        if (app_limited && rate <= btl_bw_) return;
+        // Filtro de máximo janelado das últimas BW_ROUNDS rodadas.
+        bw_samples_[round_count_ % BW_ROUNDS] = rate;
+        ++round_count_;
+        btl_bw_ = *std::max_element(bw_samples_.begin(), bw_samples_.end());
+        advance_phase(ack.prior_in_flight);
+    }
+
+    void on_loss(size_t, TimePoint) override {}
+
+    void on_timeout(size_t, TimePoint) override {
+        // Um RTO indica que o modelo pode estar muito errado: reenvia devagar até o próximo ACK.
+        after_timeout_ = true;
+    }
+
+    void on_spurious_timeout() override { after_timeout_ = false; }
+
+private:
+    static constexpr size_t INITIAL_WINDOW = 10 * MSS;
+    static constexpr size_t BW_ROUNDS = 10;
+    static constexpr double HIGH_GAIN = 2.885; // 2/ln(2)
+    static constexpr std::array<double, 8> PROBE_GAINS{1.25, 0.75, 1, 1, 1, 1, 1, 1};
+
+    enum class Phase { Startup, Drain, ProbeBw };
+
+    // BDP sobre a rodada, não sobre o min_rtt puro: abaixo de 1 ms (loopback, rede local) os
+    // ACKs chegam em lotes de um tique de pacing, e a cwnd precisa cobrir o lote inteiro.
+    double bdp() const {
+        return btl_bw_ * std::chrono::duration<double>(round_length(Duration::zero())).count();
+    }
+
+    Duration round_length(Duration srtt) const {
+        Duration round = min_rtt_ == Duration::max() ? srtt : min_rtt_;
+        return std::max<Duration>(round, std::chrono::milliseconds(1));
+    }
+
+    double pacing_gain() const {
+        switch (phase_) {
+            case Phase::Startup: return HIGH_GAIN;
+            case Phase::Drain:   return 1 / HIGH_GAIN;
+            case Phase::ProbeBw: return PROBE_GAINS[cycle_ % PROBE_GAINS.size()];
+        }
+        return 1;
+    }
+    double cwnd_gain() const { return phase_ == Phase::Startup ? HIGH_GAIN : 2.0; }
+
+    void advance_phase(size_t in_flight) {
+        switch (phase_) {
+            case Phase::Startup:
+                if (btl_bw_ >= full_bw_ * 1.25) {
+                    full_bw_ = btl_bw_;
+                    full_bw_rounds_ = 0;
+                } else if (++full_bw_rounds_ >= 3) {
+                    phase_ = Phase::Drain;
+                }
+                break;
+            case Phase::Drain:
+                if (in_flight <= static_cast<size_t>(bdp())) {
+                    phase_ = Phase::ProbeBw;
+                    cycle_ = 0;
+                }
+                break;
+            case Phase::ProbeBw:
+                ++cycle_;
+                break;
+        }
+    }
+
+    Phase phase_ = Phase::Startup;
+    double btl_bw_ = 0;       // bytes/s
+    double full_bw_ = 0;
+    int full_bw_rounds_ = 0;
+    size_t cycle_ = 0;
+    Duration min_rtt_ = Duration::max();
+    std::array<double, BW_ROUNDS> bw_samples_{};
+    size_t round_count_ = 0;
+    TimePoint interval_start_{};
+    size_t interval_bytes_ = 0;
+    bool interval_app_limited_ = false;
+    bool after_timeout_ = false;
+};
+
+inline std::unique_ptr<CongestionController> make_congestion_controller(CongestionAlgorithm algo) {
+    switch (algo) {
+        case CongestionAlgorithm::NewReno: return std::make_unique<NewRenoController>();
+        case CongestionAlgorithm::Delay:   return std::make_unique<DelayBasedController>();
+        case CongestionAlgorithm::None:    break;
+    }
+    return std::make_unique<NoCongestionControl>();
+}
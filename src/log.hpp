@@ -0,0 +1,426 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "slow_clock.hpp"
+#include "slow_packet.hpp"
+#include "slow_print.hpp"
+
+// --- Log assíncrono com níveis resolvidos em tempo de compilação ---
+//
+// SLOW_LOG_LEVEL (definido pelo CMake) é o nível mínimo compilado. As macros dos níveis abaixo
+// dele não geram código: os argumentos nem são avaliados. Um registro habilitado não formata
+// nada na thread que o emite: o ponteiro do formato (sempre um literal), o instante e os
+// argumentos em binário vão para um anel SPSC da própria thread. Uma thread de fundo drena os
+// anéis, ordena os registros pelo instante, formata ("{}" é substituído pelo próximo argumento)
+// e escreve tudo com um único fwrite por lote. Com o anel cheio o registro é descartado e
+// contado, sem nunca bloquear quem emite.
+//
+//   SLOW_LOG_INFO("[sessão {}] ACK de {} bytes, RTT {}", id, bytes, rtt);
+//
+// Tipos aceitos: inteiros, bool, ponto flutuante, strings, ByteSpan (hex, até 256 bytes),
+// Session ID (UUID) e Duration (em ms).
+
+#define SLOW_LOG_LEVEL_TRACE 0
+#define SLOW_LOG_LEVEL_DEBUG 1
+#define SLOW_LOG_LEVEL_INFO  2
+#define SLOW_LOG_LEVEL_WARN  3
+#define SLOW_LOG_LEVEL_ERROR 4
+#define SLOW_LOG_LEVEL_OFF   5
+
+#ifndef SLOW_LOG_LEVEL
+#define SLOW_LOG_LEVEL SLOW_LOG_LEVEL_INFO
+#endif
+
+namespace slowlog {
+
+enum class Level : uint8_t { Trace, Debug, Info, Warn, Error };
+
+enum class Tag : uint8_t { I64, U64, F64, Bool, Str, Bytes, Sid, Dur };
+
+// Cabeçalho de cada registro no anel, seguido dos argumentos codificados.
+struct RecordHeader {
+    uint32_t size;        // registro inteiro, incluindo este cabeçalho
+    Level level;
+    uint8_t nargs;
+    uint16_t reserved;
+    const char* format;   // literal: vive o programa todo
+    int64_t timestamp_ns;
+};
+
+// --- Anel de bytes de um produtor e um consumidor ---
+class Ring {
+public:
+    static constexpr size_t CAPACITY = 1 << 16;
+
+    // Produtor: copia o registro inteiro ou nada.
+    bool try_write(const uint8_t* data, size_t n) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        if (n > CAPACITY - (head - tail_.load(std::memory_order_acquire))) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        copy_in(head, data, n);
+        head_.store(head + n, std::memory_order_release);
+        return true;
+    }
+
+    // Consumidor: entrega cada registro pendente a 'fn' (cópia contígua em 'scratch').
+    template <typename Fn>
+    void drain(std::vector<uint8_t>& scratch, Fn&& fn) {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        uint64_t head = head_.load(std::memory_order_acquire);
+        while (tail < head) {
+            uint32_t size;
+            copy_out(tail, reinterpret_cast<uint8_t*>(&size), sizeof(size));
+            scratch.resize(size);
+            copy_out(tail, scratch.data(), size);
+            tail += size;
+            fn(scratch.data());
+        }
+        tail_.store(tail, std::memory_order_release);
+    }
+
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    void copy_in(uint64_t pos, const uint8_t* data, size_t n) {
+        size_t off = pos % CAPACITY;
+        size_t first = std::min(n, CAPACITY - off);
+        std::memcpy(&buf_[off], data, first);
+        std::memcpy(&buf_[0], data + first, n - first);
+    }
+    void copy_out(uint64_t pos, uint8_t* out, size_t n) const {
+        size_t off = pos % CAPACITY;
+        size_t first = std::min(n, CAPACITY - off);
+        std::memcpy(out, &buf_[off], first);
+        std::memcpy(out + first, &buf_[0], n - first);
+    }
+
+    std::array<uint8_t, CAPACITY> buf_{};
+    alignas(64) std::atomic<uint64_t> head_{0};
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
+
+// --- Codificação dos argumentos (na thread que emite) ---
+class Encoder {
+public:
+    static constexpr size_t MAX_RECORD = 1024;
+    static constexpr size_t MAX_BYTES = 256; // limite do dump hexadecimal
+
+    Encoder(Level level, const char* format) {
+        RecordHeader h{};
+        h.level = level;
+        h.format = format;
+        h.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             SlowClock::now().time_since_epoch()).count();
+        std::memcpy(buf_.data(), &h, sizeof(h));
+        pos_ = sizeof(h);
+    }
+
+    template <typename T>
+    void arg(const T& v) {
+        using D = std::decay_t<T>;
+        if constexpr (std::is_same_v<D, bool>) {
+            put(Tag::Bool, static_cast<uint8_t>(v));
+        } else if constexpr (std::is_integral_v<D> && std::is_signed_v<D>) {
+            put(Tag::I64, static_cast<int64_t>(v));
+        } else if constexpr (std::is_integral_v<D>) {
+            put(Tag::U64, static_cast<uint64_t>(v));
+        } else if constexpr (std::is_floating_point_v<D>) {
+            put(Tag::F64, static_cast<double>(v));
+        } else if constexpr (std::is_same_v<D, Duration>) {
+            put(Tag::Dur, static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(v).count()));
+        } else if constexpr (std::is_same_v<D, std::array<uint8_t, 16>>) {
+            put_raw(Tag::Sid, v.data(), v.size());
+        } else if constexpr (std::is_same_v<D, ByteSpan>) {
+            put_blob(Tag::Bytes, v.data(), v.size(), MAX_BYTES);
+        } else {
+            std::string_view s(v);
+            put_blob(Tag::Str, reinterpret_cast<const uint8_t*>(s.data()), s.size(), MAX_RECORD);
+        }
+    }
+
+    // Fecha o registro (tamanho e número de argumentos) e devolve os bytes.
+    std::pair<const uint8_t*, size_t> finish() {
+        RecordHeader* h = reinterpret_cast<RecordHeader*>(buf_.data());
+        uint32_t size = static_cast<uint32_t>(pos_);
+        std::memcpy(&h->size, &size, sizeof(size));
+        h->nargs = nargs_;
+        return {buf_.data(), pos_};
+    }
+
+private:
+    template <typename V>
+    void put(Tag tag, V v) { put_raw(tag, &v, sizeof(v)); }
+
+    void put_raw(Tag tag, const void* data, size_t n) {
+        if (pos_ + 1 + n > MAX_RECORD) return;
+        buf_[pos_++] = static_cast<uint8_t>(tag);
+        std::memcpy(&buf_[pos_], data, n);
+        pos_ += n;
+        ++nargs_;
+    }
+
+    // Tamanho original (u32) + bytes copiados (u16), truncando ao que couber.
+    void put_blob(Tag tag, const uint8_t* data, size_t n, size_t limit) {
+        if (pos_ + 7 > MAX_RECORD) return;
+        uint32_t total = static_cast<uint32_t>(n);
+        uint16_t kept = static_cast<uint16_t>(std::min({n, limit, MAX_RECORD - pos_ - 7}));
+        buf_[pos_++] = static_cast<uint8_t>(tag);
+        std::memcpy(&buf_[pos_], &total, 4);
+        std::memcpy(&buf_[pos_ + 4], &kept, 2);
+        std::memcpy(&buf_[pos_ + 6], data, kept);
+        pos_ += 6 + kept;
+        ++nargs_;
+    }
+
+    std::array<uint8_t, MAX_RECORD> buf_;
+    size_t pos_ = 0;
+    uint8_t nargs_ = 0;
+};
+
+// --- Formatação (na thread de fundo) ---
+inline void format_record(const uint8_t* rec, std::string& out) {
+    RecordHeader h;
+    std::memcpy(&h, rec, sizeof(h));
+    const uint8_t* p = rec + sizeof(h);
+    const uint8_t* end = rec + h.size;
+    char num[64];
+
+    auto next_arg = [&]() {
+        if (p >= end) return;
+        Tag tag = static_cast<Tag>(*p++);
+        auto take = [&](auto& v) { std::memcpy(&v, p, sizeof(v)); p += sizeof(v); };
+        switch (tag) {
+            case Tag::I64: { int64_t v; take(v); out.append(num, std::snprintf(num, sizeof(num), "%lld", (long long)v)); break; }
+            case Tag::U64: { uint64_t v; take(v); out.append(num, std::snprintf(num, sizeof(num), "%llu", (unsigned long long)v)); break; }
+            case Tag::F64: { double v; take(v); out.append(num, std::snprintf(num, sizeof(num), "%g", v)); break; }
+            case Tag::Bool: { uint8_t v; take(v); out += v ? "true" : "false"; break; }
+            case Tag::Dur: { int64_t v; take(v); out.append(num, std::snprintf(num, sizeof(num), "%.3f ms", v / 1e6)); break; }
+            case Tag::Sid: {
+                std::array<uint8_t, 16> sid;
+                std::memcpy(sid.data(), p, 16);
+                p += 16;
+                out += sid_to_string(sid);
+                break;
+            }
+            case Tag::Str:
+            case Tag::Bytes: {
+                uint32_t total; uint16_t kept;
+                take(total);
+                take(kept);
+                if (tag == Tag::Str) {
+                    out.append(reinterpret_cast<const char*>(p), kept);
+                } else {
+                    out += bytes_to_hex(ByteSpan(p, kept));
+                    if (kept < total) out += "...";
+                }
+                p += kept;
+                break;
+            }
+        }
+    };
+
+    for (const char* f = h.format; *f; ++f) {
+        if (f[0] == '{' && f[1] == '}') {
+            next_arg();
+            ++f;
+        } else {
+            out += *f;
+        }
+    }
+    out += '\n';
+}
+
+// --- Thread de fundo e registro dos anéis ---
+class Logger {
+public:
+    static Logger& instance() {
+        static Logger logger;
+        return logger;
+    }
+
+    // Anel da thread corrente, criado e registrado no primeiro uso.
+    Ring& ring() {
+        thread_local std::shared_ptr<Ring> mine = register_ring();
+        return *mine;
+    }
+
+    // Espera até que tudo o que já foi emitido esteja escrito (ex.: antes de imprimir um resumo
+    // com std::cout, para não intercalar as saídas).
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        uint64_t target = ++flush_requested_;
+        wake_.notify_one();
+        flushed_.wait(lock, [&] { return flush_done_ >= target || !running_; });
+    }
+
+    uint64_t dropped() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t n = 0;
+        for (const auto& r : rings_) n += r->dropped();
+        return n;
+    }
+
+    ~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+        }
+        wake_.notify_one();
+        if (thread_.joinable()) thread_.join();
+        drain_all();
+    }
+
+private:
+    struct Pending {
+        int64_t timestamp_ns;
+        Level level;
+        size_t offset, length; // trecho já formatado em 'text'
+    };
+
+    Logger() : thread_([this] { run(); }) {}
+
+    std::shared_ptr<Ring> register_ring() {
+        auto ring = std::make_shared<Ring>();
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings_.push_back(ring);
+        return ring;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto idle_wait = std::chrono::milliseconds(1);
+        while (running_) {
+            uint64_t requested = flush_requested_;
+            lock.unlock();
+            bool wrote = drain_all();
+            lock.lock();
+            if (requested > flush_done_) {
+                flush_done_ = requested;
+                flushed_.notify_all();
+            }
+            // Quem emite nunca acorda esta thread: ela verifica os anéis a cada milissegundo
+            // enquanto há movimento e espaça as verificações (até 16 ms) quando não há.
+            if (wrote) {
+                idle_wait = std::chrono::milliseconds(1);
+            } else {
+                wake_.wait_for(lock, idle_wait);
+                idle_wait = std::min(idle_wait * 2, std::chrono::milliseconds(16));
+            }
+        }
+        flushed_.notify_all();
+    }
+
+    // Drena todos os anéis, ordena pelo instante e escreve. Retorna se havia algo.
+    bool drain_all() {
+        std::vector<std::shared_ptr<Ring>> rings;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            rings = rings_;
+        }
+        batch_.clear();
+        text_.clear();
+        for (auto& r : rings) {
+            r->drain(scratch_, [&](const uint8_t* rec) {
+                RecordHeader h;
+                std::memcpy(&h, rec, sizeof(h));
+                size_t offset = text_.size();
+                format_record(rec, text_);
+                batch_.push_back({h.timestamp_ns, h.level, offset, text_.size() - offset});
+            });
+        }
+        if (batch_.empty()) return false;
+        std::stable_sort(batch_.begin(), batch_.end(),
+                         [](const Pending& a, const Pending& b) { return a.timestamp_ns < b.timestamp_ns; });
+        out_.clear();
+        err_.clear();
+        for (const Pending& p : batch_) {
+            (p.level >= Level::Warn ? err_ : out_).append(text_, p.offset, p.length);
+        }
+        if (!out_.empty()) {
+            std::fwrite(out_.data(), 1, out_.size(), stdout);
+            std::fflush(stdout);
+        }
+        if (!err_.empty()) {
+            std::fwrite(err_.data(), 1, err_.size(), stderr);
+            std::fflush(stderr);
+        }
+        return true;
+    }
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_;
+    bool running_ = true;
+    uint64_t flush_requested_ = 0;
+    uint64_t flush_done_ = 0;
+    std::vector<std::shared_ptr<Ring>> rings_;
+    // Usados só pela thread de fundo (e pelo destrutor, depois dela).
+    std::vector<uint8_t> scratch_;
+    std::vector<Pending> batch_;
+    std::string text_, out_, err_;
+    std::thread thread_;
+};
+
+template <size_t N, typename... Args>
+inline void write(Level level, const char (&format)[N], const Args&... args) {
+    Encoder enc(level, format);
+    (enc.arg(args), ...);
+    auto [data, size] = enc.finish();
+    Logger::instance().ring().try_write(data, size);
+}
+
+inline void flush() { Logger::instance().flush(); }
+
+// Níveis desligados: os argumentos só aparecem dentro de sizeof (não avaliados, sem código), o
+// que evita avisos de variável não usada.
+template <typename... Args>
+constexpr int discard(const Args&...) { return 0; }
+
+} // namespace slowlog
+
+#if SLOW_LOG_LEVEL <= SLOW_LOG_LEVEL_TRACE
+#define SLOW_LOG_TRACE(...) ::slowlog::write(::slowlog::Level::Trace, __VA_ARGS__)
+#else
+#define SLOW_LOG_TRACE(...) ((void)sizeof(::slowlog::discard(__VA_ARGS__)))
+#endif
+
+#if SLOW_LOG_LEVEL <= SLOW_LOG_LEVEL_DEBUG
+#define SLOW_LOG_DEBUG(...) ::slowlog::write(::slowlog::Level::Debug, __VA_ARGS__)
+#else
+#define SLOW_LOG_DEBUG(...) ((void)sizeof(::slowlog::discard(__VA_ARGS__)))
+#endif
+
+#if SLOW_LOG_LEVEL <= SLOW_LOG_LEVEL_INFO
+#define SLOW_LOG_INFO(...) ::slowlog::write(::slowlog::Level::Info, __VA_ARGS__)
+#else
+#define SLOW_LOG_INFO(...) ((void)sizeof(::slowlog::discard(__VA_ARGS__)))
+#endif
+
+#if SLOW_LOG_LEVEL <= SLOW_LOG_LEVEL_WARN
+#define SLOW_LOG_WARN(...) ::slowlog::write(::slowlog::Level::Warn, __VA_ARGS__)
+#else
+#define SLOW_LOG_WARN(...) ((void)sizeof(::slowlog::discard(__VA_ARGS__)))
+#endif
+
+#if SLOW_LOG_LEVEL <= SLOW_LOG_LEVEL_ERROR
+#define SLOW_LOG_ERROR(...) ::slowlog::write(::slowlog::Level::Error, __VA_ARGS__)
+#else
+#define SLOW_LOG_ERROR(...) ((void)sizeof(::slowlog::discard(__VA_ARGS__)))
+#endif
@@ -7,317 +7,266 @@
 
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
-#include <iomanip>
-#include <cstring>
-#include <unistd.h>
-#include <sys/socket.h>
-#include <netdb.h>
-#include <sys/time.h>
-#include <arpa/inet.h>
-#include <array>
-#include <fstream>
-#include <list>
+#include <cstdlib>
+#include <ctime>
 #include <algorithm>
-#include "slow_packet.hpp"
-
-constexpr uint16_t DEFAULT_WINDOW_SIZE = 1440;
-constexpr int MAX_DATA_SIZE = 1440;
-
-// Imprime um Session ID em formato UUID padrão para melhor legibilidade.
-void print_sid(const std::array<uint8_t, 16>& sid) {
-    std::cout << std::hex << std::setfill('0');
-    for (size_t i = 0; i < sid.size(); ++i) {
-        std::cout << std::setw(2) << static_cast<int>(sid[i]);
-        if (i == 3 || i == 5 || i == 7 || i == 9) std::cout << "-";
-    }
-    std::cout << std::dec << std::setfill(' ');
-}
-
-// Imprime o conteúdo de um buffer de bytes em hexadecimal para depuração.
-void print_bytes(const std::vector<uint8_t>& buf) {
-    std::cout << "Serialized (" << buf.size() << " bytes): ";
-    for (auto b : buf)
-        std::cout << std::hex << std::setw(2) << std::setfill('0') << (int)b << ' ';
-    std::cout << std::dec << std::endl;
-}
+#include "slow_async.hpp"
+#include "session_cache.hpp"
+#include "metrics_exporter.hpp"
+#include "log.hpp"
 
 // Gera um vetor de bytes com conteúdo aleatório para testes de transmissão.
 std::vector<uint8_t> generate_random_data(size_t size) {
     std::vector<uint8_t> data(size);
-    srand(time(nullptr));
     for (size_t i = 0; i < size; ++i) {
         data[i] = rand() % 256;
     }
     return data;
 }
 
-// --- Estrutura para Pacotes Pendentes (Janela Deslizante) ---
-struct PendingPacket {
-    uint32_t seqnum;
-    std::vector<uint8_t> buffer;
-    time_t sent_time;
+// Contadores de um cliente (uma thread); somados depois que todas terminam.
+struct ClientStats {
+    uint64_t established = 0;
+    uint64_t revived = 0;       // estabelecidas por Revive, sem handshake
+    uint64_t rejected = 0;      // Revive recusado, seguido de handshake
+    uint64_t failed = 0;
+    uint64_t bytes_acked = 0;
+
+    ClientStats& operator+=(const ClientStats& o) {
+        established += o.established;
+        revived += o.revived;
+        rejected += o.rejected;
+        failed += o.failed;
+        bytes_acked += o.bytes_acked;
+        return *this;
+    }
 };
 
-
-// --- Envio de Dados com Fragmentação e Janela Deslizante ---
-bool send_data(int sock, struct addrinfo* dest_addr,
-               std::array<uint8_t, 16>& session_sid, uint32_t& session_sttl,
-               uint32_t& next_seqnum, uint32_t& last_acknum, uint16_t& peer_window,
-               const std::vector<uint8_t>& message)
-{
-    std::cout << "\n--- INICIANDO TRANSMISSÃO DE DADOS ---" << std::endl;
-    std::cout << "Enviando " << message.size() << " bytes..." << std::endl;
-
-    size_t total_sent = 0;
-    // ID único para agrupar todos os fragmentos desta mensagem.
-    uint8_t fragment_id = rand() % 256;
-    uint8_t fragment_offset = 0;
-    std::list<PendingPacket> pending_packets;
-    size_t bytes_in_flight = 0;
-
-    // Loop principal: continua enquanto houver dados a enviar ou pacotes aguardando ACK.
-    while (total_sent < message.size() || !pending_packets.empty()) {
-        
-        // Loop de envio: preenche a janela de recepção do servidor com novos pacotes.
-        while (total_sent < message.size() && bytes_in_flight < peer_window) {
-            size_t chunk_size = std::min((size_t)MAX_DATA_SIZE, message.size() - total_sent);
-
-            // Garante que o envio do próximo fragmento não excederá a janela disponível.
-            if (bytes_in_flight + chunk_size > peer_window) {
-                if (peer_window > bytes_in_flight) {
-                    chunk_size = peer_window - bytes_in_flight;
-                } else {
-                    break;
-                }
-            }
-            if (chunk_size == 0) break;
-
-            SLOWPacket data_pkt{};
-            data_pkt.sid = session_sid;
-            data_pkt.sttl = session_sttl;
-            data_pkt.seqnum = next_seqnum;
-            data_pkt.acknum = last_acknum;
-            data_pkt.window = DEFAULT_WINDOW_SIZE;
-            data_pkt.fid = fragment_id;
-            data_pkt.fo = fragment_offset;
-            
-            // Define a flag ACK e, se não for o último fragmento, a flag More Bits.
-            data_pkt.flags = FLAG_ACK;
-            if (total_sent + chunk_size < message.size()) {
-                data_pkt.flags |= FLAG_MORE_BITS;
-            }
-
-            data_pkt.data.assign(message.begin() + total_sent, message.begin() + total_sent + chunk_size);
-            
-            auto buf = data_pkt.serialize();
-            sendto(sock, buf.data(), buf.size(), 0, dest_addr->ai_addr, dest_addr->ai_addrlen);
-
-            // Armazena o pacote enviado para possível retransmissão.
-            pending_packets.push_back({data_pkt.seqnum, buf, time(nullptr)});
-            
-            bytes_in_flight += chunk_size;
-            total_sent += chunk_size;
-            next_seqnum++;
-            fragment_offset++;
-        }
-
-        std::vector<uint8_t> rbuf(1472);
-        ssize_t len = recvfrom(sock, rbuf.data(), rbuf.size(), 0, nullptr, nullptr);
-
-        // Se uma resposta (ACK) for recebida, processa a confirmação.
-        if (len > 0) {
-            rbuf.resize(len);
-            auto resp = SLOWPacket::deserialize(rbuf);
-
-            if (resp.flags & FLAG_ACK) {
-                std::cout << "  > ACK recebido para Seqnum <== " << resp.acknum << ". Janela do servidor: " << resp.window << " bytes." << std::endl;
-                peer_window = resp.window;
-                last_acknum = resp.seqnum;
-                
-                // Libera da lista de pendentes os pacotes que foram confirmados.
-                auto it = pending_packets.begin();
-                while(it != pending_packets.end()) {
-                    if (it->seqnum <= resp.acknum) {
-                        bytes_in_flight -= (it->buffer.size() - 32);
-                        it = pending_packets.erase(it);
-                    } else {
-                        ++it;
-                    }
-                }
-            }
-        } else { // Se não houver resposta (timeout), retransmite os pacotes pendentes.
-            std::cout << "  > Timeout! Retransmitindo pacotes pendentes..." << std::endl;
-            for (const auto& pending : pending_packets) {
-                 if (time(nullptr) - pending.sent_time > 1) {
-                    sendto(sock, pending.buffer.data(), pending.buffer.size(), 0, dest_addr->ai_addr, dest_addr->ai_addrlen);
-                 }
-            }
+// Uma transferência completa: conecta (ou revive, se a chave estiver no cache), envia a
+// mensagem, desconecta e guarda a sessão no cache para a próxima vez.
+slow::Task<void> transfer(slow::SlowClient& client, SessionCache& cache, std::string key,
+                          std::unique_ptr<PayloadSource> payload, ClientStats& stats) {
+    slow::Session session = client.session();
+    try {
+        std::optional<CachedSession> cached;
+        if (payload) cached = cache.take(key);
+        if (cached) {
+            // O 0-way connect leva a mensagem no próprio Revive.
+            co_await session.revive(*cached, std::move(payload));
+        } else {
+            co_await session.connect();
+            if (payload) co_await session.send(std::move(payload));
         }
+        ++stats.established;
+        if (session.revived()) ++stats.revived;
+        if (session.raw().revive_rejected()) ++stats.rejected;
+        co_await session.close();
+    } catch (const slow::SessionError&) {
+        // O estado final da sessão (abaixo) já diz que ela falhou.
     }
-    std::cout << "## TRANSMISSÃO DE DADOS CONCLUÍDA ##" << std::endl;
-    return true;
-}
-
-// --- Função para Desconectar ---
-void disconnect(int sock, struct addrinfo* dest_addr,
-                std::array<uint8_t, 16>& session_sid, uint32_t& session_sttl,
-                uint32_t& next_seqnum, uint32_t& last_acknum)
-{
-    std::cout << "\n## ENCERRANDO SESSÃO ##" << std::endl;
-    SLOWPacket disc_pkt{};
-    disc_pkt.sid = session_sid;
-    disc_pkt.sttl = session_sttl;
-    // Conforme especificação, a combinação das flags Connect, Revive e Ack sinaliza um Disconnect.
-    disc_pkt.flags = FLAG_CONNECT | FLAG_REVIVE | FLAG_ACK;
-    disc_pkt.seqnum = next_seqnum;
-    disc_pkt.acknum = last_acknum;
-    
-    auto buf = disc_pkt.serialize();
-    sendto(sock, buf.data(), buf.size(), 0, dest_addr->ai_addr, dest_addr->ai_addrlen);
-    std::cout << "Disconnect enviado => Sessão encerrada!" << std::endl;
+    stats.bytes_acked += session.raw().metrics().get(Counter::BytesAcked);
+    if (session.state() != SessionState::Closed) ++stats.failed;
+    if (auto entry = session.resumption()) cache.store(key, *entry);
 }
 
 
 int main(int argc, char* argv[]) {
     std::cout << "=== SLOW Peripheral v2.0 ===" << std::endl;
-    if (argc < 2 || argc > 3) {
-        std::cerr << "Uso: " << argv[0] << " <host> [porta]" << std::endl;
-        return 1;
+    // Argumentos posicionais: <host> [porta]; opções: --io=<backend>, --sessions=<N>, --workers=<N>,
+    // --file=<caminho> (arquivo, FIFO ou "-" para a entrada padrão, transmitido em fluxo),
+    // --cache=<caminho> (cache de sessões para o Revive, preservado entre execuções),
+    // --record=<caminho> (trace dos datagramas, para o slow_sim --replay),
+    // --cc=<algoritmo> (controle de congestionamento), --no-pacing e
+    // --metrics=<arquivo|unix:caminho> [--metrics-format=json|prometheus] [--metrics-interval=MS].
+    std::vector<const char*> positional;
+    std::string file_path;
+    std::string cache_path;
+    std::string record_path;
+    IOBackend io_backend = IOBackend::Auto;
+    CongestionAlgorithm congestion = CongestionAlgorithm::None;
+    bool pacing = true;
+    MetricsExporter::Config metrics_cfg;
+    size_t session_count = 1;
+    size_t worker_count = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--io=", 0) == 0) {
+            if (!parse_io_backend(arg.substr(5), io_backend)) {
+                std::cerr << "Backend de E/S desconhecido: " << arg.substr(5) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--sessions=", 0) == 0) {
+            session_count = std::max<size_t>(1, std::strtoull(arg.c_str() + 11, nullptr, 10));
+        } else if (arg.rfind("--workers=", 0) == 0) {
+            worker_count = std::max<size_t>(1, std::strtoull(arg.c_str() + 10, nullptr, 10));
+        } else if (arg.rfind("--file=", 0) == 0) {
+            file_path = arg.substr(7);
+        } else if (arg.rfind("--cache=", 0) == 0) {
+            cache_path = arg.substr(8);
+        } else if (arg.rfind("--record=", 0) == 0) {
+            record_path = arg.substr(9);
+        } else if (arg.rfind("--cc=", 0) == 0) {
+            if (!parse_congestion_algorithm(arg.substr(5), congestion)) {
+                std::cerr << "Controle de congestionamento desconhecido: " << arg.substr(5) << std::endl;
+                return 1;
+            }
+        } else if (arg == "--no-pacing") {
+            pacing = false;
+        } else if (arg.rfind("--metrics=", 0) == 0) {
+            metrics_cfg.target = arg.substr(10);
+        } else if (arg.rfind("--metrics-format=", 0) == 0) {
+            if (!parse_metrics_format(arg.substr(17), metrics_cfg.format)) {
+                std::cerr << "Formato de métricas desconhecido: " << arg.substr(17) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--metrics-interval=", 0) == 0) {
+            metrics_cfg.interval = std::chrono::milliseconds(std::max(1L, std::strtol(arg.c_str() + 19, nullptr, 10)));
+        } else {
+            positional.push_back(argv[i]);
+        }
     }
-
-    const char* host = argv[1];
-    const char* port = (argc == 3 ? argv[2] : "7033");
-
-    // Configuração inicial do socket e resolução de endereço.
-    struct addrinfo hints{}, *res, *rp;
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_DGRAM;
-    if (getaddrinfo(host, port, &hints, &res) != 0) {
-        perror("getaddrinfo");
+    if (positional.empty() || positional.size() > 2) {
+        std::cerr << "Uso: " << argv[0] << " <host> [porta] [--io=simple|mmsg|gso|uring|auto] [--sessions=N] [--workers=N] [--file=CAMINHO|-] [--cache=CAMINHO] [--record=CAMINHO]"
+                  << " [--cc=none|newreno|delay] [--no-pacing]"
+                  << " [--metrics=ARQUIVO|unix:CAMINHO] [--metrics-format=json|prometheus] [--metrics-interval=MS]" << std::endl;
         return 1;
     }
-
-    int sock = -1;
-    for (rp = res; rp != nullptr; rp = rp->ai_next) {
-        sock = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-        if (sock >= 0) break;
-    }
-    if (sock < 0) {
-        perror("socket");
-        freeaddrinfo(res);
+    if (file_path == "-" && session_count > 1) {
+        std::cerr << "A entrada padrão só pode ser transmitida por uma sessão." << std::endl;
         return 1;
     }
 
-    struct timeval tv{2, 0};
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-
-    // --- Montagem do Pacote CONNECT (com flag correta do enum corrigido) ---
-    SLOWPacket connect_pkt{};
-    connect_pkt.sid = {}; // UUID nulo
-    connect_pkt.flags = FLAG_CONNECT; // Usa o valor (16) do enum
-    connect_pkt.sttl = 0;
-    connect_pkt.seqnum = 0;
-    connect_pkt.acknum = 0;
-    connect_pkt.window = DEFAULT_WINDOW_SIZE;
-    connect_pkt.fid = 0;
-    connect_pkt.fo = 0;
+    const char* host = positional[0];
+    const char* port = (positional.size() == 2 ? positional[1] : "7033");
 
-    auto buf = connect_pkt.serialize();
+    // Resolução de endereço.
+    slow::Endpoint central;
+    try {
+        central = slow::resolve_endpoint(host, port);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
 
     std::cout << "Resolvendo para " << host << ":" << port << std::endl;
+    srand(time(nullptr));
 
-    const int max_retries = 3;
-    bool accepted = false;
-    std::array<uint8_t, 16> session_sid;
-    uint32_t session_sttl = 0;
-    uint32_t next_seqnum = 0;
-    uint32_t last_acknum = 0;
-    uint16_t peer_window = 0;
+    // Sessões encerradas ficam no cache e, dentro do STTL, a próxima conexão com a mesma chave
+    // é feita por Revive. Com --cache, o cache vem da execução anterior e é salvo ao final.
+    SessionCache cache;
+    if (!cache_path.empty() && !cache.load(cache_path)) {
+        std::cerr << "Cache de sessões inválido em " << cache_path << "; ignorando." << std::endl;
+    }
 
-    // --- PASSO 1 e 2 DO HANDSHAKE: Enviar CONNECT e esperar ACCEPT ---
-    for (int attempt = 0; attempt < max_retries && !accepted; ++attempt) {
-        print_bytes(buf);
-        std::cout << "Enviando CONNECT (tentativa " << (attempt + 1) << ")..." << std::endl;
-        sendto(sock, buf.data(), buf.size(), 0, rp->ai_addr, rp->ai_addrlen);
+    // Cada worker é uma thread com o seu próprio SlowClient (socket e laço de eventos); as
+    // sessões são distribuídas entre eles pela chave.
+    MetricsRegistry metrics;
+    std::vector<slow::ClientConfig> client_cfgs(worker_count);
+    for (size_t w = 0; w < worker_count; ++w) {
+        slow::ClientConfig& cfg = client_cfgs[w];
+        cfg.backend = io_backend;
+        // Com várias sessões simultâneas, o detalhamento pacote a pacote só atrapalha.
+        cfg.session.verbose = (session_count == 1);
+        cfg.session.congestion = congestion;
+        cfg.session.pacing = pacing;
+        cfg.metrics = &metrics.register_thread("worker-" + std::to_string(w));
+        // Um trace por worker: cada um tem o seu socket.
+        if (!record_path.empty()) cfg.record_path = worker_count == 1 ? record_path : record_path + "." + std::to_string(w);
+    }
+    // Os clientes (e os traces) duram as duas fases; cada fase roda um por thread.
+    std::vector<std::unique_ptr<slow::SlowClient>> clients;
+    try {
+        for (size_t w = 0; w < worker_count; ++w) clients.push_back(std::make_unique<slow::SlowClient>(central, client_cfgs[w]));
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
 
-        std::vector<uint8_t> rbuf(1472);
-        ssize_t len = recvfrom(sock, rbuf.data(), rbuf.size(), 0, nullptr, nullptr);
+    // Exportação periódica, se pedida; o resumo final sai de qualquer forma.
+    std::unique_ptr<MetricsExporter> exporter;
+    if (!metrics_cfg.target.empty()) {
+        try {
+            exporter = std::make_unique<MetricsExporter>(metrics, metrics_cfg);
+            exporter->start();
+        } catch (const std::exception& e) {
+            std::cerr << "Erro ao iniciar a exportação de métricas: " << e.what() << std::endl;
+            return 1;
+        }
+    }
 
-        if (len > 0) {
-            rbuf.resize(len);
-            std::cout << "Resposta recebida:" << std::endl;
-            try {
-                auto resp = SLOWPacket::deserialize(rbuf);
-                // Verifica se é uma resposta de ACCEPT válida (bit de aceite ligado).
-                if (resp.flags & FLAG_ACCEPT_REJECT) {
-                    std::cout << "Conexão ACEITA pelo Central (passo 2/3 do handshake)." << std::endl;
-                    session_sid = resp.sid;
-                    session_sttl = resp.sttl;
-                    // O primeiro seqnum da sessão é o que o servidor me dá.
-                    // O próximo que enviaremos será ele.
-                    // O acknum que eu envio é o seqnum que que eu recebo.
-                    next_seqnum = resp.seqnum;
-                    last_acknum = resp.seqnum;
-                    peer_window = resp.window;
-                    accepted = true;
-                    std::cout << "  > Session ID: ";
-                    print_sid(session_sid);
-                    std::cout << "\n  > Session STTL: " << session_sttl << " ms" << std::endl;
-                    std::cout << "  > Janela inicial do servidor: " << peer_window << " bytes" << std::endl;
-                } else {
-                    std::cerr << "Conexão REJEITADA pelo Central (flags=" << (int)resp.flags << ")" << std::endl;
-                    if (!resp.data.empty()) {
-                        std::string msg(resp.data.begin(), resp.data.end());
-                        std::cerr << "  > Mensagem do servidor: " << msg << std::endl;
+    // Roda uma transferência por chave, com a mensagem payloads[chave], e soma os contadores.
+    auto run_phase = [&](std::vector<std::unique_ptr<PayloadSource>>& payloads) {
+        std::vector<ClientStats> stats(worker_count);
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < worker_count; ++w) {
+            threads.emplace_back([&, w] {
+                slow::SlowClient& client = *clients[w];
+                try {
+                    for (uint64_t key = w; key < session_count; key += worker_count) {
+                        std::string cache_key = SessionCache::key_for(central.sockaddr_ptr(), central.len, key);
+                        client.spawn(transfer(client, cache, std::move(cache_key), std::move(payloads[key]), stats[w]));
                     }
+                    client.run();
+                } catch (const std::exception& e) {
+                    std::cerr << "Erro no worker " << w << ": " << e.what() << std::endl;
+                    ++stats[w].failed;
                 }
-            } catch (const std::exception& e) {
-                std::cerr << "Erro ao decodificar resposta: " << e.what() << std::endl;
-            }
+            });
+        }
+        ClientStats total;
+        for (size_t w = 0; w < worker_count; ++w) {
+            threads[w].join();
+            total += stats[w];
+        }
+        // O log das sessões é escrito por outra thread: esvazia-o antes do resumo.
+        slowlog::flush();
+        return total;
+    };
+
+    // Cada sessão transmite o arquivo (ou um bloco de dados de teste) e depois se desconecta.
+    std::vector<std::unique_ptr<PayloadSource>> payloads(session_count);
+    for (uint64_t key = 0; key < session_count; ++key) {
+        if (file_path.empty()) {
+            payloads[key] = std::make_unique<MemorySource>(generate_random_data(15000));
         } else {
-            perror("recvfrom (Timeout)");
+            payloads[key] = open_payload_source(file_path);
+            if (!payloads[key]) return 1;   // o motivo já foi impresso
         }
     }
-
-    if (!accepted) {
-        std::cerr << "Falha ao estabelecer conexão após " << max_retries << " tentativas." << std::endl;
-        close(sock);
-        return 1;
-    }
-
-    // --- PASSO 3 DO HANDSHAKE: Enviar confirmação ACK para finalizar ---
-    std::cout << "\nEnviando confirmação ACK para finalizar o handshake (passo 3/3)..." << std::endl;
-    SLOWPacket confirm_pkt{};
-    confirm_pkt.sid = session_sid;
-    confirm_pkt.sttl = session_sttl;
-    confirm_pkt.flags = FLAG_ACK;
-    confirm_pkt.seqnum = next_seqnum; // Envia o mesmo seqnum recebido, conforme especificação de pacote ACK puro.
-    confirm_pkt.acknum = last_acknum; // acknum confirmando o pacote ACCEPT do servidor
-    confirm_pkt.window = DEFAULT_WINDOW_SIZE;
-
-    auto confirm_buf = confirm_pkt.serialize();
-    print_bytes(confirm_buf);
-    sendto(sock, confirm_buf.data(), confirm_buf.size(), 0, rp->ai_addr, rp->ai_addrlen);
-    
-    // Neste ponto, a especificação considera a conexão estabelecida.
-    std::cout << "\nConexão estabelecida com sucesso! Pronto para transmitir dados." << std::endl;
-
-    // chama a NOVA LÓGICA DE ENVIO DE DADOS
-    std::vector<uint8_t> message = generate_random_data(15000);
-    if (!send_data(sock, rp, session_sid, session_sttl, next_seqnum, last_acknum, peer_window, message)) {
-        std::cerr << "Falha durante a transmissão de dados." << std::endl;
-    }
-
-    // chama a NOVA LÓGICA DE DESCONEXÃO
-    disconnect(sock, rp, session_sid, session_sttl, next_seqnum, last_acknum);
+    auto start = SlowClock::now();
+    ClientStats first = run_phase(payloads);
+    double elapsed = std::chrono::duration<double>(SlowClock::now() - start).count();
+    std::cout << "\n## " << first.established << "/" << session_count << " sessões estabelecidas em "
+              << worker_count << " worker(s), " << first.bytes_acked << " bytes confirmados em " << elapsed
+              << " s, " << first.failed << " falha(s) ##" << std::endl;
 
     // Revivendo a sessão para enviar mais dados
     std::cout << "\n### TESTANDO 0-WAY CONNECT ==> REVIVE ###" << std::endl;
-    std::vector<uint8_t> outra_mensagem = generate_random_data(1000);
- 
-
-    freeaddrinfo(res);
-    close(sock);
-    return 0;
+    for (uint64_t key = 0; key < session_count; ++key) {
+        // Mesma chave => o cache fornece sid e seqnums, e a mensagem vai no próprio Revive.
+        payloads[key] = std::make_unique<MemorySource>(generate_random_data(1000));
+    }
+    start = SlowClock::now();
+    ClientStats second = run_phase(payloads);
+    elapsed = std::chrono::duration<double>(SlowClock::now() - start).count();
+    uint64_t failed = first.failed + second.failed;
+    std::cout << "\n## " << second.revived << "/" << session_count << " sessões revividas (0-way), " << second.rejected
+              << " recusada(s) com handshake completo, em " << elapsed << " s, " << failed << " falha(s) ##" << std::endl;
+
+    if (exporter) exporter->stop();
+    MetricsSnapshot snap = metrics.snapshot();
+    const HistogramData& rtt = snap.histogram(Histogram::Rtt);
+    const HistogramData& hs = snap.histogram(Histogram::Handshake);
+    std::cout << "\n## Métricas: " << snap.get(Counter::PacketsSent) << " pacotes enviados, "
+              << snap.get(Counter::Retransmits) << " retransmitidos, " << snap.get(Counter::Timeouts)
+              << " timeout(s), " << snap.get(Counter::WindowStallNs) / 1e6 << " ms esperando janela | RTT p50 "
+              << rtt.percentile(0.5) / 1e3 << " us, p99 " << rtt.percentile(0.99) / 1e3 << " us | handshake p50 "
+              << hs.percentile(0.5) / 1e3 << " us ##" << std::endl;
+
+    if (!cache_path.empty() && !cache.save(cache_path)) {
+        std::cerr << "Não foi possível salvar o cache de sessões em " << cache_path << std::endl;
+    }
+    return failed == 0 ? 0 : 1;
 }
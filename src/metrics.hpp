@@ -0,0 +1,280 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "slow_clock.hpp"
+
+// --- Métricas do peripheral ---
+//
+// Cada sessão mantém os seus contadores (lidos só pela thread dona) e, se estiver ligada a um
+// ThreadMetrics, soma neles também. Há um ThreadMetrics por worker: um único escritor, então os
+// incrementos são load + store relaxados, sem instrução atômica de leitura-modificação-escrita
+// nem disputa de cache entre threads. Os histogramas ficam só no nível da thread. Quem quiser
+// uma visão geral pede um snapshot ao MetricsRegistry, que soma todas as threads sem pará-las.
+
+enum class Counter : uint8_t {
+    PacketsSent,      // fragmentos de dados, sem contar retransmissões
+    BytesSent,        // bytes de dados desses fragmentos
+    PacketsAcked,
+    BytesAcked,
+    Retransmits,
+    FastRetransmits,  // retransmissões disparadas por ACKs duplicados (parte de Retransmits)
+    Timeouts,         // RTOs e timeouts de handshake
+    SpuriousTimeouts, // RTOs desfeitos ao se revelarem espúrios (parte de Timeouts)
+    WindowStallNs,    // tempo com dados na fila, mas sem espaço na janela (ns)
+    MessagesAcked,
+    MessagesReceived,
+    BytesReceived,
+    PureAcksSent,
+    Handshakes,       // handshakes completos (CONNECT/ACCEPT)
+    Revives,          // sessões retomadas por Revive
+    Disconnects,
+    Count
+};
+
+constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::Count);
+
+struct CounterInfo {
+    const char* name;        // nome no JSON
+    const char* prom_name;   // nome no Prometheus (sufixo _total por ser contador)
+    uint64_t prom_divisor;   // para a unidade do Prometheus (1e9: segundos, em vez de ns)
+};
+
+inline const CounterInfo& counter_info(Counter c) {
+    static const std::array<CounterInfo, COUNTER_COUNT> table{{
+        {"packets_sent", "slow_packets_sent_total", 1},
+        {"bytes_sent", "slow_bytes_sent_total", 1},
+        {"packets_acked", "slow_packets_acked_total", 1},
+        {"bytes_acked", "slow_bytes_acked_total", 1},
+        {"retransmits", "slow_retransmits_total", 1},
+        {"fast_retransmits", "slow_fast_retransmits_total", 1},
+        {"timeouts", "slow_timeouts_total", 1},
+        {"spurious_timeouts", "slow_spurious_timeouts_total", 1},
+        {"window_stall_ns", "slow_window_stall_seconds_total", 1000000000},
+        {"messages_acked", "slow_messages_acked_total", 1},
+        {"messages_received", "slow_messages_received_total", 1},
+        {"bytes_received", "slow_bytes_received_total", 1},
+        {"pure_acks_sent", "slow_pure_acks_sent_total", 1},
+        {"handshakes", "slow_handshakes_total", 1},
+        {"revives", "slow_revives_total", 1},
+        {"disconnects", "slow_disconnects_total", 1},
+    }};
+    return table[static_cast<size_t>(c)];
+}
+
+enum class Histogram : uint8_t {
+    Rtt,              // amostras de RTT (regra de Karn)
+    MessageLatency,   // do send() até o ACK do último fragmento
+    Handshake,        // do primeiro CONNECT até o ACCEPT
+    Count
+};
+
+constexpr size_t HISTOGRAM_COUNT = static_cast<size_t>(Histogram::Count);
+
+inline const char* histogram_name(Histogram h) {
+    switch (h) {
+        case Histogram::Rtt:            return "rtt";
+        case Histogram::MessageLatency: return "message_latency";
+        case Histogram::Handshake:      return "handshake";
+        case Histogram::Count:          break;
+    }
+    return "?";
+}
+
+// --- Histograma log-linear (estilo HDR) ---
+// Valores em ns. Cada potência de dois é dividida em 16 faixas iguais, o que dá erro relativo
+// de no máximo 1/16 (~6%) em qualquer escala, de nanossegundos a horas, com 976 contadores
+// fixos: registrar um valor é um clz e um incremento, sem alocação.
+struct HistogramData {
+    static constexpr unsigned SUB_BITS = 4;
+    static constexpr size_t SUB = size_t(1) << SUB_BITS;
+    static constexpr size_t BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    std::array<uint64_t, BUCKETS> counts{};
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+
+    static size_t bucket_of(uint64_t v) {
+        if (v < SUB) return static_cast<size_t>(v);
+        unsigned e = 63 - static_cast<unsigned>(__builtin_clzll(v));
+        size_t sub = static_cast<size_t>(v >> (e - SUB_BITS)) - SUB;
+        return (e - SUB_BITS + 1) * SUB + sub;
+    }
+
+    // Ponto médio da faixa do bucket.
+    static uint64_t value_of(size_t idx) {
+        if (idx < SUB) return idx;
+        unsigned e = static_cast<unsigned>(idx / SUB) + SUB_BITS - 1;
+        uint64_t width = uint64_t(1) << (e - SUB_BITS);
+        uint64_t lower = (SUB + idx % SUB) * width;
+        return lower + width / 2;
+    }
+
+    void merge(const HistogramData& other) {
+        for (size_t i = 0; i < BUCKETS; ++i) counts[i] += other.counts[i];
+        count += other.count;
+        sum += other.sum;
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+
+    // Percentil p (0..1), limitado ao mínimo e ao máximo exatos.
+    uint64_t percentile(double p) const {
+        if (count == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(p * (count - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen < rank) continue;
+            // Um snapshot concorrente pode ver a contagem antes do mínimo e do máximo.
+            return min <= max ? std::clamp(value_of(i), min, max) : value_of(i);
+        }
+        return max;
+    }
+
+    double mean() const { return count ? static_cast<double>(sum) / count : 0; }
+};
+
+// Versão com um escritor e leitores concorrentes, para os histogramas de cada thread.
+class AtomicHistogram {
+public:
+    // O mínimo e o máximo vêm antes da contagem, que é publicada por último (release): quem lê
+    // a contagem com acquire vê também os limites de cada amostra contada.
+    void record(uint64_t v) {
+        if (v < min_.load(std::memory_order_relaxed)) min_.store(v, std::memory_order_relaxed);
+        if (v > max_.load(std::memory_order_relaxed)) max_.store(v, std::memory_order_relaxed);
+        bump(counts_[HistogramData::bucket_of(v)], 1);
+        bump(sum_, v);
+        count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void add_to(HistogramData& out) const {
+        out.count += count_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < HistogramData::BUCKETS; ++i) out.counts[i] += counts_[i].load(std::memory_order_relaxed);
+        out.sum += sum_.load(std::memory_order_relaxed);
+        out.min = std::min(out.min, min_.load(std::memory_order_relaxed));
+        out.max = std::max(out.max, max_.load(std::memory_order_relaxed));
+    }
+
+private:
+    static void bump(std::atomic<uint64_t>& a, uint64_t n) {
+        a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<uint64_t>, HistogramData::BUCKETS> counts_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> min_{UINT64_MAX};
+    std::atomic<uint64_t> max_{0};
+};
+
+// Métricas de uma thread (um worker). Só a thread dona escreve.
+class ThreadMetrics {
+public:
+    explicit ThreadMetrics(std::string name) : name_(std::move(name)) {}
+
+    const std::string& name() const { return name_; }
+
+    void add(Counter c, uint64_t n) {
+        auto& a = counters_[static_cast<size_t>(c)];
+        a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void record(Histogram h, Duration d) {
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        histograms_[static_cast<size_t>(h)].record(static_cast<uint64_t>(std::max<int64_t>(0, ns)));
+    }
+
+    uint64_t get(Counter c) const { return counters_[static_cast<size_t>(c)].load(std::memory_order_relaxed); }
+
+    void add_to(std::array<uint64_t, COUNTER_COUNT>& counters, std::array<HistogramData, HISTOGRAM_COUNT>& hists) const {
+        for (size_t i = 0; i < COUNTER_COUNT; ++i) counters[i] += counters_[i].load(std::memory_order_relaxed);
+        for (size_t i = 0; i < HISTOGRAM_COUNT; ++i) histograms_[i].add_to(hists[i]);
+    }
+
+private:
+    std::string name_;
+    alignas(64) std::array<std::atomic<uint64_t>, COUNTER_COUNT> counters_{};
+    std::array<AtomicHistogram, HISTOGRAM_COUNT> histograms_;
+};
+
+// Contadores de uma sessão, repassados também à thread, se houver.
+class SessionMetrics {
+public:
+    void attach(ThreadMetrics* sink) { sink_ = sink; }
+
+    void add(Counter c, uint64_t n = 1) {
+        counters_[static_cast<size_t>(c)] += n;
+        if (sink_) sink_->add(c, n);
+    }
+
+    void record(Histogram h, Duration d) {
+        if (sink_) sink_->record(h, d);
+    }
+
+    uint64_t get(Counter c) const { return counters_[static_cast<size_t>(c)]; }
+
+    Duration handshake_duration() const { return handshake_; }
+    void set_handshake_duration(Duration d) {
+        handshake_ = d;
+        record(Histogram::Handshake, d);
+    }
+
+private:
+    std::array<uint64_t, COUNTER_COUNT> counters_{};
+    Duration handshake_{};
+    ThreadMetrics* sink_ = nullptr;
+};
+
+struct MetricsSnapshot {
+    struct Thread {
+        std::string name;
+        std::array<uint64_t, COUNTER_COUNT> counters{};
+    };
+
+    int64_t timestamp_ms = 0;
+    std::array<uint64_t, COUNTER_COUNT> counters{};        // soma de todas as threads
+    std::array<HistogramData, HISTOGRAM_COUNT> histograms; // idem
+    std::vector<Thread> threads;
+
+    uint64_t get(Counter c) const { return counters[static_cast<size_t>(c)]; }
+    const HistogramData& histogram(Histogram h) const { return histograms[static_cast<size_t>(h)]; }
+};
+
+// Conjunto das métricas do processo. Registrar uma thread toma um mutex (uma vez, na criação
+// do worker); o snapshot lê os contadores sem interromper ninguém.
+class MetricsRegistry {
+public:
+    ThreadMetrics& register_thread(std::string name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threads_.push_back(std::make_unique<ThreadMetrics>(std::move(name)));
+        return *threads_.back();
+    }
+
+    MetricsSnapshot snapshot() const {
+        MetricsSnapshot snap;
+        snap.timestamp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                std::chrono::system_clock::now().time_since_epoch()).count();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& t : threads_) {
+            MetricsSnapshot::Thread thread;
+            thread.name = t->name();
+            t->add_to(thread.counters, snap.histograms);
+            for (size_t i = 0; i < COUNTER_COUNT; ++i) snap.counters[i] += thread.counters[i];
+            snap.threads.push_back(std::move(thread));
+        }
+        return snap;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadMetrics>> threads_;
+};
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "metrics.hpp"
+
+enum class MetricsFormat {
+    JsonLines,   // um objeto JSON por linha, um por intervalo
+    Prometheus   // formato texto de exposição do Prometheus
+};
+
+inline bool parse_metrics_format(const std::string& name, MetricsFormat& out) {
+    if (name == "json")            out = MetricsFormat::JsonLines;
+    else if (name == "prometheus") out = MetricsFormat::Prometheus;
+    else return false;
+    return true;
+}
+
+// --- Formatação de um snapshot ---
+
+// Valores fracionários saem com a menor representação que relê o mesmo double: a precisão
+// padrão do ostream (6 dígitos) arredondaria totais grandes, como 1234567.891 para 1.23457e+06.
+struct Decimal {
+    double value;
+};
+
+inline std::ostream& operator<<(std::ostream& out, Decimal d) {
+    char buf[32];
+    auto res = std::to_chars(buf, buf + sizeof(buf), d.value);
+    return out.write(buf, res.ptr - buf);
+}
+
+inline void write_histogram_json(std::ostream& out, const HistogramData& h) {
+    // Em microssegundos, mais legíveis que ns para RTT e latência.
+    auto us = [](double ns) { return Decimal{ns / 1e3}; };
+    out << "{\"count\":" << h.count;
+    if (h.count) {
+        out << ",\"min_us\":" << us(h.min) << ",\"mean_us\":" << us(h.mean())
+            << ",\"p50_us\":" << us(h.percentile(0.50)) << ",\"p90_us\":" << us(h.percentile(0.90))
+            << ",\"p99_us\":" << us(h.percentile(0.99)) << ",\"p999_us\":" << us(h.percentile(0.999))
+            << ",\"max_us\":" << us(h.max);
+    }
+    out << "}";
+}
+
+inline std::string format_json(const MetricsSnapshot& snap) {
+    std::ostringstream out;
+    auto counters = [&](const std::array<uint64_t, COUNTER_COUNT>& values) {
+        out << "{";
+        for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+            out << (i ? "," : "") << "\"" << counter_info(static_cast<Counter>(i)).name << "\":" << values[i];
+        }
+        out << "}";
+    };
+    out << "{\"ts_ms\":" << snap.timestamp_ms << ",\"counters\":";
+    counters(snap.counters);
+    out << ",\"histograms\":{";
+    for (size_t i = 0; i < HISTOGRAM_COUNT; ++i) {
+        out << (i ? "," : "") << "\"" << histogram_name(static_cast<Histogram>(i)) << "\":";
+        write_histogram_json(out, snap.histograms[i]);
+    }
+    out << "},\"threads\":[";
+    for (size_t t = 0; t < snap.threads.size(); ++t) {
+        out << (t ? "," : "") << "{\"name\":\"" << snap.threads[t].name << "\",\"counters\":";
+        counters(snap.threads[t].counters);
+        out << "}";
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+// Contadores por thread (rótulo 'thread') e histogramas como 'summary', em segundos. Os
+// contadores sem escala saem como inteiros, exatos em qualquer magnitude.
+inline std::string format_prometheus(const MetricsSnapshot& snap) {
+    std::ostringstream out;
+    for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+        const CounterInfo& info = counter_info(static_cast<Counter>(i));
+        out << "# TYPE " << info.prom_name << " counter\n";
+        for (const auto& t : snap.threads) {
+            out << info.prom_name << "{thread=\"" << t.name << "\"} ";
+            if (info.prom_divisor == 1) out << t.counters[i];
+            else out << Decimal{static_cast<double>(t.counters[i]) / info.prom_divisor};
+            out << "\n";
+        }
+    }
+    for (size_t i = 0; i < HISTOGRAM_COUNT; ++i) {
+        const HistogramData& h = snap.histograms[i];
+        std::string name = std::string("slow_") + histogram_name(static_cast<Histogram>(i)) + "_seconds";
+        out << "# TYPE " << name << " summary\n";
+        for (double q : {0.5, 0.9, 0.99, 0.999}) {
+            out << name << "{quantile=\"" << q << "\"} " << Decimal{h.percentile(q) / 1e9} << "\n";
+        }
+        out << name << "_sum " << Decimal{h.sum / 1e9} << "\n" << name << "_count " << h.count << "\n";
+    }
+    return out.str();
+}
+
+inline std::string format_snapshot(const MetricsSnapshot& snap, MetricsFormat format) {
+    return format == MetricsFormat::Prometheus ? format_prometheus(snap) : format_json(snap);
+}
+
+// --- Exportador periódico ---
+//
+// Uma thread à parte tira um snapshot a cada 'interval' e o publica em 'target':
+//   - caminho de arquivo: JSON lines são acrescentadas ao arquivo; no formato Prometheus o
+//     arquivo é substituído inteiro a cada vez (via rename, como espera o textfile collector
+//     do node_exporter);
+//   - "unix:<caminho>": escuta num socket Unix de stream e entrega o snapshot do momento a cada
+//     conexão (ex.: socat - UNIX-CONNECT:<caminho>), que é fechada em seguida.
+// Ao parar, publica um último snapshot, para que o arquivo reflita o fim da execução.
+class MetricsExporter {
+public:
+    struct Config {
+        std::string target;
+        MetricsFormat format = MetricsFormat::JsonLines;
+        Duration interval = std::chrono::seconds(1);
+    };
+
+    MetricsExporter(const MetricsRegistry& registry, const Config& cfg) : registry_(registry), cfg_(cfg) {
+        stop_fd_ = eventfd(0, EFD_CLOEXEC);
+        if (stop_fd_ < 0) throw std::runtime_error("eventfd falhou");
+        if (cfg_.target.rfind("unix:", 0) == 0) {
+            socket_path_ = cfg_.target.substr(5);
+            listen_fd_ = open_unix_listener(socket_path_);
+        }
+    }
+
+    ~MetricsExporter() {
+        stop();
+        if (listen_fd_ >= 0) {
+            ::close(listen_fd_);
+            unlink(socket_path_.c_str());
+        }
+        ::close(stop_fd_);
+    }
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    void start() {
+        thread_ = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        if (!thread_.joinable()) return;
+        uint64_t one = 1;
+        ssize_t r = ::write(stop_fd_, &one, sizeof(one));
+        (void)r;
+        thread_.join();
+    }
+
+private:
+    static int open_unix_listener(const std::string& path) {
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) throw std::runtime_error("Caminho de socket Unix longo demais");
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) throw std::runtime_error("socket(AF_UNIX) falhou");
+        unlink(path.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+            ::close(fd);
+            throw std::runtime_error("Não foi possível escutar em " + path + ": " + std::strerror(errno));
+        }
+        return fd;
+    }
+
+    void run() {
+        TimePoint next = SlowClock::now() + cfg_.interval;
+        for (;;) {
+            pollfd fds[2] = {{stop_fd_, POLLIN, 0}, {listen_fd_, POLLIN, 0}};
+            int wait_ms = static_cast<int>(std::max<int64_t>(0, to_ms(next - SlowClock::now())));
+            int n = poll(fds, listen_fd_ >= 0 ? 2 : 1, wait_ms);
+            if (n > 0 && (fds[0].revents & POLLIN)) break;
+            if (n > 0 && listen_fd_ >= 0 && (fds[1].revents & POLLIN)) serve_client();
+            if (SlowClock::now() >= next) {
+                if (listen_fd_ < 0) publish_file();
+                next += cfg_.interval;
+            }
+        }
+        if (listen_fd_ < 0) publish_file();
+    }
+
+    void serve_client() {
+        int client = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) return;
+        std::string text = format_snapshot(registry_.snapshot(), cfg_.format);
+        size_t off = 0;
+        while (off < text.size()) {
+            ssize_t w = ::send(client, text.data() + off, text.size() - off, MSG_NOSIGNAL);
+            if (w <= 0) break;
+            off += static_cast<size_t>(w);
+        }
+        ::close(client);
+    }
+
+    void publish_file() {
+        std::string text = format_snapshot(registry_.snapshot(), cfg_.format);
+        if (cfg_.format == MetricsFormat::JsonLines) {
+            std::ofstream out(cfg_.target, std::ios::app);
+            out << text;
+            return;
+        }
+        std::string tmp = cfg_.target + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            if (!(out << text)) return;
+        }
+        std::rename(tmp.c_str(), cfg_.target.c_str());
+    }
+
+    const MetricsRegistry& registry_;
+    Config cfg_;
+    int stop_fd_ = -1;
+    int listen_fd_ = -1;
+    std::string socket_path_;
+    std::thread thread_;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+// Fila limitada e lock-free para entrega de comandos entre threads (vários produtores, um
+// consumidor). Cada célula carrega um número de sequência que diz se ela está livre para o
+// produtor da vez ou pronta para o consumidor (algoritmo de D. Vyukov); produtores disputam
+// apenas um fetch/CAS na posição de escrita e nunca esperam pelo consumidor.
+template <typename T>
+class MpscQueue {
+public:
+    // 'capacity' é arredondada para a próxima potência de dois.
+    explicit MpscQueue(size_t capacity) {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        mask_ = cap - 1;
+        cells_ = std::make_unique<Cell[]>(cap);
+        for (size_t i = 0; i < cap; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // Retorna false se a fila estiver cheia.
+    bool try_push(T&& value) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(value);
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Apenas o consumidor chama.
+    std::optional<T> try_pop() {
+        Cell& cell = cells_[head_ & mask_];
+        size_t seq = cell.seq.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(head_ + 1) < 0) return std::nullopt;
+        std::optional<T> out(std::move(cell.value));
+        cell.seq.store(head_ + mask_ + 1, std::memory_order_release);
+        ++head_;
+        return out;
+    }
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) size_t head_ = 0;
+};
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "slow_packet.hpp"
+
+// --- Fontes de payload para transmissão em fluxo ---
+//
+// A sessão não precisa mais da mensagem inteira em memória: ela puxa da fonte um fragmento por
+// vez (next), o codifica direto no slot de retransmissão e só então o consome (consume). Assim o
+// que fica residente é limitado pela janela, não pelo tamanho dos dados.
+class PayloadSource {
+public:
+    struct Chunk {
+        ByteSpan data; // válido até o próximo next()/consume()
+        bool last;     // a fonte termina logo depois destes bytes
+
+        // Vazio sem ser o fim: a fonte ainda não tem dados (ver wait_fd) ou falhou (ver error).
+        bool ready() const { return last || !data.empty(); }
+    };
+
+    virtual ~PayloadSource() = default;
+
+    // Até 'max' bytes a partir da posição atual, sem consumi-los.
+    virtual Chunk next(size_t max) = 0;
+    virtual void consume(size_t n) = 0;
+
+    // Descritor que ficará legível quando houver mais dados, se next() não tinha nenhum; -1
+    // para as fontes que estão sempre prontas.
+    virtual int wait_fd() const { return -1; }
+    // Descrição do erro que impede a fonte de continuar, ou nullptr.
+    virtual const char* error() const { return nullptr; }
+};
+
+// Mensagem já em memória (o caso de send(std::vector<uint8_t>)).
+class MemorySource : public PayloadSource {
+public:
+    explicit MemorySource(std::vector<uint8_t> data) : data_(std::move(data)) {}
+
+    Chunk next(size_t max) override {
+        size_t n = std::min(max, data_.size() - pos_);
+        return {ByteSpan(data_).subspan(pos_, n), pos_ + n == data_.size()};
+    }
+
+    void consume(size_t n) override { pos_ += n; }
+
+private:
+    std::vector<uint8_t> data_;
+    size_t pos_ = 0;
+};
+
+// Bytes de outra pessoa, sem cópia: o chamador garante que vivem até a mensagem ser confirmada
+// (ex.: a API de corrotinas, que só retorna do send() depois do ACK).
+class SpanSource : public PayloadSource {
+public:
+    explicit SpanSource(ByteSpan data) : data_(data) {}
+
+    Chunk next(size_t max) override {
+        size_t n = std::min(max, data_.size() - pos_);
+        return {data_.subspan(pos_, n), pos_ + n == data_.size()};
+    }
+
+    void consume(size_t n) override { pos_ += n; }
+
+private:
+    ByteSpan data_;
+    size_t pos_ = 0;
+};
+
+// Arquivo regular mapeado em memória: os fragmentos são lidos direto do page cache. As páginas
+// já transmitidas são devolvidas ao kernel de tempos em tempos, então mesmo arquivos de vários
+// GB não acumulam memória residente.
+class MmapSource : public PayloadSource {
+public:
+    static constexpr size_t RELEASE_STEP = 4 << 20;
+
+    // Assume a posse de 'fd'; lança std::runtime_error se o mapeamento falhar.
+    explicit MmapSource(int fd) {
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            ::close(fd);
+            throw std::runtime_error("fstat falhou");
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("mmap falhou");
+            }
+            base_ = static_cast<uint8_t*>(p);
+            madvise(base_, size_, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+    }
+
+    ~MmapSource() override {
+        if (base_) munmap(base_, size_);
+    }
+
+    Chunk next(size_t max) override {
+        size_t n = std::min(max, size_ - pos_);
+        return {ByteSpan(base_ + pos_, n), pos_ + n == size_};
+    }
+
+    void consume(size_t n) override {
+        pos_ += n;
+        if (pos_ - released_ >= RELEASE_STEP) {
+            size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            size_t upto = pos_ / page * page;
+            madvise(base_ + released_, upto - released_, MADV_DONTNEED);
+            released_ = upto;
+        }
+    }
+
+    size_t size() const { return size_; }
+
+private:
+    uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+    size_t pos_ = 0;
+    size_t released_ = 0;
+};
+
+// Descritor sem tamanho conhecido (stdin, pipe, FIFO), lido sem bloquear: com um produtor
+// lento, next() devolve o que já chegou (ou nada) e a sessão espera o descritor ficar legível,
+// sem prender o laço que dirige as outras. Um byte de leitura antecipada fica sempre no buffer
+// até o fim do fluxo aparecer: é ele que diz se o fragmento é o último (a flag More Bits).
+class FdSource : public PayloadSource {
+public:
+    static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+    FdSource(int fd, bool owns_fd) : fd_(fd), owns_fd_(owns_fd), buf_(BUFFER_SIZE) {
+        flags_ = fcntl(fd_, F_GETFL, 0);
+        if (flags_ >= 0) fcntl(fd_, F_SETFL, flags_ | O_NONBLOCK);
+    }
+
+    ~FdSource() override {
+        if (owns_fd_) ::close(fd_);
+        else if (flags_ >= 0) fcntl(fd_, F_SETFL, flags_);   // ex.: a entrada padrão
+    }
+
+    Chunk next(size_t max) override {
+        if (error_) return {ByteSpan(), false};
+        max = std::min(max, BUFFER_SIZE - 1);
+        fill(max + 1);
+        size_t avail = end_ - begin_;
+        size_t n = eof_ ? std::min(max, avail) : std::min(max, avail > 0 ? avail - 1 : 0);
+        return {ByteSpan(buf_.data() + begin_, n), eof_ && n == avail};
+    }
+
+    void consume(size_t n) override { begin_ += n; }
+
+    int wait_fd() const override { return eof_ || error_ ? -1 : fd_; }
+    const char* error() const override { return error_ ? std::strerror(error_) : nullptr; }
+
+private:
+    void fill(size_t want) {
+        if (end_ - begin_ >= want || eof_) return;
+        // Compacta para que o fragmento seja contíguo.
+        std::memmove(buf_.data(), buf_.data() + begin_, end_ - begin_);
+        end_ -= begin_;
+        begin_ = 0;
+        while (end_ < want && !eof_) {
+            ssize_t r = ::read(fd_, buf_.data() + end_, buf_.size() - end_);
+            if (r > 0) {
+                end_ += static_cast<size_t>(r);
+            } else if (r == 0) {
+                eof_ = true;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            } else if (errno != EINTR) {
+                error_ = errno;   // o fluxo não pode ser concluído: a sessão falha
+                return;
+            }
+        }
+    }
+
+    int fd_;
+    bool owns_fd_;
+    int flags_ = -1;   // de antes do O_NONBLOCK
+    std::vector<uint8_t> buf_;
+    size_t begin_ = 0;
+    size_t end_ = 0;
+    bool eof_ = false;
+    int error_ = 0;
+};
+
+// Abre 'path' como fonte: "-" é a entrada padrão, arquivos regulares são mapeados e o resto
+// (pipes, FIFOs, dispositivos) é lido em fluxo. Retorna nullptr se não for possível abrir.
+inline std::unique_ptr<PayloadSource> open_payload_source(const std::string& path) {
+    if (path == "-") return std::make_unique<FdSource>(STDIN_FILENO, false);
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror(path.c_str());
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        try {
+            return std::make_unique<MmapSource>(fd);
+        } catch (const std::exception& e) {
+            std::cerr << path << ": " << e.what() << std::endl;
+            return nullptr;
+        }
+    }
+    return std::make_unique<FdSource>(fd, true);
+}
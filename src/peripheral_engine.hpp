@@ -0,0 +1,432 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "slow_codec.hpp"
+#include "slow_io.hpp"
+#include "metrics.hpp"
+#include "slow_session.hpp"
+#include "timer_wheel.hpp"
+
+// Hash de um Session ID: o UUID já é aleatório, basta combinar suas duas metades.
+struct SidHash {
+    size_t operator()(const std::array<uint8_t, 16>& sid) const {
+        uint64_t a, b;
+        std::memcpy(&a, sid.data(), 8);
+        std::memcpy(&b, sid.data() + 8, 8);
+        return static_cast<size_t>(a ^ (b * 0x9E3779B97F4A7C15ULL));
+    }
+};
+
+// --- Laço de eventos do peripheral ---
+//
+// Um único socket UDP atende todas as sessões: o epoll acorda o laço quando há datagramas, que
+// são drenados em lote e encaminhados à sessão dona do 'sid'. Retransmissões e expiração de
+// STTL ficam na roda de temporização, que também define o timeout do epoll_wait.
+//
+// Antes do ACCEPT a sessão ainda não tem 'sid', então não há como saber a quem pertence uma
+// resposta de handshake no socket compartilhado (e a recusa de um Revive vem com sid nulo).
+// Por isso cada handshake usa um socket efêmero próprio, conectado ao central, por onde saem
+// o CONNECT (ou o Revive) e chegam as respostas; concluído o handshake, a sessão passa ao
+// socket compartilhado e o efêmero é fechado. Até MAX_HANDSHAKES correm em paralelo; as
+// demais sessões aguardam na fila de conexão. Sem socket (laço dirigido por step()) ou sem
+// descritores livres, volta-se a um handshake por vez no transporte compartilhado.
+//
+// O SRTT medido pelos handshakes já concluídos semeia a estimativa das sessões seguintes, e
+// assim a espera por uma resposta perdida acompanha o RTT real em vez do handshake_timeout.
+class PeripheralEngine {
+public:
+    static constexpr size_t RX_BATCH = 32;
+    static constexpr size_t MAX_HANDSHAKES = 64;
+
+    // Assume a posse do socket 'sock', que passa a ser não-bloqueante.
+    PeripheralEngine(int sock, const sockaddr* central, socklen_t central_len,
+                     IOBackend backend = IOBackend::Auto)
+        : sock_(sock), central_len_(central_len), timers_(SlowClock::now()),
+          rx_storage_(RX_BATCH), rx_slots_(RX_BATCH), rx_spans_(RX_BATCH), rx_views_(RX_BATCH) {
+        std::memcpy(&central_, central, central_len);
+        set_nonblocking(sock_);
+        int sndbuf = 1 << 20;
+        setsockopt(sock_, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        io_ = make_datagram_io(backend, sock_, central, central_len);
+
+        epfd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epfd_ < 0) throw std::runtime_error("epoll_create1 falhou");
+        // Em geral o próprio socket; com io_uring, o descritor do anel (legível quando há CQEs).
+        io_fd_ = io_->poll_fd();
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = io_fd_;
+        if (epoll_ctl(epfd_, EPOLL_CTL_ADD, io_fd_, &ev) < 0) {
+            close(epfd_);
+            throw std::runtime_error("epoll_ctl falhou");
+        }
+        for (size_t i = 0; i < RX_BATCH; ++i) {
+            rx_slots_[i] = {rx_storage_[i].data(), rx_storage_[i].size(), 0};
+        }
+    }
+
+    // Sem socket nem epoll: o transporte é 'io' (ex.: o enlace simulado ou a reprodução de um
+    // trace) e o tempo é só o que o chamador passa a step(), a partir de 'start'. Nada aqui
+    // consulta o relógio real, então a execução é determinística.
+    PeripheralEngine(std::unique_ptr<DatagramIO> io, TimePoint start)
+        : sock_(-1), io_(std::move(io)), timers_(start),
+          rx_storage_(RX_BATCH), rx_slots_(RX_BATCH), rx_spans_(RX_BATCH), rx_views_(RX_BATCH) {
+        for (size_t i = 0; i < RX_BATCH; ++i) {
+            rx_slots_[i] = {rx_storage_[i].data(), rx_storage_[i].size(), 0};
+        }
+    }
+
+    ~PeripheralEngine() {
+        while (!handshakes_.empty()) close_handshake(handshakes_.begin());
+        for (auto& [id, session] : sessions_) io_->unregister_buffer(session->tx_storage());
+        sessions_.clear();
+        if (epfd_ >= 0) close(epfd_);
+        if (sock_ >= 0) close(sock_);
+    }
+
+    PeripheralEngine(const PeripheralEngine&) = delete;
+    PeripheralEngine& operator=(const PeripheralEngine&) = delete;
+
+    // Métricas da thread que roda este laço; as sessões criadas a partir daqui somam nelas.
+    void set_metrics(ThreadMetrics* metrics) { metrics_ = metrics; }
+
+    using IOWrapper = std::function<std::unique_ptr<DatagramIO>(std::unique_ptr<DatagramIO>)>;
+
+    // Substitui o transporte por 'wrap(transporte atual)', ex.: um RecordingIO. As sessões
+    // guardam uma referência ao transporte, então só pode ser feito antes da primeira delas.
+    // 'wrap' também envolve o transporte de cada handshake em socket efêmero, para que nada
+    // passe ao largo dele; um RecordingIO deve, portanto, gravar em um TraceWriter comum.
+    void wrap_io(IOWrapper wrap) {
+        if (!sessions_.empty()) throw std::logic_error("wrap_io() depois de criar sessões");
+        io_ = wrap(std::move(io_));
+        if (wrap_) {
+            wrap = [inner = std::move(wrap_), outer = std::move(wrap)](std::unique_ptr<DatagramIO> io) {
+                return outer(inner(std::move(io)));
+            };
+        }
+        wrap_ = std::move(wrap);
+    }
+
+    SlowSession& create_session(const SessionConfig& cfg = {}) {
+        uint64_t id = next_session_id_++;
+        auto session = std::make_unique<SlowSession>(id, *io_, timers_, cfg);
+        session->attach_metrics(metrics_);
+        io_->register_buffer(session->tx_storage(), session->tx_storage_size());
+        SlowSession& ref = *session;
+        session->set_source_waiter([this, &ref](int fd) { return wait_source(ref, fd); });
+        sessions_.emplace(id, std::move(session));
+        return ref;
+    }
+
+    // Coloca a sessão na fila de conexão; o handshake começa quando for a vez dela, no fim da
+    // iteração corrente do laço. Assim, dados enfileirados logo depois do connect() ainda
+    // chegam a tempo de seguir no próprio pacote de Revive.
+    void connect(SlowSession& session) {
+        connect_queue_.push_back(&session);
+    }
+
+    // Registra outro descritor no epoll (ex.: um eventfd de comandos vindos de outra thread).
+    // 'on_readable' é chamado no próprio laço sempre que o descritor estiver legível.
+    void watch_fd(int fd, std::function<void()> on_readable) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0) throw std::runtime_error("epoll_ctl falhou");
+        watched_.emplace(fd, std::move(on_readable));
+    }
+
+    void unwatch_fd(int fd) {
+        if (watched_.erase(fd)) epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    // Remove uma sessão encerrada (ou em qualquer estado, descartando-a).
+    void release(SlowSession& session) {
+        if (has_sid(session)) by_sid_.erase(session.sid());
+        if (connecting_ == &session) connecting_ = nullptr;
+        for (auto it = handshakes_.begin(); it != handshakes_.end(); ++it) {
+            if (it->second.session == &session) {
+                close_handshake(it);
+                break;
+            }
+        }
+        connect_queue_.erase(std::remove(connect_queue_.begin(), connect_queue_.end(), &session), connect_queue_.end());
+        if (session.source_wait_fd() >= 0) unwatch_fd(session.source_wait_fd());
+        io_->unregister_buffer(session.tx_storage());
+        sessions_.erase(session.id());
+    }
+
+    // Uma iteração do laço: espera por datagramas ou pelo próximo temporizador (no máximo
+    // 'max_wait'), processa tudo o que chegou e dispara os temporizadores vencidos.
+    void run_once(Duration max_wait) {
+        if (epfd_ < 0) throw std::logic_error("run_once() em laço sem socket; use step()");
+        TimePoint now = SlowClock::now();
+        Duration wait = max_wait;
+        if (auto t = next_timeout(now)) wait = std::min(wait, *t);
+        // O que foi enviado fora do laço (comandos, corrotinas) sai antes da espera.
+        io_->flush();
+        // Datagramas que o transporte já retirou do kernel (ex.: junto com as conclusões de um
+        // envio no io_uring) não acordam o epoll: não espera por eles.
+        bool readable = io_->rx_pending();
+        int timeout_ms = readable ? 0 : static_cast<int>(to_ms(wait + std::chrono::microseconds(999)));
+
+        epoll_event events[8];
+        int n = epoll_wait(epfd_, events, 8, timeout_ms);
+        now = SlowClock::now();
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.fd == io_fd_) {
+                readable = true;
+            } else if (auto hs = handshakes_.find(events[i].data.fd); hs != handshakes_.end()) {
+                drain_handshake(hs, now);
+            } else {
+                auto it = watched_.find(events[i].data.fd);
+                // Por cópia: o próprio callback pode deixar de vigiar o descritor.
+                if (it != watched_.end()) std::function<void()>(it->second)();
+            }
+        }
+        if (readable) drain_socket(now);
+
+        timers_.advance(now);
+        service_connect_queue(now);
+        io_->flush();
+    }
+
+    // Uma iteração sem espera, com o tempo dado pelo chamador: processa o que o transporte já
+    // entregou, dispara os temporizadores vencidos até 'now' e inicia a próxima conexão da fila.
+    // É como o simulador (sim_link.hpp) move o laço pelo relógio virtual.
+    void step(TimePoint now) {
+        drain_socket(now);
+        timers_.advance(now);
+        service_connect_queue(now);
+        io_->flush();
+    }
+
+    // Quanto falta, a partir de 'now', para o próximo evento interno: um temporizador ou uma
+    // conexão esperando a vez. nullopt se não houver nenhum.
+    std::optional<Duration> next_timeout(TimePoint now) const {
+        if (!connect_queue_.empty() && can_start_handshake()) return Duration::zero();
+        return timers_.next_timeout(now);
+    }
+
+    // Roda o laço até 'done' retornar true.
+    void run_until(const std::function<bool()>& done) {
+        while (!done()) run_once(std::chrono::milliseconds(100));
+    }
+
+    bool all_finished() const {
+        for (const auto& entry : sessions_) {
+            if (!entry.second->finished()) return false;
+        }
+        return true;
+    }
+
+    size_t session_count() const { return sessions_.size(); }
+    DatagramIO& io() { return *io_; }
+    TimerWheel& timers() { return timers_; }
+
+private:
+    static bool has_sid(const SlowSession& s) {
+        return s.state() != SessionState::Idle && !handshaking(s) && s.sid() != std::array<uint8_t, 16>{};
+    }
+
+    // Fonte de payload sem dados prontos (ex.: um pipe): o laço segue atendendo as outras
+    // sessões e retoma esta quando o descritor ficar legível. Sem epoll (laço dirigido por
+    // step()), a sessão tenta de novo pelo próprio temporizador.
+    bool wait_source(SlowSession& session, int fd) {
+        if (epfd_ < 0) return false;
+        try {
+            watch_fd(fd, [this, &session, fd] {
+                unwatch_fd(fd);
+                session.resume_source(SlowClock::now());
+            });
+        } catch (const std::exception&) {
+            return false;
+        }
+        return true;
+    }
+
+    static bool handshaking(const SlowSession& s) {
+        return s.state() == SessionState::Connecting || s.state() == SessionState::Reviving;
+    }
+
+    void drain_socket(TimePoint now) {
+        for (;;) {
+            size_t got = io_->recv_batch(rx_slots_.data(), rx_slots_.size());
+            // Decodifica o lote inteiro de uma vez (SIMD, se houver) e só então despacha.
+            size_t valid = 0;
+            for (size_t i = 0; i < got; ++i) {
+                if (rx_slots_[i].len < SLOW_HEADER_SIZE) continue;
+                rx_spans_[valid++] = {rx_slots_[i].buf, rx_slots_[i].len};
+            }
+            decode_headers(rx_spans_.data(), rx_views_.data(), valid);
+            for (size_t i = 0; i < valid; ++i) dispatch(rx_views_[i], now);
+            if (got < rx_slots_.size()) break;
+        }
+        // ACKs que não seguiram de carona em dados saem agora, um por sessão.
+        for (SlowSession* s : ack_queue_) s->flush_ack();
+        ack_queue_.clear();
+    }
+
+    // Demultiplexação por 'sid'; respostas de handshake vão para a sessão em Connecting.
+    void dispatch(const SLOWPacketView& pkt, TimePoint now) {
+        auto it = by_sid_.find(pkt.sid);
+        if (it != by_sid_.end()) {
+            SlowSession* s = it->second;
+            bool was_pending = s->ack_pending();
+            s->on_packet(pkt, now);
+            if (!was_pending && s->ack_pending()) ack_queue_.push_back(s);
+            return;
+        }
+        if (connecting_) {
+            SlowSession* s = connecting_;
+            s->on_packet(pkt, now);
+            settle_connecting(now);
+        }
+    }
+
+    // Um handshake em socket efêmero: as respostas que chegam por ele são todas de 'session'.
+    struct Handshake {
+        SlowSession* session;
+        std::unique_ptr<DatagramIO> io;
+    };
+    using HandshakeMap = std::unordered_map<int, Handshake>;
+
+    // Fim do handshake (concluído ou não): a sessão passa a ser achada pelo 'sid'.
+    void on_handshake_done(SlowSession& s, TimePoint now) {
+        if (has_sid(s)) by_sid_[s.sid()] = &s;
+        auto rtt = s.handshake_rtt();
+        if (!rtt) return;
+        bool first = !path_rtt_.has_sample();
+        path_rtt_.on_sample(*rtt);
+        // Os handshakes que começaram antes de haver medida esperavam o handshake_timeout.
+        if (first) {
+            for (auto& entry : handshakes_) entry.second.session->seed_rtt(path_rtt_.srtt(), now);
+        }
+    }
+
+    void settle_connecting(TimePoint now) {
+        if (!connecting_ || handshaking(*connecting_)) return;
+        on_handshake_done(*connecting_, now);
+        connecting_ = nullptr;
+    }
+
+    // Handshakes que terminaram por temporizador (falha, ou Revive que virou CONNECT ainda em
+    // curso) também liberam o socket efêmero.
+    void settle_handshakes(TimePoint now) {
+        for (auto it = handshakes_.begin(); it != handshakes_.end();) {
+            if (handshaking(*it->second.session)) {
+                ++it;
+                continue;
+            }
+            on_handshake_done(*it->second.session, now);
+            it = close_handshake(it);
+        }
+    }
+
+    bool can_start_handshake() const {
+        if (epfd_ >= 0 && !handshake_sockets_failed_) return handshakes_.size() < MAX_HANDSHAKES;
+        return !connecting_;
+    }
+
+    void service_connect_queue(TimePoint now) {
+        settle_connecting(now);
+        settle_handshakes(now);
+        while (!connect_queue_.empty() && can_start_handshake()) {
+            SlowSession* next = connect_queue_.front();
+            connect_queue_.pop_front();
+            if (next->state() != SessionState::Idle) continue;
+            if (path_rtt_.has_sample()) next->seed_rtt(path_rtt_.srtt(), now);
+            if (start_handshake(*next, now)) continue;
+            connecting_ = next;
+            next->connect(now);
+            settle_connecting(now);
+        }
+    }
+
+    // Abre o socket efêmero e inicia o handshake por ele. false se não houver socket (laço sem
+    // socket, ou falta de descritores): o chamador recorre ao transporte compartilhado.
+    bool start_handshake(SlowSession& session, TimePoint now) {
+        if (epfd_ < 0 || handshake_sockets_failed_) return false;
+        const sockaddr* central = reinterpret_cast<const sockaddr*>(&central_);
+        int fd = socket(central_.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (fd < 0 || ::connect(fd, central, central_len_) < 0 || epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            if (fd >= 0) close(fd);
+            handshake_sockets_failed_ = true;
+            return false;
+        }
+        Handshake& hs = handshakes_[fd];
+        hs.session = &session;
+        hs.io = std::make_unique<SimpleIO>(fd, central, central_len_);
+        if (wrap_) hs.io = wrap_(std::move(hs.io));
+        session.set_handshake_transport(hs.io.get());
+        session.connect(now);
+        return true;
+    }
+
+    HandshakeMap::iterator close_handshake(HandshakeMap::iterator it) {
+        it->second.session->set_handshake_transport(nullptr);
+        epoll_ctl(epfd_, EPOLL_CTL_DEL, it->first, nullptr);
+        close(it->first);
+        return handshakes_.erase(it);
+    }
+
+    void drain_handshake(HandshakeMap::iterator it, TimePoint now) {
+        SlowSession& s = *it->second.session;
+        // Os slots podem ter ficado apontando para buffers emprestados pelo transporte
+        // compartilhado (io_uring); o socket efêmero recebe nos do próprio laço.
+        for (size_t i = 0; i < RX_BATCH; ++i) rx_slots_[i] = {rx_storage_[i].data(), rx_storage_[i].size(), 0};
+        size_t got = it->second.io->recv_batch(rx_slots_.data(), rx_slots_.size());
+        size_t valid = 0;
+        for (size_t i = 0; i < got; ++i) {
+            if (rx_slots_[i].len < SLOW_HEADER_SIZE) continue;
+            rx_spans_[valid++] = {rx_slots_[i].buf, rx_slots_[i].len};
+        }
+        decode_headers(rx_spans_.data(), rx_views_.data(), valid);
+        for (size_t i = 0; i < valid && handshaking(s); ++i) s.on_packet(rx_views_[i], now);
+        s.flush_ack();
+        if (!handshaking(s)) {
+            on_handshake_done(s, now);
+            close_handshake(it);
+        }
+    }
+
+    int sock_;
+    sockaddr_storage central_{};
+    socklen_t central_len_ = 0;
+    int io_fd_ = -1;
+    int epfd_ = -1;
+    std::unique_ptr<DatagramIO> io_;
+    IOWrapper wrap_;                        // o de wrap_io, também para os handshakes
+    TimerWheel timers_;
+
+    uint64_t next_session_id_ = 1;
+    ThreadMetrics* metrics_ = nullptr;
+    std::unordered_map<uint64_t, std::unique_ptr<SlowSession>> sessions_;
+    std::unordered_map<std::array<uint8_t, 16>, SlowSession*, SidHash> by_sid_;
+    std::deque<SlowSession*> connect_queue_;
+    SlowSession* connecting_ = nullptr;     // handshake no transporte compartilhado
+    HandshakeMap handshakes_;               // por descritor do socket efêmero
+    bool handshake_sockets_failed_ = false;
+    RttEstimator path_rtt_;                 // RTT até o central, medido pelos handshakes
+    std::vector<SlowSession*> ack_queue_;
+    std::unordered_map<int, std::function<void()>> watched_;
+
+    std::vector<std::array<uint8_t, SLOW_MAX_PACKET_SIZE>> rx_storage_;
+    std::vector<RxDatagram> rx_slots_;
+    std::vector<ByteSpan> rx_spans_;
+    std::vector<SLOWPacketView> rx_views_;
+};
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "slow_packet.hpp"
+#include "retransmit_ring.hpp"
+
+// Maior mensagem possível: 256 fragmentos ('fo' de 8 bits) de tamanho máximo.
+constexpr size_t SLOW_MAX_MESSAGE_SIZE = 256 * SLOW_MAX_DATA_SIZE;
+
+// --- Remontagem dos dados recebidos do central ---
+//
+// Cada fragmento é copiado uma única vez, do buffer de recepção para a posição fo * 1440 do
+// buffer da sua mensagem, em qualquer ordem. Os buffers de mensagem têm o tamanho máximo de uma
+// mensagem SLOW, são alocados só quando a sessão recebe dados e voltam para um pool ao serem
+// entregues. Se algum fragmento intermediário veio menor que 1440 bytes, a mensagem é compactada
+// no próprio buffer antes da entrega; a aplicação recebe uma visão do buffer, sem cópia.
+//
+// Os seqnums são acompanhados à parte: 'rcv_next' é o próximo esperado em ordem (o ACK
+// cumulativo é rcv_next - 1) e um bitmap marca os que chegaram adiantados, o que também
+// descarta duplicatas. Uma mensagem só é entregue quando está completa e todos os seqnums
+// anteriores já chegaram, preservando a ordem de envio.
+//
+// Uma mensagem descartada por fragmento incoerente deixa o seu fid "envenenado" na faixa de
+// seqnums que ela pode ocupar: os fragmentos dela que ainda chegarem são consumidos e
+// descartados, em vez de abrirem uma mensagem nova que nunca se completaria.
+class Reassembler {
+public:
+    static constexpr size_t REORDER_SPAN = 1024; // seqnums aceitos adiante de rcv_next
+
+    enum class Result {
+        Accepted,
+        Duplicate,    // seqnum já recebido: basta reconfirmar
+        OutOfWindow,  // muito adiante de rcv_next ou sem espaço; o central retransmitirá
+        Malformed     // fragmento incoerente com a mensagem (tamanho ou fo inválidos)
+    };
+
+    // 'buffer_bytes' limita quanto pode ficar retido em mensagens incompletas; abaixo de uma
+    // mensagem máxima, mensagens maiores que ele nunca poderiam ser entregues.
+    explicit Reassembler(size_t buffer_bytes = SLOW_MAX_MESSAGE_SIZE)
+        : buffer_bytes_(std::max(buffer_bytes, SLOW_MAX_DATA_SIZE)) {}
+
+    // Define o primeiro seqnum esperado (o seguinte ao do ACCEPT) e descarta qualquer estado.
+    void reset(uint32_t rcv_next) {
+        for (auto& m : active_) release_buffer(std::move(m.buffer));
+        active_.clear();
+        poisoned_.clear();
+        received_.fill(0);
+        rcv_next_ = rcv_next;
+        buffered_ = 0;
+    }
+
+    uint32_t rcv_next() const { return rcv_next_; }
+    uint32_t cumulative_ack() const { return rcv_next_ - 1; }
+    size_t buffered() const { return buffered_; }
+
+    // Janela anunciada: espaço livre, limitado aos 16 bits do cabeçalho.
+    uint16_t window() const {
+        size_t free = buffer_bytes_ - std::min(buffered_, buffer_bytes_);
+        return static_cast<uint16_t>(std::min<size_t>(free, UINT16_MAX));
+    }
+
+    // Processa um fragmento. 'deliver(ByteSpan)' é chamado para cada mensagem que ficar pronta;
+    // a visão vale apenas durante a chamada.
+    template <typename Deliver>
+    Result on_fragment(const SLOWPacketView& pkt, Deliver&& deliver) {
+        uint32_t offset = pkt.seqnum - rcv_next_;
+        if (seq_lt(pkt.seqnum, rcv_next_)) return Result::Duplicate;
+        if (offset >= REORDER_SPAN) return Result::OutOfWindow;
+        if (is_received(pkt.seqnum)) return Result::Duplicate;
+        if (pkt.data.size() > SLOW_MAX_DATA_SIZE) return Result::Malformed;
+        if (buffered_ + pkt.data.size() > buffer_bytes_) return Result::OutOfWindow;
+
+        if (is_poisoned(pkt.fid, pkt.seqnum)) {
+            // Resto de uma mensagem já descartada: consome o seqnum sem guardar os dados.
+            mark_received(pkt.seqnum);
+            advance();
+            deliver_ready(deliver);
+            return Result::Malformed;
+        }
+
+        Message* msg = find_or_start(pkt.fid);
+        bool last = !(pkt.flags & FLAG_MORE_BITS);
+        if (msg->has(pkt.fo)                                           // mesmo fo em outro seqnum
+            || (msg->final_seen && (last || pkt.fo > msg->final_fo))   // além do fim da mensagem
+            || (last && msg->count > 0 && msg->max_fo_seen > pkt.fo)) {
+            // O seqnum é consumido (e confirmado) mesmo assim, senão seria retransmitido para sempre.
+            // A mensagem nunca poderá ser entregue: sai da lista com o seu buffer e os seus bytes,
+            // senão o próximo uso do mesmo fid (256 mensagens adiante) cairia sobre ela.
+            poison(*msg);
+            drop(*msg);
+            mark_received(pkt.seqnum);
+            advance();
+            deliver_ready(deliver);
+            return Result::Malformed;
+        }
+
+        std::memcpy(msg->buffer.get() + size_t(pkt.fo) * SLOW_MAX_DATA_SIZE, pkt.data.data(), pkt.data.size());
+        msg->mark(pkt.fo, static_cast<uint16_t>(pkt.data.size()));
+        msg->bytes += pkt.data.size();
+        msg->max_fo_seen = std::max(msg->max_fo_seen, pkt.fo);
+        // Os fragmentos de uma mensagem ocupam seqnums consecutivos: o fo dá onde ela começa.
+        uint32_t first = pkt.seqnum - pkt.fo;
+        if (msg->count == 1 || seq_lt(first, msg->first_seq)) msg->first_seq = first;
+        if (!msg->last_seq_set || seq_lt(msg->last_seq, pkt.seqnum)) {
+            msg->last_seq = pkt.seqnum;
+            msg->last_seq_set = true;
+        }
+        if (last) {
+            msg->final_seen = true;
+            msg->final_fo = pkt.fo;
+        }
+        buffered_ += pkt.data.size();
+
+        mark_received(pkt.seqnum);
+        advance();
+        deliver_ready(deliver);
+        return Result::Accepted;
+    }
+
+private:
+    struct Message {
+        uint8_t fid = 0;
+        std::unique_ptr<uint8_t[]> buffer;
+        std::array<uint16_t, 256> len{};   // tamanho de cada fragmento (0 = ausente)
+        std::array<uint64_t, 4> present{}; // bitmap dos fo recebidos
+        size_t count = 0;
+        size_t bytes = 0;
+        uint8_t max_fo_seen = 0;
+        bool final_seen = false;
+        uint8_t final_fo = 0;
+        bool last_seq_set = false;
+        uint32_t last_seq = 0;
+        uint32_t first_seq = 0;            // seqnum do fo 0 (mesmo que ainda não tenha chegado)
+
+        bool has(uint8_t fo) const { return present[fo >> 6] >> (fo & 63) & 1; }
+        void mark(uint8_t fo, uint16_t n) {
+            present[fo >> 6] |= uint64_t(1) << (fo & 63);
+            len[fo] = n;
+            ++count;
+        }
+        bool complete() const { return final_seen && count == size_t(final_fo) + 1; }
+    };
+
+    bool is_received(uint32_t seq) const {
+        size_t i = seq % REORDER_SPAN;
+        return received_[i >> 6] >> (i & 63) & 1;
+    }
+    void mark_received(uint32_t seq) {
+        size_t i = seq % REORDER_SPAN;
+        received_[i >> 6] |= uint64_t(1) << (i & 63);
+    }
+    void clear_received(uint32_t seq) {
+        size_t i = seq % REORDER_SPAN;
+        received_[i >> 6] &= ~(uint64_t(1) << (i & 63));
+    }
+
+    // Avança rcv_next sobre os seqnums contíguos já recebidos, liberando seus bits.
+    void advance() {
+        while (is_received(rcv_next_)) {
+            clear_received(rcv_next_);
+            ++rcv_next_;
+        }
+    }
+
+    // Faixa de seqnums de uma mensagem descartada: [first, end). Cabem no máximo 256 fragmentos,
+    // e o mesmo fid só volta 256 mensagens depois, então nada fora dela é da mensagem antiga.
+    struct Poisoned {
+        uint8_t fid;
+        uint32_t first;
+        uint32_t end;
+    };
+
+    void poison(const Message& m) {
+        uint32_t end = m.first_seq + (m.final_seen ? uint32_t(m.final_fo) + 1 : 256);
+        poisoned_.push_back({m.fid, m.first_seq, end});
+    }
+
+    bool is_poisoned(uint8_t fid, uint32_t seq) {
+        // As faixas inteiras abaixo de rcv_next não recebem mais nada.
+        std::erase_if(poisoned_, [&](const Poisoned& p) { return !seq_lt(rcv_next_, p.end); });
+        for (const Poisoned& p : poisoned_) {
+            if (p.fid == fid && !seq_lt(seq, p.first) && seq_lt(seq, p.end)) return true;
+        }
+        return false;
+    }
+
+    Message* find_or_start(uint8_t fid) {
+        for (auto& m : active_) {
+            if (m.fid == fid) return &m;
+        }
+        active_.emplace_back();
+        Message& m = active_.back();
+        m.fid = fid;
+        m.buffer = acquire_buffer();
+        return &m;
+    }
+
+    void drop(Message& m) {
+        buffered_ -= m.bytes;
+        release_buffer(std::move(m.buffer));
+        active_.erase(active_.begin() + (&m - active_.data()));
+    }
+
+    template <typename Deliver>
+    void deliver_ready(Deliver& deliver) {
+        for (;;) {
+            // A mensagem pronta mais antiga: completa e inteiramente abaixo de rcv_next.
+            auto ready = active_.end();
+            for (auto it = active_.begin(); it != active_.end(); ++it) {
+                if (!it->complete() || !seq_lt(it->last_seq, rcv_next_)) continue;
+                if (ready == active_.end() || seq_lt(it->last_seq, ready->last_seq)) ready = it;
+            }
+            if (ready == active_.end()) return;
+
+            size_t total = compact(*ready);
+            buffered_ -= ready->bytes;
+            // Retira da lista antes de entregar, pois o callback pode reentrar na sessão (ex.: send).
+            Message done = std::move(*ready);
+            active_.erase(ready);
+            deliver(ByteSpan(done.buffer.get(), total));
+            release_buffer(std::move(done.buffer));
+        }
+    }
+
+    // Junta os fragmentos no início do buffer quando algum veio menor que o tamanho máximo.
+    static size_t compact(Message& m) {
+        size_t pos = 0;
+        for (size_t fo = 0; fo <= m.final_fo; ++fo) {
+            size_t src = fo * SLOW_MAX_DATA_SIZE;
+            if (src != pos) std::memmove(m.buffer.get() + pos, m.buffer.get() + src, m.len[fo]);
+            pos += m.len[fo];
+        }
+        return pos;
+    }
+
+    std::unique_ptr<uint8_t[]> acquire_buffer() {
+        // Sem inicialização: cada byte entregue foi escrito por um fragmento.
+        if (pool_.empty()) return std::unique_ptr<uint8_t[]>(new uint8_t[SLOW_MAX_MESSAGE_SIZE]);
+        auto buf = std::move(pool_.back());
+        pool_.pop_back();
+        return buf;
+    }
+
+    void release_buffer(std::unique_ptr<uint8_t[]> buf) {
+        if (buf) pool_.push_back(std::move(buf));
+    }
+
+    size_t buffer_bytes_;
+    uint32_t rcv_next_ = 0;
+    size_t buffered_ = 0;
+    std::vector<Message> active_;
+    std::vector<Poisoned> poisoned_;
+    std::vector<std::unique_ptr<uint8_t[]>> pool_;
+    std::array<uint64_t, REORDER_SPAN / 64> received_{};
+};
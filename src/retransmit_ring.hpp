@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <stdexcept>
+#include "slow_packet.hpp"
+#include "slow_clock.hpp"
+
+// Comparações de seqnum em aritmética serial (RFC 1982): continuam corretas quando o
+// contador de 32 bits dá a volta, desde que as distâncias fiquem abaixo de 2^31.
+inline bool seq_lt(uint32_t a, uint32_t b)  { return static_cast<int32_t>(a - b) < 0; }
+inline bool seq_leq(uint32_t a, uint32_t b) { return static_cast<int32_t>(a - b) <= 0; }
+
+// Fila de retransmissão de tamanho fixo, indexada por 'seqnum - base'.
+//
+// Cada slot tem um buffer pré-alocado do tamanho máximo de um pacote SLOW, onde o pacote é
+// codificado uma única vez e de onde sai tanto a transmissão original quanto as retransmissões.
+// Além da ordem por seqnum, os slots ocupados formam uma lista duplamente encadeada na ordem do
+// último envio: os que expiraram ficam sempre no início dela.
+class RetransmitRing {
+public:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct Slot {
+        uint32_t seqnum = 0;
+        uint16_t len = 0;         // tamanho do pacote codificado
+        uint16_t payload_len = 0; // bytes de dados (os que contam na janela)
+        uint32_t retransmits = 0;
+        TimePoint sent_time{};
+        uint8_t* buf = nullptr;
+        uint32_t prev = NIL, next = NIL; // lista por ordem de envio
+
+        ByteSpan packet() const { return {buf, len}; }
+    };
+
+    // 'capacity' é arredondada para a próxima potência de dois.
+    explicit RetransmitRing(size_t capacity) {
+        size_t cap = 1;
+        while (cap < capacity) cap <<= 1;
+        mask_ = cap - 1;
+        storage_.resize(cap * SLOW_MAX_PACKET_SIZE);
+        slots_.resize(cap);
+        for (size_t i = 0; i < cap; ++i) slots_[i].buf = &storage_[i * SLOW_MAX_PACKET_SIZE];
+    }
+
+    size_t capacity() const { return slots_.size(); }
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    bool full() const { return count_ == slots_.size(); }
+    size_t bytes_in_flight() const { return bytes_in_flight_; }
+
+    // Menor seqnum ainda não confirmado (válido apenas se não estiver vazio).
+    uint32_t base() const { return base_; }
+
+    // Ocupa o slot do próximo seqnum. Os seqnums devem ser consecutivos.
+    // O chamador codifica o pacote em 'slot.buf' e depois chama commit().
+    Slot& push(uint32_t seqnum) {
+        if (full()) throw std::runtime_error("Fila de retransmissão cheia");
+        if (empty()) {
+            base_ = seqnum;
+        } else if (seqnum != static_cast<uint32_t>(base_ + count_)) {
+            throw std::runtime_error("Seqnum fora de ordem na fila de retransmissão");
+        }
+        Slot& s = slots_[seqnum & mask_];
+        s.seqnum = seqnum;
+        s.retransmits = 0;
+        ++count_;
+        return s;
+    }
+
+    void commit(Slot& s, size_t len, size_t payload_len, TimePoint now) {
+        s.len = static_cast<uint16_t>(len);
+        s.payload_len = static_cast<uint16_t>(payload_len);
+        s.sent_time = now;
+        bytes_in_flight_ += payload_len;
+        link_tail(index_of(s));
+    }
+
+    // ACK cumulativo: libera todos os slots com seqnum <= acknum. O(slots liberados).
+    // Retorna quantos bytes de dados foram confirmados.
+    size_t ack(uint32_t acknum) {
+        size_t released = 0;
+        while (count_ > 0 && seq_leq(base_, acknum)) {
+            uint32_t idx = base_ & mask_;
+            unlink(idx);
+            released += slots_[idx].payload_len;
+            ++base_;
+            --count_;
+        }
+        bytes_in_flight_ -= released;
+        return released;
+    }
+
+    // Slot do seqnum informado, se ainda estiver na fila.
+    const Slot* find(uint32_t seqnum) const {
+        if (count_ == 0 || seq_lt(seqnum, base_) || seqnum - base_ >= count_) return nullptr;
+        return &slots_[seqnum & mask_];
+    }
+
+    // Slot enviado há mais tempo (o próximo a expirar), ou nullptr se não houver nenhum.
+    const Slot* oldest() const { return head_ == NIL ? nullptr : &slots_[head_]; }
+
+    // Visita apenas os slots cujo último envio foi há 'timeout' ou mais. Cada slot visitado é
+    // considerado retransmitido agora e vai para o fim da lista de envio.
+    template <typename Fn>
+    size_t for_each_expired(TimePoint now, Duration timeout, Fn&& fn) {
+        size_t visited = 0;
+        size_t limit = count_;
+        while (head_ != NIL && visited < limit) {
+            Slot& s = slots_[head_];
+            if (now - s.sent_time < timeout) break;
+            fn(s);
+            s.sent_time = now;
+            ++s.retransmits;
+            uint32_t idx = head_;
+            unlink(idx);
+            link_tail(idx);
+            ++visited;
+        }
+        return visited;
+    }
+
+    // Marca um slot específico como retransmitido agora (retransmissão rápida) e o leva para o
+    // fim da lista de envio. Retorna nullptr se o seqnum não estiver na fila.
+    const Slot* retransmit(uint32_t seqnum, TimePoint now) {
+        if (!find(seqnum)) return nullptr;
+        uint32_t idx = seqnum & mask_;
+        Slot& s = slots_[idx];
+        s.sent_time = now;
+        ++s.retransmits;
+        unlink(idx);
+        link_tail(idx);
+        return &s;
+    }
+
+    // Região de memória contígua com todos os buffers (útil para registro em backends de E/S).
+    uint8_t* storage() { return storage_.data(); }
+    size_t storage_size() const { return storage_.size(); }
+
+private:
+    uint32_t index_of(const Slot& s) const { return static_cast<uint32_t>(&s - slots_.data()); }
+
+    void link_tail(uint32_t idx) {
+        Slot& s = slots_[idx];
+        s.prev = tail_;
+        s.next = NIL;
+        if (tail_ != NIL) slots_[tail_].next = idx; else head_ = idx;
+        tail_ = idx;
+    }
+
+    void unlink(uint32_t idx) {
+        Slot& s = slots_[idx];
+        if (s.prev != NIL) slots_[s.prev].next = s.next; else head_ = s.next;
+        if (s.next != NIL) slots_[s.next].prev = s.prev; else tail_ = s.prev;
+        s.prev = s.next = NIL;
+    }
+
+    std::vector<uint8_t> storage_;
+    std::vector<Slot> slots_;
+    size_t mask_ = 0;
+    uint32_t base_ = 0;
+    size_t count_ = 0;
+    size_t bytes_in_flight_ = 0;
+    uint32_t head_ = NIL, tail_ = NIL;
+};
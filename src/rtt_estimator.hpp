@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include "slow_clock.hpp"
+
+// Estimativa de RTT e cálculo do timeout de retransmissão (RTO) conforme a RFC 6298.
+//
+// As amostras vêm do tempo entre o envio de um pacote e o ACK que o confirma. Pela regra de
+// Karn, pacotes retransmitidos não geram amostras (não dá para saber qual envio foi confirmado);
+// em vez disso, cada timeout dobra o RTO até que um ACK de um pacote novo o recalcule.
+class RttEstimator {
+public:
+    struct Config {
+        Duration initial_rto = std::chrono::seconds(1);
+        Duration min_rto = std::chrono::milliseconds(10);
+        Duration max_rto = std::chrono::seconds(60);
+        Duration granularity = std::chrono::milliseconds(1);
+        // Folga mínima do RTO sobre o SRTT. Num caminho estável o RTTVAR tende a zero e o RTO
+        // ficaria em SRTT + G; mas o temporizador dispara até um tick da roda (1 ms) depois do
+        // previsto, o pacing espaça os envios em quanta de 1 ms e o ACK de um lote só sai depois
+        // de drenado o lote inteiro. Quatro ticks cobrem essas três fontes com sobra.
+        Duration min_margin = std::chrono::milliseconds(4);
+    };
+
+    RttEstimator() : RttEstimator(Config{}) {}
+    explicit RttEstimator(const Config& cfg) : cfg_(cfg), rto_(cfg.initial_rto) {}
+
+    void on_sample(Duration rtt) {
+        if (rtt < Duration::zero()) return;
+        if (!has_sample_) {
+            srtt_ = rtt;
+            rttvar_ = rtt / 2;
+            has_sample_ = true;
+        } else {
+            Duration err = srtt_ > rtt ? srtt_ - rtt : rtt - srtt_;
+            rttvar_ = (3 * rttvar_ + err) / 4;
+            srtt_ = (7 * srtt_ + rtt) / 8;
+        }
+        latest_ = rtt;
+        // Além da folga fixa, uma proporcional ao RTT (SRTT/4): em caminhos longos, a variação de
+        // fila que atrasa um ACK cresce com o próprio RTT, e o 4*RTTVAR de um caminho estável não
+        // a acompanha.
+        Duration margin = std::max({cfg_.granularity, 4 * rttvar_, srtt_ / 4, cfg_.min_margin});
+        rto_ = clamp(srtt_ + margin);
+    }
+
+    // Chamado a cada timeout: backoff exponencial do RTO.
+    void on_timeout() { rto_ = clamp(rto_ * 2); }
+
+    Duration rto() const { return rto_; }
+    Duration srtt() const { return srtt_; }
+    Duration rttvar() const { return rttvar_; }
+    Duration latest() const { return latest_; }
+    bool has_sample() const { return has_sample_; }
+
+private:
+    Duration clamp(Duration d) const { return std::min(cfg_.max_rto, std::max(cfg_.min_rto, d)); }
+
+    Config cfg_;
+    Duration rto_;
+    Duration srtt_{};
+    Duration rttvar_{};
+    Duration latest_{};
+    bool has_sample_ = false;
+};
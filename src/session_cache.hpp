@@ -0,0 +1,158 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <netdb.h>
+#include <sys/socket.h>
+#include "slow_packet.hpp"
+
+// Estado mínimo para reviver uma sessão encerrada (0-way connect).
+struct CachedSession {
+    std::array<uint8_t, 16> sid{};
+    uint32_t sttl = 0;        // ms de STTL que restavam quando a sessão foi guardada
+    uint32_t seqnum = 0;      // último seqnum usado
+    uint32_t acknum = 0;      // último acknum enviado
+    int64_t saved_at_ms = 0;  // relógio de parede, para valer também entre execuções
+
+    bool valid_at(int64_t now_ms) const { return now_ms - saved_at_ms < static_cast<int64_t>(sttl); }
+};
+
+inline int64_t wall_clock_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// --- Cache de sessões para o Revive ---
+//
+// Guarda, por chave (central + identificador da aplicação), o sid, o STTL e os seqnums da
+// última sessão encerrada normalmente. Uma entrada só é devolvida enquanto o STTL não venceu
+// e é retirada ao ser usada: a sessão revivida guarda o seu estado de novo ao encerrar.
+// Pode ser compartilhado entre threads. Opcionalmente persiste em um arquivo binário compacto:
+//
+//   "SLWC" | versão (u32) | n (u32) | n x { tam. chave (u16) | chave | sid (16) | sttl (u32) |
+//                                          seqnum (u32) | acknum (u32) | salvo em (i64, ms) }
+//
+// com todos os inteiros em little-endian, como no cabeçalho SLOW.
+class SessionCache {
+public:
+    static constexpr uint32_t FILE_VERSION = 1;
+
+    // Chave de uma sessão: endereço numérico do central e a chave da aplicação.
+    static std::string key_for(const sockaddr* central, socklen_t len, uint64_t app_key) {
+        char host[NI_MAXHOST] = "?", port[NI_MAXSERV] = "?";
+        getnameinfo(central, len, host, sizeof(host), port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV);
+        return std::string(host) + ":" + port + "#" + std::to_string(app_key);
+    }
+
+    // Retira a entrada de 'key', se ainda estiver dentro do STTL.
+    std::optional<CachedSession> take(const std::string& key, int64_t now_ms = wall_clock_ms()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it == entries_.end()) return std::nullopt;
+        CachedSession entry = it->second;
+        entries_.erase(it);
+        if (!entry.valid_at(now_ms)) return std::nullopt;
+        return entry;
+    }
+
+    void store(const std::string& key, const CachedSession& entry) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_[key] = entry;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+    // Carrega as entradas ainda válidas de 'path'. Um arquivo inexistente não é erro.
+    bool load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return true;
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        size_t pos = 0;
+        auto have = [&](size_t n) { return bytes.size() - pos >= n; };
+        if (!have(12) || std::memcmp(bytes.data(), "SLWC", 4) != 0 || load_le32(&bytes[4]) != FILE_VERSION) {
+            return false;
+        }
+        uint32_t count = load_le32(&bytes[8]);
+        pos = 12;
+
+        int64_t now = wall_clock_ms();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (uint32_t i = 0; i < count; ++i) {
+            if (!have(2)) return false;
+            size_t key_len = bytes[pos] | (size_t(bytes[pos + 1]) << 8);
+            pos += 2;
+            if (!have(key_len + RECORD_SIZE)) return false;
+            std::string key(reinterpret_cast<const char*>(&bytes[pos]), key_len);
+            pos += key_len;
+
+            CachedSession e;
+            std::memcpy(e.sid.data(), &bytes[pos], 16);
+            e.sttl = load_le32(&bytes[pos + 16]);
+            e.seqnum = load_le32(&bytes[pos + 20]);
+            e.acknum = load_le32(&bytes[pos + 24]);
+            e.saved_at_ms = static_cast<int64_t>(load_le32(&bytes[pos + 28])
+                                                 | (uint64_t(load_le32(&bytes[pos + 32])) << 32));
+            pos += RECORD_SIZE;
+            if (e.valid_at(now)) entries_[key] = e;
+        }
+        return true;
+    }
+
+    // Grava as entradas ainda válidas em 'path' (via arquivo temporário + rename, para que uma
+    // interrupção no meio nunca deixe um cache corrompido).
+    bool save(const std::string& path) const {
+        std::vector<uint8_t> out(12);
+        std::memcpy(out.data(), "SLWC", 4);
+        store_le32(&out[4], FILE_VERSION);
+
+        int64_t now = wall_clock_ms();
+        uint32_t count = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& [key, e] : entries_) {
+                if (!e.valid_at(now) || key.size() > UINT16_MAX) continue;
+                size_t pos = out.size();
+                out.resize(pos + 2 + key.size() + RECORD_SIZE);
+                out[pos] = key.size() & 0xFF;
+                out[pos + 1] = key.size() >> 8;
+                std::memcpy(&out[pos + 2], key.data(), key.size());
+                uint8_t* r = &out[pos + 2 + key.size()];
+                std::memcpy(r, e.sid.data(), 16);
+                store_le32(r + 16, e.sttl);
+                store_le32(r + 20, e.seqnum);
+                store_le32(r + 24, e.acknum);
+                store_le32(r + 28, static_cast<uint32_t>(e.saved_at_ms));
+                store_le32(r + 32, static_cast<uint32_t>(static_cast<uint64_t>(e.saved_at_ms) >> 32));
+                ++count;
+            }
+        }
+        store_le32(&out[8], count);
+
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+            if (!file.write(reinterpret_cast<const char*>(out.data()), out.size())) return false;
+        }
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+private:
+    static constexpr size_t RECORD_SIZE = 16 + 4 + 4 + 4 + 8;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, CachedSession> entries_;
+};
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <random>
+#include <vector>
+#include <netinet/in.h>
+#include "peripheral_engine.hpp"
+#include "slow_central.hpp"
+#include "slow_io.hpp"
+#include "slow_trace.hpp"
+
+// --- Enlace simulado com relógio virtual ---
+//
+// Peripheral e central no mesmo processo, ligados por um enlace de mentira com atraso, jitter,
+// banda, fila, perda, duplicação e reordenação configuráveis. Não há socket nem relógio real: o
+// tempo só anda quando o SimNetwork salta para o próximo evento (entrega de um datagrama ou
+// temporizador), então horas de transferência simulada rodam em segundos, e a mesma semente
+// reproduz a mesma execução, pacote a pacote.
+
+struct LinkConfig {
+    Duration latency = std::chrono::milliseconds(10);   // atraso de propagação
+    Duration jitter = Duration::zero();                 // atraso extra, uniforme em [0, jitter]
+    double bandwidth_bps = 0;                            // banda do gargalo (0 = ilimitada)
+    size_t queue_bytes = 256 * 1024;                     // fila do gargalo; o que excede é descartado
+    double loss = 0;                                     // probabilidade de perda de cada datagrama
+    double duplicate = 0;                                // probabilidade de entregar duas vezes
+    double reorder = 0;                                  // probabilidade de atrasar 'reorder_delay' a mais
+    Duration reorder_delay = std::chrono::milliseconds(5);
+};
+
+struct LinkStats {
+    uint64_t sent = 0;
+    uint64_t delivered = 0;
+    uint64_t lost = 0;
+    uint64_t queue_drops = 0;   // descartados por fila cheia
+    uint64_t duplicated = 0;
+    uint64_t reordered = 0;
+};
+
+// Um sentido do enlace: os datagramas entram com push() e saem, no instante de entrega, com
+// pop_ready(). A fila do gargalo é modelada pelo instante em que ele fica livre.
+class SimLink {
+public:
+    SimLink(const LinkConfig& cfg, uint32_t seed) : cfg_(cfg), rng_(seed) {}
+
+    void push(ByteSpan pkt, TimePoint now) {
+        ++stats_.sent;
+        if (chance(cfg_.loss)) {
+            ++stats_.lost;
+            return;
+        }
+        TimePoint departure = now;
+        if (cfg_.bandwidth_bps > 0) {
+            TimePoint start = std::max(now, busy_until_);
+            double backlog_bytes = std::chrono::duration<double>(start - now).count() * cfg_.bandwidth_bps / 8;
+            if (backlog_bytes + pkt.size() > cfg_.queue_bytes) {
+                ++stats_.queue_drops;
+                return;
+            }
+            busy_until_ = start + std::chrono::duration_cast<Duration>(
+                                      std::chrono::duration<double>(pkt.size() * 8 / cfg_.bandwidth_bps));
+            departure = busy_until_;
+        }
+        int copies = 1;
+        if (chance(cfg_.duplicate)) {
+            ++stats_.duplicated;
+            copies = 2;
+        }
+        for (int c = 0; c < copies; ++c) {
+            Duration delay = cfg_.latency;
+            if (cfg_.jitter > Duration::zero()) {
+                delay += Duration(std::uniform_int_distribution<Duration::rep>(0, cfg_.jitter.count())(rng_));
+            }
+            if (chance(cfg_.reorder)) {
+                ++stats_.reordered;
+                delay += cfg_.reorder_delay;
+            }
+            queue_.push({departure + delay, next_seq_++, std::vector<uint8_t>(pkt.begin(), pkt.end())});
+        }
+    }
+
+    // Entrega, em ordem de chegada, os datagramas que chegaram até 'now'.
+    template <typename Fn>
+    void pop_ready(TimePoint now, Fn&& deliver, size_t max = SIZE_MAX) {
+        for (size_t n = 0; n < max && !queue_.empty() && queue_.top().at <= now; ++n) {
+            InFlight pkt = std::move(const_cast<InFlight&>(queue_.top()));
+            queue_.pop();
+            ++stats_.delivered;
+            deliver(ByteSpan(pkt.data), pkt.at);
+        }
+    }
+
+    std::optional<TimePoint> next_delivery() const {
+        if (queue_.empty()) return std::nullopt;
+        return queue_.top().at;
+    }
+
+    const LinkStats& stats() const { return stats_; }
+
+private:
+    struct InFlight {
+        TimePoint at;
+        uint64_t seq;   // desempate: mesma chegada => ordem de envio
+        std::vector<uint8_t> data;
+        bool operator>(const InFlight& o) const { return at != o.at ? at > o.at : seq > o.seq; }
+    };
+
+    bool chance(double p) { return p > 0 && unit_(rng_) < p; }
+
+    LinkConfig cfg_;
+    std::mt19937_64 rng_;
+    std::uniform_real_distribution<double> unit_{0.0, 1.0};
+    std::priority_queue<InFlight, std::vector<InFlight>, std::greater<InFlight>> queue_;
+    TimePoint busy_until_{};
+    uint64_t next_seq_ = 0;
+    LinkStats stats_;
+};
+
+// Lado do peripheral no enlace: envia pela subida e recebe da descida, no instante virtual.
+class SimulatedIO : public DatagramIO {
+public:
+    SimulatedIO(SimLink& up, SimLink& down, const TimePoint& now) : up_(up), down_(down), now_(now) {}
+
+    const char* name() const override { return "sim"; }
+
+    size_t send_batch(const ByteSpan* pkts, size_t count) override {
+        for (size_t i = 0; i < count; ++i) up_.push(pkts[i], now_);
+        return count;
+    }
+
+    size_t recv_batch(RxDatagram* slots, size_t count) override {
+        size_t got = 0;
+        down_.pop_ready(now_, [&](ByteSpan pkt, TimePoint) {
+            size_t len = std::min(pkt.size(), slots[got].capacity);
+            std::memcpy(slots[got].buf, pkt.data(), len);
+            slots[got++].len = len;
+        }, count);
+        return got;
+    }
+
+private:
+    SimLink& up_;
+    SimLink& down_;
+    const TimePoint& now_;
+};
+
+struct SimConfig {
+    LinkConfig uplink;              // peripheral -> central
+    LinkConfig downlink;            // central -> peripheral
+    CentralConfig central;
+    uint32_t seed = 1;
+    std::string record_path;        // grava o trace do peripheral (tempo virtual), se não vazio
+};
+
+// --- Simulação completa: PeripheralEngine + enlace + SlowCentral ---
+class SimNetwork {
+public:
+    // O central retransmite os próprios dados a cada 'TICK' de tempo virtual.
+    static constexpr Duration TICK = std::chrono::milliseconds(10);
+
+    explicit SimNetwork(const SimConfig& cfg)
+        : start_(TimePoint{} + std::chrono::hours(1)), now_(start_),
+          up_(cfg.uplink, cfg.seed * 2 + 1), down_(cfg.downlink, cfg.seed * 2 + 2), central_(cfg.central),
+          engine_(std::make_unique<SimulatedIO>(up_, down_, now_), start_), next_tick_(start_ + TICK) {
+        if (!cfg.record_path.empty()) {
+            engine_.wrap_io([&](std::unique_ptr<DatagramIO> io) {
+                return std::make_unique<RecordingIO>(std::move(io), cfg.record_path, [this] { return now_; });
+            });
+        }
+        peer_.len = sizeof(sockaddr_in);
+        reinterpret_cast<sockaddr_in*>(&peer_.addr)->sin_family = AF_INET;
+    }
+
+    PeripheralEngine& engine() { return engine_; }
+    SlowCentral& central() { return central_; }
+    const SimLink& uplink() const { return up_; }
+    const SimLink& downlink() const { return down_; }
+
+    TimePoint now() const { return now_; }
+    const TimePoint& clock() const { return now_; }   // o relógio virtual, para quem precisa acompanhá-lo
+    Duration elapsed() const { return now_ - start_; }
+
+    // Avança de evento em evento até 'done' retornar true (true) ou passar 'limit' de tempo
+    // simulado (false).
+    bool run_until(const std::function<bool()>& done, Duration limit) {
+        TimePoint deadline = now_ + limit;
+        for (;;) {
+            step();
+            if (done()) return true;
+            if (now_ >= deadline) return false;
+            now_ = std::min(next_event(), deadline);
+        }
+    }
+
+private:
+    void step() {
+        auto reply = [this](const SLOWPacketView& pkt, const PeerAddress&) {
+            size_t len = pkt.encode(tx_buf_.data(), tx_buf_.size());
+            down_.push({tx_buf_.data(), len}, now_);
+        };
+        up_.pop_ready(now_, [&](ByteSpan pkt, TimePoint) {
+            if (pkt.size() < SLOW_HEADER_SIZE) return;
+            central_.on_packet(SLOWPacketView::decode(pkt.data(), pkt.size()), peer_, now_, reply);
+        });
+        if (now_ >= next_tick_) {
+            central_.on_tick(now_, reply);
+            next_tick_ = now_ + TICK;
+        }
+        engine_.step(now_);
+    }
+
+    // Próximo instante com algo a fazer; sempre à frente de 'now_', para o tempo andar.
+    TimePoint next_event() const {
+        TimePoint next = next_tick_;
+        if (auto t = up_.next_delivery()) next = std::min(next, *t);
+        if (auto t = down_.next_delivery()) next = std::min(next, *t);
+        if (auto t = engine_.next_timeout(now_)) next = std::min(next, now_ + *t);
+        return std::max(next, now_ + std::chrono::microseconds(1));
+    }
+
+    TimePoint start_;
+    TimePoint now_;
+    SimLink up_;
+    SimLink down_;
+    SlowCentral central_;
+    PeripheralEngine engine_;
+    TimePoint next_tick_;
+    PeerAddress peer_;
+    std::array<uint8_t, SLOW_MAX_PACKET_SIZE> tx_buf_{};
+};
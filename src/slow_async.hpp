@@ -0,0 +1,451 @@
+#pragma once
+
+#include <cerrno>
+#include <coroutine>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <netdb.h>
+#include <sys/socket.h>
+#include "payload_source.hpp"
+#include "peripheral_engine.hpp"
+#include "session_cache.hpp"
+#include "slow_trace.hpp"
+
+// --- API assíncrona com corrotinas (C++20) ---
+//
+// Uma camada fina sobre o PeripheralEngine para embutir o peripheral em outros serviços:
+//
+//   slow::SlowClient client(slow::resolve_endpoint("slow.gmelodie.com", "7033"));
+//   client.spawn([](slow::SlowClient& c) -> slow::Task<void> {
+//       slow::Session s = c.session();
+//       co_await s.connect();
+//       co_await s.send(dados);      // retorna depois do ACK do último fragmento
+//       co_await s.close();
+//   }(client));
+//   client.run();
+//
+// O SlowClient é o reator: um socket, um laço de eventos e as corrotinas que ele retoma. Nada
+// bloqueia; cada transferência em andamento custa o frame da sua corrotina, não uma thread. As
+// corrotinas só são retomadas pelo próprio run(), entre duas iterações do laço, nunca de dentro
+// do processamento de um pacote, então podem chamar qualquer operação (inclusive destruir a
+// sessão) sem reentrância. Um SlowClient pertence a uma única thread; para usar vários núcleos,
+// crie um por thread.
+//
+// Erros (handshake recusado ou sem resposta, sessão expirada antes do ACK) chegam como
+// SessionError no co_await da operação.
+
+namespace slow {
+
+class SessionError : public std::runtime_error {
+public:
+    SessionError(const std::string& what, SessionState state) : std::runtime_error(what), state_(state) {}
+    SessionState state() const { return state_; }
+
+private:
+    SessionState state_;
+};
+
+// --- Task<T>: corrotina preguiçosa, que só começa quando alguém a aguarda ---
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr exception;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    // Ao terminar, passa o controle direto a quem aguardava (transferência simétrica).
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+            return h.promise().continuation;
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { exception = std::current_exception(); }
+    void rethrow_if_failed() {
+        if (exception) std::rethrow_exception(exception);
+    }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+    Task<T> get_return_object();
+    void return_value(T v) { value.emplace(std::move(v)); }
+    T result() {
+        rethrow_if_failed();
+        return std::move(*value);
+    }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+    void result() { rethrow_if_failed(); }
+};
+
+// Corrotina solta, que se destrói sozinha ao terminar (usada só pelo SlowClient::spawn).
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+} // namespace detail
+
+template <typename T>
+class Task {
+public:
+    using promise_type = detail::Promise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    explicit Task(Handle h) : handle_(h) {}
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (handle_) handle_.destroy();
+    }
+
+    auto operator co_await() && noexcept {
+        struct Awaiter {
+            Handle h;
+            bool await_ready() noexcept { return !h || h.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> cont) noexcept {
+                h.promise().continuation = cont;
+                return h;
+            }
+            T await_resume() { return h.promise().result(); }
+        };
+        return Awaiter{handle_};
+    }
+
+private:
+    Handle handle_;
+};
+
+namespace detail {
+template <typename T>
+Task<T> Promise<T>::get_return_object() { return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this)); }
+inline Task<void> Promise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+} // namespace detail
+
+// --- Endereço do central ---
+
+struct Endpoint {
+    sockaddr_storage addr{};
+    socklen_t len = 0;
+
+    const sockaddr* sockaddr_ptr() const { return reinterpret_cast<const sockaddr*>(&addr); }
+};
+
+// Resolve host/porta UDP (IPv4 ou IPv6); lança std::runtime_error se não houver endereço.
+inline Endpoint resolve_endpoint(const std::string& host, const std::string& port) {
+    addrinfo hints{};
+    addrinfo* res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    int err = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+    if (err != 0) throw std::runtime_error("Não foi possível resolver " + host + ":" + port + ": " + gai_strerror(err));
+    Endpoint ep;
+    std::memcpy(&ep.addr, res->ai_addr, res->ai_addrlen);
+    ep.len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return ep;
+}
+
+struct ClientConfig {
+    SessionConfig session;
+    IOBackend backend = IOBackend::Auto;
+    ThreadMetrics* metrics = nullptr; // métricas da thread que roda o cliente (opcional)
+    std::string record_path;          // grava um trace dos datagramas (slow_trace.hpp), se não vazio
+};
+
+class SlowClient;
+
+// --- Session: alça de uma sessão SLOW criada por um SlowClient ---
+// Só pode ser movida; ao ser destruída, a sessão sai do laço (se ainda estiver ativa, é
+// descartada sem Disconnect).
+class Session {
+public:
+    Session() = default;
+    Session(Session&& other) noexcept
+        : client_(std::exchange(other.client_, nullptr)), slot_(std::exchange(other.slot_, nullptr)) {}
+    Session& operator=(Session&& other) noexcept;
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+    ~Session();
+
+    // Handshake de 3 vias; retorna quando a sessão está estabelecida.
+    Task<void> connect();
+
+    // Envia uma mensagem (de qualquer tamanho) e retorna, com a latência, depois que ela foi toda
+    // confirmada. A versão com ByteSpan (e vetores passados por referência) não copia: os bytes
+    // precisam viver até o co_await terminar. Vários send() podem estar pendentes ao mesmo tempo,
+    // em corrotinas diferentes.
+    Task<Duration> send(ByteSpan data);
+    Task<Duration> send(std::vector<uint8_t>&& data);
+    Task<Duration> send(std::unique_ptr<PayloadSource> source);
+
+    // 0-way connect: retoma a sessão guardada em 'cached' levando a primeira mensagem no próprio
+    // Revive. Se o central recusar ou não responder, recorre ao handshake completo. Retorna
+    // depois que a mensagem foi confirmada: true se a sessão foi revivida, false se houve
+    // handshake.
+    Task<bool> revive(const CachedSession& cached, ByteSpan first);
+    Task<bool> revive(const CachedSession& cached, std::unique_ptr<PayloadSource> first);
+
+    // Disconnect; retorna quando a sessão terminou (confirmado ou não pelo central).
+    Task<void> close();
+
+    SlowSession& raw() { return *session(); }
+    const SlowSession& raw() const { return *session(); }
+    SessionState state() const { return session()->state(); }
+    bool revived() const { return session()->revived(); }
+    // Dados para reviver esta sessão mais tarde (só depois de um close() normal).
+    std::optional<CachedSession> resumption() const { return session()->resumption(); }
+
+private:
+    friend class SlowClient;
+    struct Slot;
+
+    Session(SlowClient* client, Slot* slot) : client_(client), slot_(slot) {}
+    SlowSession* session() const;
+    // Espera o envio nº 'ticket' ser todo confirmado.
+    Task<void> acked(uint64_t ticket);
+
+    SlowClient* client_ = nullptr;
+    Slot* slot_ = nullptr;
+};
+
+// Estado de espera de uma sessão: quem aguarda o estabelecimento, os ACKs e o encerramento.
+struct Session::Slot {
+    SlowSession* session = nullptr;
+    std::coroutine_handle<> ready_waiter;
+    std::deque<std::pair<uint64_t, std::coroutine_handle<>>> send_waiters; // (nº do envio, corrotina)
+    std::coroutine_handle<> close_waiter;
+};
+
+// --- SlowClient: o reator ---
+class SlowClient {
+public:
+    explicit SlowClient(const Endpoint& central, const ClientConfig& cfg = {}) : cfg_(cfg) {
+        int sock = socket(central.addr.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (sock < 0) throw std::runtime_error(std::string("socket falhou: ") + std::strerror(errno));
+        engine_ = std::make_unique<PeripheralEngine>(sock, central.sockaddr_ptr(), central.len, cfg_.backend);
+        engine_->set_metrics(cfg_.metrics);
+        if (!cfg_.record_path.empty()) {
+            // Um trace só para o socket compartilhado e os dos handshakes.
+            auto writer = std::make_shared<TraceWriter>(cfg_.record_path, SlowClock::now());
+            engine_->wrap_io([writer](std::unique_ptr<DatagramIO> io) {
+                return std::make_unique<RecordingIO>(std::move(io), writer);
+            });
+        }
+    }
+
+    SlowClient(const SlowClient&) = delete;
+    SlowClient& operator=(const SlowClient&) = delete;
+
+    Session session() {
+        SlowSession& s = engine_->create_session(cfg_.session);
+        auto slot = std::make_unique<Session::Slot>();
+        Session::Slot* raw = slot.get();
+        raw->session = &s;
+        s.callbacks.on_established = [this, raw](SlowSession&) { wake(raw->ready_waiter); };
+        s.callbacks.on_message_sent = [this, raw](SlowSession& sess, size_t, Duration) {
+            while (!raw->send_waiters.empty() && raw->send_waiters.front().first <= sess.sends_completed()) {
+                wake(raw->send_waiters.front().second);
+                raw->send_waiters.pop_front();
+            }
+        };
+        s.callbacks.on_closed = [this, raw](SlowSession&) {
+            wake(raw->ready_waiter);
+            for (auto& w : raw->send_waiters) wake(w.second);
+            raw->send_waiters.clear();
+            wake(raw->close_waiter);
+        };
+        slots_.emplace(raw, std::move(slot));
+        return Session(this, raw);
+    }
+
+    // Inicia uma corrotina independente; ela começa na próxima iteração de run().
+    void spawn(Task<void> task) {
+        ++active_;
+        launch(std::move(task));
+    }
+
+    // Roda o laço até todas as corrotinas iniciadas por spawn() terminarem. A primeira exceção
+    // que escapar de uma delas é relançada aqui (as demais seguem até o fim).
+    void run() {
+        for (;;) {
+            resume_ready();
+            if (active_ == 0) break;
+            engine_->run_once(ready_.empty() ? std::chrono::milliseconds(100) : Duration::zero());
+        }
+        if (error_) std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+
+    size_t active_tasks() const { return active_; }
+    PeripheralEngine& engine() { return *engine_; }
+
+private:
+    friend class Session;
+
+    struct Yield {
+        SlowClient* client;
+        bool await_ready() noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { client->ready_.push_back(h); }
+        void await_resume() noexcept {}
+    };
+
+    // Espera por um evento da sessão; o callback correspondente guarda a corrotina em 'slot_ref'.
+    struct WaitFor {
+        std::coroutine_handle<>& slot_ref;
+        bool await_ready() noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) noexcept { slot_ref = h; }
+        void await_resume() noexcept {}
+    };
+
+    detail::Detached launch(Task<void> task) {
+        co_await Yield{this};
+        try {
+            co_await std::move(task);
+        } catch (...) {
+            if (!error_) error_ = std::current_exception();
+        }
+        --active_;
+    }
+
+    void wake(std::coroutine_handle<>& h) {
+        if (h) ready_.push_back(std::exchange(h, {}));
+    }
+
+    void resume_ready() {
+        while (!ready_.empty()) {
+            std::vector<std::coroutine_handle<>> batch;
+            batch.swap(ready_);
+            for (auto h : batch) h.resume();
+        }
+    }
+
+    void release(Session::Slot* slot) {
+        engine_->release(*slot->session);
+        slots_.erase(slot);
+    }
+
+    ClientConfig cfg_;
+    std::unique_ptr<PeripheralEngine> engine_;
+    std::unordered_map<Session::Slot*, std::unique_ptr<Session::Slot>> slots_;
+    std::vector<std::coroutine_handle<>> ready_;
+    size_t active_ = 0;
+    std::exception_ptr error_;
+};
+
+// --- Operações da Session ---
+
+inline Session& Session::operator=(Session&& other) noexcept {
+    if (this != &other) {
+        if (client_) client_->release(slot_);
+        client_ = std::exchange(other.client_, nullptr);
+        slot_ = std::exchange(other.slot_, nullptr);
+    }
+    return *this;
+}
+
+inline Session::~Session() {
+    if (client_) client_->release(slot_);
+}
+
+inline SlowSession* Session::session() const {
+    if (!slot_) throw std::logic_error("Session vazia");
+    return slot_->session;
+}
+
+inline Task<void> Session::connect() {
+    SlowSession& s = *session();
+    if (s.state() != SessionState::Idle) throw std::logic_error("connect() em sessão já iniciada");
+    client_->engine_->connect(s);
+    co_await SlowClient::WaitFor{slot_->ready_waiter};
+    if (s.state() != SessionState::Established) throw SessionError("Falha ao estabelecer conexão", s.state());
+}
+
+inline Task<Duration> Session::send(ByteSpan data) {
+    return send(std::make_unique<SpanSource>(data));
+}
+
+inline Task<Duration> Session::send(std::vector<uint8_t>&& data) {
+    return send(std::make_unique<MemorySource>(std::move(data)));
+}
+
+inline Task<Duration> Session::send(std::unique_ptr<PayloadSource> source) {
+    SlowSession& s = *session();
+    if (s.finished()) throw SessionError("send() em sessão encerrada", s.state());
+    TimePoint start = SlowClock::now();
+    co_await acked(s.send(std::move(source), start));
+    co_return SlowClock::now() - start;
+}
+
+inline Task<void> Session::acked(uint64_t ticket) {
+    SlowSession& s = *session();
+    // A sessão pode ter terminado dentro do próprio send() (ex.: falha ao ler a fonte); aí
+    // ninguém acordaria a espera.
+    if (s.sends_completed() < ticket && !s.finished()) {
+        slot_->send_waiters.emplace_back(ticket, nullptr);
+        co_await SlowClient::WaitFor{slot_->send_waiters.back().second};
+    }
+    if (s.sends_completed() < ticket) throw SessionError("Sessão encerrada antes da confirmação", s.state());
+}
+
+inline Task<bool> Session::revive(const CachedSession& cached, ByteSpan first) {
+    return revive(cached, std::make_unique<SpanSource>(first));
+}
+
+inline Task<bool> Session::revive(const CachedSession& cached, std::unique_ptr<PayloadSource> first) {
+    SlowSession& s = *session();
+    if (s.state() != SessionState::Idle) throw std::logic_error("revive() em sessão já iniciada");
+    s.resume_from(cached);
+    // A mensagem entra na fila antes do connect(), para seguir no próprio pacote de Revive.
+    uint64_t ticket = s.send(std::move(first), SlowClock::now());
+    client_->engine_->connect(s);
+    co_await acked(ticket);
+    co_return s.revived();
+}
+
+inline Task<void> Session::close() {
+    SlowSession& s = *session();
+    // Sem conexão iniciada não há o que encerrar com o central.
+    if (s.finished() || s.state() == SessionState::Idle) co_return;
+    s.close(SlowClock::now());
+    if (!s.finished()) co_await SlowClient::WaitFor{slot_->close_waiter};
+}
+
+} // namespace slow
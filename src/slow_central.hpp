@@ -0,0 +1,370 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include <sys/socket.h>
+#include "slow_packet.hpp"
+#include "slow_clock.hpp"
+#include "retransmit_ring.hpp"
+#include "peripheral_engine.hpp"
+
+// Parâmetros do central de testes.
+struct CentralConfig {
+    uint16_t window = 16 * 1440;      // janela anunciada (bytes)
+    uint32_t sttl_ms = 30000;         // STTL das sessões
+    bool ack_disconnect = true;       // responde o Disconnect com um ACK
+    bool echo = false;                // devolve cada mensagem remontada ao peripheral
+    Duration retransmit_timeout = std::chrono::milliseconds(50); // dos dados enviados pelo central
+    uint32_t seed = 0x5105u;          // semente dos sids e seqnums iniciais
+};
+
+// Contadores do central.
+struct CentralStats {
+    uint64_t connects = 0;
+    uint64_t revives = 0;
+    uint64_t revive_failures = 0;
+    uint64_t disconnects = 0;
+    uint64_t data_packets = 0;
+    uint64_t duplicates = 0;          // fragmentos já recebidos
+    uint64_t out_of_order = 0;        // fragmentos guardados à frente de uma lacuna
+    uint64_t messages = 0;            // mensagens remontadas por completo
+    uint64_t bytes = 0;               // bytes de mensagens completas
+    uint64_t tx_packets = 0;          // fragmentos de dados enviados pelo central
+    uint64_t tx_retransmits = 0;
+};
+
+// Endereço de origem de um peripheral, devolvido junto com cada resposta.
+struct PeerAddress {
+    sockaddr_storage addr{};
+    socklen_t len = 0;
+};
+
+// --- Lado central do protocolo SLOW (substituto local de slow.gmelodie.com) ---
+//
+// Independente de transporte: recebe um pacote já decodificado e devolve as respostas por um
+// callback 'reply(const SLOWPacketView&, const PeerAddress&)'. Implementa CONNECT/ACCEPT, ACKs
+// cumulativos com janela configurável, remontagem de fragmentos por fid/fo, Disconnect e Revive
+// (0-way), além da expiração das sessões pelo STTL.
+//
+// Também transmite no sentido contrário (send(), ou o modo eco): os fragmentos respeitam a janela
+// anunciada pelo peripheral, levam o ACK de carona e são retransmitidos por on_tick() enquanto
+// não forem confirmados.
+class SlowCentral {
+public:
+    using Sid = std::array<uint8_t, 16>;
+
+    explicit SlowCentral(const CentralConfig& cfg = {}) : cfg_(cfg), rng_(cfg.seed) {}
+
+    template <typename Reply>
+    void on_packet(const SLOWPacketView& pkt, const PeerAddress& from, TimePoint now, Reply&& reply) {
+        bool connect = pkt.flags & FLAG_CONNECT;
+        bool revive = pkt.flags & FLAG_REVIVE;
+
+        if (connect && revive) {
+            handle_disconnect(pkt, from, now, reply);
+        } else if (connect) {
+            handle_connect(pkt, from, now, reply);
+        } else {
+            handle_data(pkt, from, now, reply, revive);
+        }
+    }
+
+    // Retransmite os fragmentos do central sem confirmação há mais de 'retransmit_timeout'.
+    template <typename Reply>
+    void on_tick(TimePoint now, Reply&& reply) {
+        for (auto& entry : sessions_) {
+            Session& s = entry.second;
+            if (!s.active) continue;
+            for (OutFragment& f : s.tx_unacked) {
+                if (now - f.sent < cfg_.retransmit_timeout) continue;
+                f.sent = now;
+                ++stats_.tx_retransmits;
+                send_fragment(entry.first, s, f, now, reply);
+            }
+        }
+    }
+
+    // Enfileira uma mensagem do central para a sessão 'sid'. Retorna false se ela não existir.
+    bool send(const Sid& sid, std::vector<uint8_t> message) {
+        auto it = sessions_.find(sid);
+        if (it == sessions_.end() || !it->second.active) return false;
+        it->second.tx_queue.push_back(std::move(message));
+        return true;
+    }
+
+    const CentralStats& stats() const { return stats_; }
+    size_t session_count() const { return sessions_.size(); }
+
+    // Chamado a cada mensagem remontada (payload válido só durante a chamada).
+    std::function<void(const Sid&, ByteSpan)> on_message;
+
+private:
+    struct Fragment {
+        uint8_t flags;
+        uint8_t fid;
+        uint8_t fo;
+        std::vector<uint8_t> data;
+    };
+
+    struct OutFragment {
+        uint32_t seqnum;
+        uint8_t flags;
+        uint8_t fid;
+        uint8_t fo;
+        std::vector<uint8_t> data;
+        TimePoint sent;
+    };
+
+    struct Session {
+        bool active = true;
+        PeerAddress peer;
+        uint32_t expected = 0;               // próximo seqnum esperado em ordem
+        TimePoint last_seen{};
+        std::map<uint32_t, Fragment> ahead;  // fragmentos recebidos depois de uma lacuna
+        size_t ahead_bytes = 0;
+        bool assembling = false;
+        uint8_t fid = 0;
+        uint8_t next_fo = 0;
+        std::vector<uint8_t> message;        // mensagem em remontagem
+
+        // Sentido central -> peripheral.
+        uint32_t tx_next = 0;
+        uint16_t peer_window = 0;
+        uint8_t tx_fid = 0;
+        uint8_t tx_fo = 0;
+        size_t tx_offset = 0;                // bytes já fragmentados da primeira mensagem
+        size_t tx_in_flight = 0;
+        std::deque<std::vector<uint8_t>> tx_queue;
+        std::deque<OutFragment> tx_unacked;
+    };
+
+    Sid new_sid() {
+        Sid sid;
+        for (size_t i = 0; i < sid.size(); i += 4) {
+            uint32_t r = rng_();
+            std::memcpy(&sid[i], &r, 4);
+        }
+        // UUIDv8 (RFC 9562): versão 8 e variante 0b10.
+        sid[6] = (sid[6] & 0x0F) | 0x80;
+        sid[8] = (sid[8] & 0x3F) | 0x80;
+        return sid;
+    }
+
+    bool expired(const Session& s, TimePoint now) const {
+        return now - s.last_seen > std::chrono::milliseconds(cfg_.sttl_ms);
+    }
+
+    uint32_t sttl_left(const Session& s, TimePoint now) const {
+        auto left = std::chrono::milliseconds(cfg_.sttl_ms) - (now - s.last_seen);
+        return static_cast<uint32_t>(std::max<int64_t>(0, to_ms(left)));
+    }
+
+    uint16_t window_left(const Session& s) const {
+        return s.ahead_bytes >= cfg_.window ? 0 : static_cast<uint16_t>(cfg_.window - s.ahead_bytes);
+    }
+
+    template <typename Reply>
+    void handle_connect(const SLOWPacketView& pkt, const PeerAddress& from, TimePoint now, Reply& reply) {
+        ++stats_.connects;
+        Sid sid = new_sid();
+        Session& s = sessions_[sid];
+        s.expected = rng_();
+        s.tx_next = s.expected + 1;
+        s.tx_fid = static_cast<uint8_t>(rng_());
+        s.peer_window = pkt.window;
+        s.peer = from;
+        s.last_seen = now;
+
+        SLOWPacketView setup;
+        setup.sid = sid;
+        setup.sttl = cfg_.sttl_ms;
+        setup.flags = FLAG_ACCEPT_REJECT;
+        setup.seqnum = s.expected;
+        setup.window = cfg_.window;
+        reply(setup, from);
+    }
+
+    template <typename Reply>
+    void handle_disconnect(const SLOWPacketView& pkt, const PeerAddress& from, TimePoint now, Reply& reply) {
+        auto it = sessions_.find(pkt.sid);
+        if (it == sessions_.end() || !it->second.active) return;
+        ++stats_.disconnects;
+        Session& s = it->second;
+        s.active = false;
+        s.last_seen = now;
+        s.peer = from;
+        if (cfg_.ack_disconnect) {
+            send_ack(pkt.sid, s, pkt.seqnum, now, 0, reply);
+        }
+    }
+
+    template <typename Reply>
+    void handle_data(const SLOWPacketView& pkt, const PeerAddress& from, TimePoint now, Reply& reply, bool revive) {
+        auto it = sessions_.find(pkt.sid);
+        bool usable = it != sessions_.end() && !expired(it->second, now);
+
+        if (revive) {
+            if (!usable) {
+                ++stats_.revive_failures;
+                if (it != sessions_.end()) sessions_.erase(it);
+                SLOWPacketView failed; // sid nulo, sttl 0, flags 0 (Reject)
+                reply(failed, from);
+                return;
+            }
+            // Uma sessão revivida recomeça a contagem a partir do seqnum do pacote de revive. Se
+            // ela já estiver ativa, é a retransmissão de um Revive cujo ACK se perdeu.
+            if (!it->second.active) {
+                ++stats_.revives;
+                it->second.active = true;
+                it->second.expected = pkt.seqnum;
+                it->second.ahead.clear();
+                it->second.ahead_bytes = 0;
+            }
+        }
+        // Pacotes de sessões inativas ou desconhecidas são ignorados.
+        if (!usable || !it->second.active) return;
+
+        Session& s = it->second;
+        s.last_seen = now;
+        s.peer = from;
+        if (pkt.flags & FLAG_ACK) on_peer_ack(s, pkt);
+
+        // ACK puro sem dados (ex.: passo 3 do handshake, que repete o seqnum do ACCEPT): não
+        // ocupa seqnum nem é confirmado, mas pode ter aberto a janela do peripheral.
+        if (pkt.data.empty() && !revive) {
+            pump_tx(pkt.sid, s, now, reply);
+            return;
+        }
+
+        ++stats_.data_packets;
+        if (seq_lt(pkt.seqnum, s.expected)) {
+            ++stats_.duplicates;
+        } else if (pkt.seqnum == s.expected) {
+            accept_fragment(pkt.sid, s, pkt.flags, pkt.fid, pkt.fo, pkt.data);
+            ++s.expected;
+            // Libera os fragmentos que estavam à espera desta lacuna.
+            for (auto next = s.ahead.find(s.expected); next != s.ahead.end(); next = s.ahead.find(s.expected)) {
+                Fragment f = std::move(next->second);
+                s.ahead_bytes -= f.data.size();
+                s.ahead.erase(next);
+                accept_fragment(pkt.sid, s, f.flags, f.fid, f.fo, ByteSpan(f.data));
+                ++s.expected;
+            }
+        } else if (s.ahead.count(pkt.seqnum)) {
+            ++stats_.duplicates;
+        } else if (s.ahead_bytes + pkt.data.size() <= cfg_.window) {
+            ++stats_.out_of_order;
+            s.ahead_bytes += pkt.data.size();
+            s.ahead.emplace(pkt.seqnum, Fragment{pkt.flags, pkt.fid, pkt.fo,
+                                                 std::vector<uint8_t>(pkt.data.begin(), pkt.data.end())});
+        }
+
+        // O Revive é respondido antes de tudo com ACK + ACCEPT. Fora isso, o ACK vai de carona
+        // nos dados do central e, se não houver dados a enviar, segue um ACK puro.
+        if (revive) send_ack(pkt.sid, s, s.expected - 1, now, FLAG_ACCEPT_REJECT, reply);
+        size_t sent = pump_tx(pkt.sid, s, now, reply);
+        if (sent == 0 && !revive) send_ack(pkt.sid, s, s.expected - 1, now, 0, reply);
+    }
+
+    void accept_fragment(const Sid& sid, Session& s, uint8_t flags, uint8_t fid, uint8_t fo, ByteSpan data) {
+        if (!s.assembling || fid != s.fid || fo != s.next_fo) {
+            // Início de uma nova mensagem (fo == 0); fragmentos órfãos descartam a anterior.
+            s.message.clear();
+            s.assembling = true;
+            s.fid = fid;
+        }
+        s.message.insert(s.message.end(), data.begin(), data.end());
+        s.next_fo = fo + 1;
+        if (!(flags & FLAG_MORE_BITS)) {
+            ++stats_.messages;
+            stats_.bytes += s.message.size();
+            if (on_message) on_message(sid, ByteSpan(s.message));
+            if (cfg_.echo) s.tx_queue.push_back(s.message);
+            s.message.clear();
+            s.assembling = false;
+        }
+    }
+
+    // --- Sentido central -> peripheral ---
+    void on_peer_ack(Session& s, const SLOWPacketView& pkt) {
+        s.peer_window = pkt.window;
+        while (!s.tx_unacked.empty() && seq_leq(s.tx_unacked.front().seqnum, pkt.acknum)) {
+            s.tx_in_flight -= s.tx_unacked.front().data.size();
+            s.tx_unacked.pop_front();
+        }
+    }
+
+    // Fragmenta as mensagens da fila dentro da janela do peripheral; retorna quantos enviou.
+    template <typename Reply>
+    size_t pump_tx(const Sid& sid, Session& s, TimePoint now, Reply& reply) {
+        size_t sent = 0;
+        while (!s.tx_queue.empty() && s.tx_in_flight < s.peer_window) {
+            const std::vector<uint8_t>& msg = s.tx_queue.front();
+            size_t chunk = std::min({SLOW_MAX_DATA_SIZE, msg.size() - s.tx_offset,
+                                     size_t(s.peer_window) - s.tx_in_flight});
+            bool last = s.tx_offset + chunk >= msg.size() || s.tx_fo == UINT8_MAX;
+            if (chunk == 0 && !last) break;
+
+            OutFragment f{s.tx_next++, static_cast<uint8_t>(FLAG_ACK | (last ? 0 : FLAG_MORE_BITS)),
+                          s.tx_fid, s.tx_fo,
+                          std::vector<uint8_t>(msg.begin() + s.tx_offset, msg.begin() + s.tx_offset + chunk), now};
+            s.tx_offset += chunk;
+            s.tx_in_flight += chunk;
+            ++s.tx_fo;
+            if (last) {
+                ++s.tx_fid;
+                s.tx_fo = 0;
+                if (s.tx_offset >= msg.size()) {
+                    s.tx_queue.pop_front();
+                    s.tx_offset = 0;
+                }
+            }
+            ++stats_.tx_packets;
+            send_fragment(sid, s, f, now, reply);
+            s.tx_unacked.push_back(std::move(f));
+            ++sent;
+        }
+        return sent;
+    }
+
+    template <typename Reply>
+    void send_fragment(const Sid& sid, const Session& s, const OutFragment& f, TimePoint now, Reply& reply) {
+        SLOWPacketView pkt;
+        pkt.sid = sid;
+        pkt.sttl = sttl_left(s, now);
+        pkt.flags = f.flags;
+        pkt.seqnum = f.seqnum;
+        pkt.acknum = s.expected - 1;
+        pkt.window = window_left(s);
+        pkt.fid = f.fid;
+        pkt.fo = f.fo;
+        pkt.data = ByteSpan(f.data.data(), f.data.size());
+        reply(pkt, s.peer);
+    }
+
+    template <typename Reply>
+    void send_ack(const Sid& sid, const Session& s, uint32_t acknum, TimePoint now, uint8_t extra_flags, Reply& reply) {
+        SLOWPacketView ack;
+        ack.sid = sid;
+        ack.sttl = sttl_left(s, now);
+        ack.flags = FLAG_ACK | extra_flags;
+        // ACK puro: seqnum igual ao acknum.
+        ack.seqnum = acknum;
+        ack.acknum = acknum;
+        ack.window = s.active ? window_left(s) : 0;
+        reply(ack, s.peer);
+    }
+
+    CentralConfig cfg_;
+    std::mt19937 rng_;
+    std::unordered_map<Sid, Session, SidHash> sessions_;
+    CentralStats stats_;
+};
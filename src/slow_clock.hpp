@@ -0,0 +1,18 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Relógio monotônico usado por todos os temporizadores do protocolo. As funções que dependem
+// de tempo recebem 'now' explicitamente, em vez de consultarem o relógio por conta própria.
+using SlowClock = std::chrono::steady_clock;
+using TimePoint = SlowClock::time_point;
+using Duration  = SlowClock::duration;
+
+inline int64_t to_ms(Duration d) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+}
+
+inline double to_ms_double(Duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "slow_packet.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SLOW_CODEC_X86 1
+#endif
+
+// --- Codificação de cabeçalhos em lote ---
+//
+// Os 16 bytes do cabeçalho depois do sid (sttl_flags, seqnum, acknum, win_fid_fo) têm, em
+// little-endian, exatamente a disposição dos campos sttl..fo de SLOWPacketView, com uma única
+// diferença: no fio o primeiro inteiro é (sttl << 5) | flags. Assim cada cabeçalho cabe em um
+// registrador de 128 bits: uma carga, um deslocamento da lane 0 (a divisão 27/5 bits), uma
+// mistura e um armazenamento, sem montar os inteiros byte a byte. A divisão 16/8/8 de
+// window/fid/fo sai de graça, porque os campos já estão na ordem do fio. Com AVX2 são dois
+// cabeçalhos por registrador de 256 bits.
+//
+// O caminho é escolhido em tempo de execução (AVX2, SSE4.1 ou escalar) e pode ser forçado,
+// como faz o slow_codec_bench. Se a disposição da struct não for a esperada (ou o host não for
+// little-endian), só o caminho escalar é usado.
+
+enum class CodecPath {
+    Scalar,  // encode_header/decode, um pacote por vez
+    Sse41,   // um cabeçalho por registrador de 128 bits
+    Avx2     // dois cabeçalhos por registrador de 256 bits
+};
+
+inline const char* codec_path_name(CodecPath path) {
+    switch (path) {
+        case CodecPath::Scalar: return "scalar";
+        case CodecPath::Sse41:  return "sse4.1";
+        case CodecPath::Avx2:   return "avx2";
+    }
+    return "?";
+}
+
+namespace codec_detail {
+
+constexpr size_t FIELDS = offsetof(SLOWPacketView, sttl);
+
+constexpr bool LAYOUT_OK =
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ &&
+    offsetof(SLOWPacketView, seqnum) == FIELDS + 4 &&
+    offsetof(SLOWPacketView, acknum) == FIELDS + 8 &&
+    offsetof(SLOWPacketView, window) == FIELDS + 12 &&
+    offsetof(SLOWPacketView, fid) == FIELDS + 14 &&
+    offsetof(SLOWPacketView, fo) == FIELDS + 15;
+
+inline uint8_t* fields_of(SLOWPacketView& v) { return reinterpret_cast<uint8_t*>(&v) + FIELDS; }
+inline const uint8_t* fields_of(const SLOWPacketView& v) { return reinterpret_cast<const uint8_t*>(&v) + FIELDS; }
+
+inline void encode_scalar(const SLOWPacketView* in, uint8_t* const* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) in[i].encode_header(out[i]);
+}
+
+inline void decode_scalar(const ByteSpan* in, SLOWPacketView* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) SLOWPacketView::decode_into(in[i].data(), in[i].size(), out[i]);
+}
+
+#ifdef SLOW_CODEC_X86
+
+__attribute__((target("sse4.1")))
+inline void encode_one_sse41(const SLOWPacketView& in, uint8_t* out) {
+    const __m128i sttl_mask = _mm_setr_epi32(0x07FFFFFF, 0, 0, 0);
+    __m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i*>(fields_of(in)));
+    __m128i packed = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(f, sttl_mask), 5),
+                                  _mm_cvtsi32_si128(in.flags & 0x1F));
+    f = _mm_blend_epi16(f, packed, 0x03); // lane 0: sttl_flags; lanes 1..3 passam intactas
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_loadu_si128(reinterpret_cast<const __m128i*>(in.sid.data())));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), f);
+}
+
+__attribute__((target("sse4.1")))
+inline void decode_one_sse41(ByteSpan in, SLOWPacketView& out) {
+    const uint8_t* buf = in.data();
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + 16));
+    __m128i f = _mm_blend_epi16(x, _mm_srli_epi32(x, 5), 0x03);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out.sid.data()), _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(fields_of(out)), f);
+    out.flags = static_cast<uint8_t>(_mm_cvtsi128_si32(x) & 0x1F);
+    out.data = {buf + SLOW_HEADER_SIZE, in.size() - SLOW_HEADER_SIZE};
+}
+
+__attribute__((target("sse4.1")))
+inline void encode_sse41(const SLOWPacketView* in, uint8_t* const* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) encode_one_sse41(in[i], out[i]);
+}
+
+__attribute__((target("sse4.1")))
+inline void decode_sse41(const ByteSpan* in, SLOWPacketView* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) decode_one_sse41(in[i], out[i]);
+}
+
+__attribute__((target("avx2")))
+inline void encode_avx2(const SLOWPacketView* in, uint8_t* const* out, size_t n) {
+    const __m256i sttl_mask = _mm256_setr_epi32(0x07FFFFFF, 0, 0, 0, 0x07FFFFFF, 0, 0, 0);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m256i f = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(fields_of(in[i])))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(fields_of(in[i + 1]))), 1);
+        __m256i flags = _mm256_setr_epi32(in[i].flags & 0x1F, 0, 0, 0, in[i + 1].flags & 0x1F, 0, 0, 0);
+        __m256i packed = _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(f, sttl_mask), 5), flags);
+        f = _mm256_blend_epi32(f, packed, 0x11); // lane 0 de cada cabeçalho
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out[i]), _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[i].sid.data())));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out[i] + 16), _mm256_castsi256_si128(f));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out[i + 1]), _mm_loadu_si128(reinterpret_cast<const __m128i*>(in[i + 1].sid.data())));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out[i + 1] + 16), _mm256_extracti128_si256(f, 1));
+    }
+    if (i < n) encode_one_sse41(in[i], out[i]);
+}
+
+__attribute__((target("avx2")))
+inline void decode_avx2(const ByteSpan* in, SLOWPacketView* out, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const uint8_t* a = in[i].data();
+        const uint8_t* b = in[i + 1].data();
+        __m256i x = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + 16))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + 16)), 1);
+        __m256i f = _mm256_blend_epi32(x, _mm256_srli_epi32(x, 5), 0x11);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out[i].sid.data()), _mm_loadu_si128(reinterpret_cast<const __m128i*>(a)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(fields_of(out[i])), _mm256_castsi256_si128(f));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out[i + 1].sid.data()), _mm_loadu_si128(reinterpret_cast<const __m128i*>(b)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(fields_of(out[i + 1])), _mm256_extracti128_si256(f, 1));
+        out[i].flags = static_cast<uint8_t>(_mm256_extract_epi32(x, 0) & 0x1F);
+        out[i + 1].flags = static_cast<uint8_t>(_mm256_extract_epi32(x, 4) & 0x1F);
+        out[i].data = {a + SLOW_HEADER_SIZE, in[i].size() - SLOW_HEADER_SIZE};
+        out[i + 1].data = {b + SLOW_HEADER_SIZE, in[i + 1].size() - SLOW_HEADER_SIZE};
+    }
+    if (i < n) decode_one_sse41(in[i], out[i]);
+}
+
+#endif // SLOW_CODEC_X86
+
+inline CodecPath detect_codec_path() {
+#ifdef SLOW_CODEC_X86
+    if (LAYOUT_OK) {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return CodecPath::Avx2;
+        if (__builtin_cpu_supports("sse4.1")) return CodecPath::Sse41;
+    }
+#endif
+    return CodecPath::Scalar;
+}
+
+} // namespace codec_detail
+
+// Melhor caminho suportado por esta CPU (detectado uma vez).
+inline CodecPath best_codec_path() {
+    static const CodecPath path = codec_detail::detect_codec_path();
+    return path;
+}
+
+// Um caminho é utilizável se não for mais largo que o melhor detectado.
+inline bool codec_path_supported(CodecPath path) {
+    return static_cast<int>(path) <= static_cast<int>(best_codec_path());
+}
+
+// Escreve os 32 bytes do cabeçalho de in[i] em out[i], para i em [0, n). O payload não é tocado.
+inline void encode_headers(const SLOWPacketView* in, uint8_t* const* out, size_t n,
+                           CodecPath path = best_codec_path()) {
+    if (!codec_path_supported(path)) throw std::runtime_error("Caminho de codificação não suportado nesta CPU");
+    switch (path) {
+#ifdef SLOW_CODEC_X86
+        case CodecPath::Avx2:  codec_detail::encode_avx2(in, out, n); return;
+        case CodecPath::Sse41: codec_detail::encode_sse41(in, out, n); return;
+#endif
+        default: codec_detail::encode_scalar(in, out, n); return;
+    }
+}
+
+// Interpreta n datagramas de uma vez; out[i].data aponta para dentro de in[i].
+inline void decode_headers(const ByteSpan* in, SLOWPacketView* out, size_t n,
+                           CodecPath path = best_codec_path()) {
+    if (!codec_path_supported(path)) throw std::runtime_error("Caminho de codificação não suportado nesta CPU");
+    for (size_t i = 0; i < n; ++i) {
+        if (in[i].size() < SLOW_HEADER_SIZE) throw std::runtime_error("Buffer muito pequeno para o cabeçalho SLOW");
+    }
+    switch (path) {
+#ifdef SLOW_CODEC_X86
+        case CodecPath::Avx2:  codec_detail::decode_avx2(in, out, n); return;
+        case CodecPath::Sse41: codec_detail::decode_sse41(in, out, n); return;
+#endif
+        default: codec_detail::decode_scalar(in, out, n); return;
+    }
+}
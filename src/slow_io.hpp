@@ -0,0 +1,981 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include "slow_packet.hpp"
+#include "slow_clock.hpp"
+
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define SLOW_HAVE_IO_URING 1
+#endif
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+
+// Backends de E/S de datagramas disponíveis para o peripheral.
+enum class IOBackend {
+    Simple, // sendto/recvfrom: uma syscall por pacote (caminho original, usado como fallback)
+    Mmsg,   // sendmmsg/recvmmsg: um lote inteiro por syscall
+    Gso,    // sendmsg com UDP_SEGMENT: o kernel fatia um único buffer em vários datagramas
+    Uring,  // io_uring: lotes de SQEs com buffers registrados e recepção multishot
+    Auto    // o melhor disponível no kernel em execução
+};
+
+// Slot de recepção: o chamador fornece o buffer, o backend preenche 'len'. Backends que
+// recebem em buffers próprios (io_uring) trocam 'buf' e 'capacity' por um buffer emprestado,
+// válido até a próxima chamada de recv_batch.
+struct RxDatagram {
+    uint8_t* buf;
+    size_t capacity;
+    size_t len;
+};
+
+// Interface comum dos backends. Todos enviam para um destino fixo (o central da sessão).
+class DatagramIO {
+public:
+    DatagramIO(int sock, const sockaddr* dest, socklen_t dest_len) : sock_(sock), dest_len_(dest_len) {
+        std::memcpy(&dest_, dest, dest_len);
+    }
+    virtual ~DatagramIO() = default;
+
+    virtual const char* name() const = 0;
+
+    // Envia os datagramas em ordem; retorna quantos foram aceitos pelo kernel. Backends
+    // assíncronos (io_uring) só os enfileiram e contam os enfileirados: saem no próximo flush().
+    // Os não aceitos ficam para a retransmissão da sessão, como qualquer perda. Os que
+    // vêm de uma região registrada são lidos de lá até saírem (ver reclaim); os demais são
+    // copiados na hora, e o chamador pode reaproveitar o buffer.
+    virtual size_t send_batch(const ByteSpan* pkts, size_t count) = 0;
+
+    // Entrega ao kernel o que send_batch enfileirou: o laço de eventos chama uma vez por
+    // iteração, e todos os envios da iteração (dados, ACKs e retransmissões) custam uma syscall.
+    virtual void flush() {}
+
+    // Drena os datagramas que já estiverem na fila, até 'count'. Em socket bloqueante, antes
+    // espera pelo primeiro deles. Retorna quantos slots foram preenchidos.
+    virtual size_t recv_batch(RxDatagram* slots, size_t count) = 0;
+
+    size_t send_one(ByteSpan pkt) { return send_batch(&pkt, 1); }
+
+    // Região de memória da qual sairão datagramas (o armazenamento de retransmissão de uma
+    // sessão). Backends que se beneficiam de registrá-la no kernel o fazem; os demais ignoram.
+    // Ao sair, a região deixa de ser lida: unregister_buffer espera os envios que ainda a usam.
+    virtual void register_buffer(uint8_t* /*base*/, size_t /*len*/) {}
+    virtual void unregister_buffer(const uint8_t* /*base*/) {}
+
+    // O chamador vai reescrever [base, base + len), dentro de uma região registrada: retorna
+    // quando nenhum envio ainda em curso ler dali.
+    virtual void reclaim(const uint8_t* /*base*/, size_t /*len*/) {}
+
+    // Descritor a vigiar no epoll para saber quando há o que receber: o socket, em geral.
+    virtual int poll_fd() const { return sock_; }
+
+    // Datagramas já retirados do kernel e ainda não entregues por recv_batch (o descritor de
+    // poll_fd() não fica legível por eles).
+    virtual bool rx_pending() const { return false; }
+
+    int socket_fd() const { return sock_; }
+    uint64_t syscalls() const { return syscalls_; }
+
+protected:
+    // Transportes sem destino próprio: os que não usam socket (enlace simulado, reprodução de
+    // trace) ou que apenas decoram outro backend.
+    explicit DatagramIO(int sock = -1) : sock_(sock), dest_len_(0) {}
+
+    int sock_;
+    sockaddr_storage dest_{};
+    socklen_t dest_len_;
+    uint64_t syscalls_ = 0;
+};
+
+// --- Caminho original: uma syscall por datagrama ---
+class SimpleIO : public DatagramIO {
+public:
+    using DatagramIO::DatagramIO;
+
+    const char* name() const override { return "simple"; }
+
+    size_t send_batch(const ByteSpan* pkts, size_t count) override {
+        size_t sent = 0;
+        for (; sent < count; ++sent) {
+            ++syscalls_;
+            if (sendto(sock_, pkts[sent].data(), pkts[sent].size(), 0,
+                       reinterpret_cast<const sockaddr*>(&dest_), dest_len_) < 0) {
+                break;
+            }
+        }
+        return sent;
+    }
+
+    size_t recv_batch(RxDatagram* slots, size_t count) override {
+        size_t got = 0;
+        int flags = 0;
+        while (got < count) {
+            ++syscalls_;
+            ssize_t len = recvfrom(sock_, slots[got].buf, slots[got].capacity, flags, nullptr, nullptr);
+            if (len < 0) break;
+            slots[got++].len = len;
+            // Depois do primeiro datagrama, apenas drena o que já chegou.
+            flags = MSG_DONTWAIT;
+        }
+        return got;
+    }
+};
+
+// --- Lotes com sendmmsg/recvmmsg ---
+class MmsgIO : public DatagramIO {
+public:
+    static constexpr size_t MAX_BATCH = 64;
+
+    using DatagramIO::DatagramIO;
+
+    const char* name() const override { return "mmsg"; }
+
+    size_t send_batch(const ByteSpan* pkts, size_t count) override {
+        size_t sent = 0;
+        while (sent < count) {
+            size_t n = std::min(count - sent, MAX_BATCH);
+            for (size_t i = 0; i < n; ++i) {
+                iov_[i].iov_base = const_cast<uint8_t*>(pkts[sent + i].data());
+                iov_[i].iov_len = pkts[sent + i].size();
+                fill_tx_header(msgs_[i].msg_hdr, &iov_[i], 1);
+            }
+            ++syscalls_;
+            int r = sendmmsg(sock_, msgs_, n, 0);
+            if (r <= 0) break;
+            sent += r;
+            if ((size_t)r < n) break;
+        }
+        return sent;
+    }
+
+    size_t recv_batch(RxDatagram* slots, size_t count) override {
+        size_t n = std::min(count, MAX_BATCH);
+        for (size_t i = 0; i < n; ++i) {
+            iov_[i].iov_base = slots[i].buf;
+            iov_[i].iov_len = slots[i].capacity;
+            msgs_[i].msg_hdr = msghdr{};
+            msgs_[i].msg_hdr.msg_iov = &iov_[i];
+            msgs_[i].msg_hdr.msg_iovlen = 1;
+        }
+        ++syscalls_;
+        // MSG_WAITFORONE: bloqueia até o primeiro datagrama e depois só drena a fila.
+        int r = recvmmsg(sock_, msgs_, n, MSG_WAITFORONE, nullptr);
+        if (r <= 0) return 0;
+        for (int i = 0; i < r; ++i) slots[i].len = msgs_[i].msg_len;
+        return r;
+    }
+
+protected:
+    void fill_tx_header(msghdr& hdr, iovec* iov, size_t iovlen) {
+        hdr = msghdr{};
+        hdr.msg_name = &dest_;
+        hdr.msg_namelen = dest_len_;
+        hdr.msg_iov = iov;
+        hdr.msg_iovlen = iovlen;
+    }
+
+    mmsghdr msgs_[MAX_BATCH]{};
+    iovec iov_[MAX_BATCH]{};
+};
+
+// --- Segmentation offload (UDP_SEGMENT) ---
+// Datagramas consecutivos do mesmo tamanho (o último pode ser menor) são agrupados em um único
+// envio; o kernel os fatia em datagramas de 'gso_size' bytes. Cada grupo vira uma mensagem do
+// sendmmsg, então um lote inteiro continua custando uma syscall.
+class GsoIO : public MmsgIO {
+public:
+    static constexpr size_t MAX_SEGMENTS = 64;
+    static constexpr size_t MAX_GSO_BYTES = 65000;
+
+    using MmsgIO::MmsgIO;
+
+    const char* name() const override { return "gso"; }
+
+    // Verifica se o kernel aceita UDP_SEGMENT neste socket.
+    static bool supported(int sock) {
+        int val = 0;
+        socklen_t len = sizeof(val);
+        return getsockopt(sock, SOL_UDP, UDP_SEGMENT, &val, &len) == 0;
+    }
+
+    size_t send_batch(const ByteSpan* pkts, size_t count) override {
+        if (disabled_) return MmsgIO::send_batch(pkts, count);
+
+        size_t sent = 0;
+        while (sent < count) {
+            // Monta até MAX_BATCH grupos, cada um com iovecs apontando direto para os pacotes.
+            size_t groups = 0, iov_used = 0, first = sent;
+            size_t i = sent;
+            while (i < count && groups < MAX_BATCH && iov_used < MAX_IOV) {
+                size_t seg = pkts[i].size();
+                size_t start_iov = iov_used;
+                size_t bytes = 0, n = 0;
+                while (i < count && n < MAX_SEGMENTS && iov_used < MAX_IOV
+                       && bytes + pkts[i].size() <= MAX_GSO_BYTES) {
+                    size_t sz = pkts[i].size();
+                    // Só o último segmento do grupo pode ser menor que 'seg'.
+                    if (sz > seg || (n > 0 && pkts[i - 1].size() != seg)) break;
+                    giov_[iov_used].iov_base = const_cast<uint8_t*>(pkts[i].data());
+                    giov_[iov_used].iov_len = sz;
+                    ++iov_used; ++n; ++i;
+                    bytes += sz;
+                }
+                fill_tx_header(msgs_[groups].msg_hdr, &giov_[start_iov], n);
+                if (n > 1) {
+                    set_segment_cmsg(msgs_[groups].msg_hdr, cmsg_[groups], seg);
+                }
+                group_sizes_[groups] = n;
+                ++groups;
+            }
+
+            ++syscalls_;
+            int r = sendmmsg(sock_, msgs_, groups, 0);
+            if (r < 0 && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT)) {
+                // Sem suporte real a GSO neste caminho: passa a usar sendmmsg puro.
+                disabled_ = true;
+                return sent + MmsgIO::send_batch(pkts + first, count - first);
+            }
+            if (r <= 0) break;
+            for (int g = 0; g < r; ++g) sent += group_sizes_[g];
+            if ((size_t)r < groups) break;
+        }
+        return sent;
+    }
+
+private:
+    static constexpr size_t MAX_IOV = MAX_BATCH * 4;
+
+    static void set_segment_cmsg(msghdr& hdr, std::array<char, CMSG_SPACE(sizeof(uint16_t))>& storage,
+                                 size_t seg) {
+        hdr.msg_control = storage.data();
+        hdr.msg_controllen = storage.size();
+        cmsghdr* cm = CMSG_FIRSTHDR(&hdr);
+        cm->cmsg_level = SOL_UDP;
+        cm->cmsg_type = UDP_SEGMENT;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t gso_size = static_cast<uint16_t>(seg);
+        std::memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+    }
+
+    iovec giov_[MAX_IOV]{};
+    std::array<char, CMSG_SPACE(sizeof(uint16_t))> cmsg_[MAX_BATCH]{};
+    size_t group_sizes_[MAX_BATCH]{};
+    bool disabled_ = false;
+};
+
+#ifdef SLOW_HAVE_IO_URING
+// --- io_uring: filas compartilhadas com o kernel ---
+// Cada datagrama (ou grupo de fragmentos vizinhos, ver group_length) vira um SQE de SEND, e
+// send_batch só o enfileira: tudo o que a iteração do laço enviou (dados, ACKs, retransmissões)
+// sai no flush() do fim dela, com um único io_uring_enter que não espera nada. As conclusões
+// são colhidas depois, da memória compartilhada, quando o anel acorda o epoll. Os grupos que
+// saem de uma região registrada (o armazenamento de retransmissão de cada sessão, via
+// register_buffer) vão por SEND_ZC com o buffer fixo: nem cópia para o skb nem fixação das
+// páginas a cada envio. A recepção é um RECV multishot armado uma vez, que o kernel completa
+// sozinho em buffers de um anel de buffers fornecidos; recv_batch só lê CQEs da memória
+// compartilhada, sem syscall, e empresta os buffers ao chamador até a chamada seguinte.
+//
+// Fala direto com as syscalls (não depende da liburing). O construtor lança std::runtime_error
+// se o kernel não oferecer o necessário (6.0+: SEND com endereço e RECV multishot), e
+// make_datagram_io recua para os outros backends. Depois disso nada lança nem espera sem
+// limite: sem SQE ou slot livre dentro de SEND_WAIT, send_batch devolve uma contagem parcial
+// (como um sendmmsg com o buffer do socket cheio) e a sessão reenvia o resto depois.
+class UringIO : public DatagramIO {
+public:
+    static constexpr unsigned SQ_ENTRIES = 256;
+    static constexpr unsigned CQ_ENTRIES = 4096;
+    static constexpr unsigned RX_BUFFERS = 512;    // potência de 2
+    static constexpr unsigned MAX_FIXED = 1024;    // entradas da tabela de buffers registrados
+    static constexpr unsigned SEND_SLOTS = 1024;   // envios em curso (cada um com seu CQE)
+    static constexpr uint16_t RX_GROUP = 0;
+    static constexpr long SEND_WAIT_NS = 10'000'000;      // espera por SQE/slot livre ao enviar
+    static constexpr long RECLAIM_WAIT_NS = 100'000'000;  // espera para a memória voltar a ser da sessão
+
+    UringIO(int sock, const sockaddr* dest, socklen_t dest_len) : DatagramIO(sock, dest, dest_len) {
+        io_uring_params p{};
+        p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+        p.cq_entries = CQ_ENTRIES;
+        ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, SQ_ENTRIES, &p));
+        if (ring_fd_ < 0) throw std::runtime_error("io_uring_setup falhou");
+        try {
+            init(p);
+        } catch (...) {
+            teardown();
+            throw;
+        }
+    }
+
+    ~UringIO() override {
+        // Os envios ainda na fila saem (ex.: o último DISCONNECT); espera-os por pouco tempo.
+        flush();
+        timespec limit{0, RECLAIM_WAIT_NS};
+        while (!in_flight_.empty() && wait_completion(&limit)) {}
+        teardown();
+    }
+
+    UringIO(const UringIO&) = delete;
+    UringIO& operator=(const UringIO&) = delete;
+
+    const char* name() const override { return "uring"; }
+    int poll_fd() const override { return ring_fd_; }
+    bool rx_pending() const override { return rx_count_ > 0; }
+
+    size_t send_batch(const ByteSpan* pkts, size_t count) override {
+        size_t i = 0;
+        while (i < count) {
+            const FixedRegion* r = region_of(pkts[i].data(), pkts[i].size());
+            size_t n = r ? group_length(pkts + i, count - i, *r) : 1;
+            const uint8_t* data = pkts[i].data();
+            size_t len = pkts[i + n - 1].data() + pkts[i + n - 1].size() - data;
+            uint16_t slot;
+            if (!acquire_slot(slot)) break;
+            if (!r) {
+                // Fora de uma região registrada (ex.: o buffer de controle da sessão, reescrito
+                // a cada ACK): copiado agora, já que só sairá no flush.
+                uint8_t* copy = bounce_.data() + size_t(slot) * SLOW_MAX_PACKET_SIZE;
+                len = std::min(len, SLOW_MAX_PACKET_SIZE);
+                std::memcpy(copy, data, len);
+                data = copy;
+            }
+            if (!prep_send(slot, data, len, n, r)) {
+                abandon_slot(slot);
+                break;
+            }
+            i += n;
+        }
+        // O rearme do RECV segue depois dos envios: o primeiro envio é que dá porta ao socket.
+        if (!recv_failed_) ensure_recv_armed();
+        return i;
+    }
+
+    void flush() override {
+        reap();
+        if (queued_ == 0) return;
+        int r = submit(0, 0);
+        // Sem espaço para conclusões (o anel de CQEs transbordou): colhe e tenta de novo.
+        if (r == -EBUSY || r == -EAGAIN) {
+            reap();
+            submit(0, 0);
+        }
+    }
+
+    // Se o kernel não devolver a memória dentro de RECLAIM_WAIT_NS, desiste: o datagrama em
+    // curso pode sair com bytes novos, o que o receptor trata como qualquer pacote corrompido.
+    void reclaim(const uint8_t* base, size_t len) override {
+        if (!reads_from(base, len)) return;
+        reap();
+        timespec limit{0, RECLAIM_WAIT_NS};
+        while (reads_from(base, len)) {
+            if (!wait_completion(&limit)) {
+                ++stalls_;
+                return;
+            }
+        }
+    }
+
+    size_t recv_batch(RxDatagram* slots, size_t count) override {
+        recycle_lent();
+        reap();
+        recv_failed_ = false;
+        while (rx_count_ == 0) {
+            bool armed = recv_armed_;
+            ensure_recv_armed();
+            if (!blocking_) {
+                if (!armed) submit(0, 0);   // o rearme não espera o flush
+                break;
+            }
+            // Socket bloqueante: espera pelo primeiro datagrama, respeitando o SO_RCVTIMEO.
+            bool timed = rcvtimeo_.tv_sec || rcvtimeo_.tv_nsec;
+            int r = submit(1, IORING_ENTER_GETEVENTS, timed ? &rcvtimeo_ : nullptr);
+            reap();
+            if (r < 0 && r != -EINTR) break;
+        }
+
+        size_t got = 0;
+        while (got < count && rx_count_ > 0) {
+            const RxCompletion& c = rx_ready_[rx_head_];
+            rx_head_ = (rx_head_ + 1) & (RX_BUFFERS - 1);
+            --rx_count_;
+            slots[got++] = {rx_buffer(c.bid), SLOW_MAX_PACKET_SIZE, c.len};
+            lent_.push_back(c.bid);
+        }
+        return got;
+    }
+
+    // Toda região registrada é enviada sem cópia e agrupada; as que também entram na tabela
+    // de buffers fixos do kernel vão por SEND_ZC.
+    void register_buffer(uint8_t* base, size_t len) override {
+        if (regions_.count(base)) return;
+        int index = -1;
+        if (fixed_ && !free_fixed_.empty()) {
+            if (update_fixed(free_fixed_.back(), iovec{base, len}) < 0) {
+                ++fixed_failures_;   // ex.: RLIMIT_MEMLOCK esgotado; a sessão usa envios comuns
+            } else {
+                index = static_cast<int>(free_fixed_.back());
+                free_fixed_.pop_back();
+            }
+        }
+        regions_.emplace(base, FixedRegion{base, len, index});
+        last_region_ = nullptr;
+    }
+
+    void unregister_buffer(const uint8_t* base) override {
+        auto it = regions_.find(base);
+        if (it == regions_.end()) return;
+        reclaim(base, it->second.len);
+        if (it->second.index >= 0) {
+            update_fixed(static_cast<unsigned>(it->second.index), iovec{nullptr, 0});
+            free_fixed_.push_back(static_cast<unsigned>(it->second.index));
+        }
+        regions_.erase(it);
+        last_region_ = nullptr;
+    }
+
+    uint64_t fixed_sends() const { return fixed_sends_; }
+    uint64_t send_errors() const { return send_errors_; }
+    size_t sends_in_flight() const { return in_flight_.size(); }
+    size_t registered_buffers() const { return regions_.size(); }
+    uint64_t fixed_failures() const { return fixed_failures_; }
+    uint64_t stalls() const { return stalls_; }   // esperas que estouraram o limite
+    bool multishot() const { return multishot_; }
+
+private:
+    static constexpr uint64_t RECV_TAG = ~0ULL;
+
+    struct FixedRegion {
+        const uint8_t* base;
+        size_t len;
+        int index;   // na tabela de buffers fixos; -1 se não coube nela
+    };
+
+    // Um envio (SQE) em curso. O slot só volta a ficar livre com o resultado e, no SEND_ZC,
+    // também com o aviso de que o kernel soltou o buffer; até lá, a memória é lida.
+    struct SendSlot {
+        const uint8_t* data = nullptr;
+        uint32_t len = 0;
+        uint16_t packets = 0;
+        bool fixed = false;
+        bool result_pending = false;
+        bool notif_pending = false;
+        uint16_t pos = 0;   // posição em in_flight_
+    };
+
+    // Grupo que o kernel recusou, para reenviar sem o recurso que falhou.
+    struct Resend {
+        const uint8_t* data;
+        uint32_t len;
+        uint16_t packets;
+    };
+
+    struct RxCompletion {
+        uint16_t bid;
+        uint32_t len;
+    };
+
+    static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                         const void* arg = nullptr, size_t argsz = 0) {
+        long r = syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+        return r < 0 ? -errno : static_cast<int>(r);
+    }
+
+    int sys_register(unsigned op, const void* arg, unsigned nr) {
+        long r = syscall(__NR_io_uring_register, ring_fd_, op, arg, nr);
+        return r < 0 ? -errno : static_cast<int>(r);
+    }
+
+    void init(const io_uring_params& p) {
+        if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG)) {
+            throw std::runtime_error("io_uring sem os recursos necessários");
+        }
+        // O SEND_ZC chegou junto com o SEND para endereço dado e o RECV multishot (6.0).
+        std::vector<uint8_t> probe_mem(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+        auto* probe = reinterpret_cast<io_uring_probe*>(probe_mem.data());
+        if (sys_register(IORING_REGISTER_PROBE, probe, 256) < 0 || probe->last_op < IORING_OP_SEND_ZC
+            || !(probe->ops[IORING_OP_SEND].flags & IO_URING_OP_SUPPORTED)
+            || !(probe->ops[IORING_OP_RECV].flags & IO_URING_OP_SUPPORTED)) {
+            throw std::runtime_error("io_uring sem SEND/RECV de rede");
+        }
+
+        ring_size_ = std::max<size_t>(p.sq_off.array + p.sq_entries * sizeof(unsigned),
+                                      p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe));
+        ring_ = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                     IORING_OFF_SQ_RING);
+        if (ring_ == MAP_FAILED) throw std::runtime_error("mmap do anel io_uring falhou");
+        sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                          IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) throw std::runtime_error("mmap dos SQEs falhou");
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        auto* base = static_cast<uint8_t*>(ring_);
+        sq_tail_ = reinterpret_cast<unsigned*>(base + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(base + p.sq_off.ring_mask);
+        cq_head_ = reinterpret_cast<unsigned*>(base + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(base + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(base + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(base + p.cq_off.cqes);
+        // O array de índices do SQ é a identidade: o SQE i ocupa a posição i.
+        auto* sq_array = reinterpret_cast<unsigned*>(base + p.sq_off.array);
+        for (unsigned i = 0; i < p.sq_entries; ++i) sq_array[i] = i;
+        sq_local_tail_ = *sq_tail_;
+
+        // Anel de buffers fornecidos para o RECV multishot.
+        br_size_ = RX_BUFFERS * sizeof(io_uring_buf);
+        void* br = mmap(nullptr, br_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (br == MAP_FAILED) throw std::runtime_error("mmap do anel de buffers falhou");
+        br_ = static_cast<io_uring_buf_ring*>(br);
+        io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<uintptr_t>(br_);
+        reg.ring_entries = RX_BUFFERS;
+        reg.bgid = RX_GROUP;
+        if (sys_register(IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            throw std::runtime_error("io_uring sem anel de buffers fornecidos");
+        }
+        rx_storage_.resize(size_t(RX_BUFFERS) * SLOW_MAX_PACKET_SIZE);
+        rx_ready_.resize(RX_BUFFERS);
+        for (unsigned bid = 0; bid < RX_BUFFERS; ++bid) provide(static_cast<uint16_t>(bid));
+        publish_buffers();
+
+        bounce_.resize(size_t(SEND_SLOTS) * SLOW_MAX_PACKET_SIZE);
+        for (unsigned i = SEND_SLOTS; i-- > 0;) free_slots_.push_back(static_cast<uint16_t>(i));
+        in_flight_.reserve(SEND_SLOTS);
+
+        // Tabela esparsa de buffers fixos; sem ela, os envios seguem sem buffer registrado.
+        io_uring_rsrc_register rr{};
+        rr.nr = MAX_FIXED;
+        rr.flags = IORING_RSRC_REGISTER_SPARSE;
+        fixed_ = sys_register(IORING_REGISTER_BUFFERS2, &rr, sizeof(rr)) >= 0;
+        if (fixed_) {
+            for (unsigned i = MAX_FIXED; i-- > 0;) free_fixed_.push_back(i);
+        }
+
+        // Segmentação no próprio socket: envios maiores que um datagrama (os grupos) são
+        // fatiados pelo kernel; os demais saem como estão.
+        int seg = SLOW_MAX_PACKET_SIZE;
+        gso_ = setsockopt(sock_, SOL_UDP, UDP_SEGMENT, &seg, sizeof(seg)) == 0;
+
+        int fl = fcntl(sock_, F_GETFL, 0);
+        blocking_ = fl >= 0 && !(fl & O_NONBLOCK);
+        timeval tv{};
+        socklen_t tvlen = sizeof(tv);
+        if (getsockopt(sock_, SOL_SOCKET, SO_RCVTIMEO, &tv, &tvlen) == 0) {
+            rcvtimeo_.tv_sec = tv.tv_sec;
+            rcvtimeo_.tv_nsec = tv.tv_usec * 1000;
+        }
+    }
+
+    void teardown() {
+        if (gso_) {
+            int off = 0;
+            setsockopt(sock_, SOL_UDP, UDP_SEGMENT, &off, sizeof(off));
+            gso_ = false;
+        }
+        if (sqes_) munmap(sqes_, sqes_size_);
+        if (ring_ && ring_ != MAP_FAILED) munmap(ring_, ring_size_);
+        if (ring_fd_ >= 0) close(ring_fd_);
+        // O anel de buffers só pode sair depois do io_uring que o usa.
+        if (br_) munmap(br_, br_size_);
+        sqes_ = nullptr;
+        ring_ = nullptr;
+        ring_fd_ = -1;
+        br_ = nullptr;
+    }
+
+    // nullptr se a fila continuar cheia: o chamador tenta de novo mais tarde.
+    io_uring_sqe* next_sqe() {
+        // Fila cheia: sai o que já está nela (esperando uma conclusão se faltar espaço no CQ).
+        if (queued_ == SQ_ENTRIES && submit(0, 0) < 0) {
+            timespec limit{0, SEND_WAIT_NS};
+            wait_completion(&limit);
+        }
+        if (queued_ == SQ_ENTRIES) {
+            ++stalls_;
+            return nullptr;
+        }
+        io_uring_sqe* sqe = &sqes_[sq_local_tail_ & sq_mask_];
+        ++sq_local_tail_;
+        ++queued_;
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    // Submete o que estiver na fila e, com IORING_ENTER_GETEVENTS, espera 'min_complete'
+    // conclusões (no máximo por 'timeout', se houver).
+    int submit(unsigned min_complete, unsigned flags, const timespec* timeout = nullptr) {
+        __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+        io_uring_getevents_arg arg{};
+        __kernel_timespec ts{};
+        arg.sigmask_sz = _NSIG / 8;
+        if (timeout) {
+            ts = {timeout->tv_sec, timeout->tv_nsec};
+            arg.ts = reinterpret_cast<uintptr_t>(&ts);
+            flags |= IORING_ENTER_EXT_ARG;
+        }
+        bool ext = flags & IORING_ENTER_EXT_ARG;
+        ++syscalls_;
+        int r = sys_enter(ring_fd_, queued_, min_complete, flags, ext ? &arg : nullptr, ext ? sizeof(arg) : 0);
+        if (r > 0) queued_ -= std::min<unsigned>(queued_, r);
+        return r;
+    }
+
+    // Submete a fila e espera ao menos uma conclusão de envio (ex.: por um slot livre).
+    // Retorna false se o próprio io_uring_enter falhou ou se nada concluiu em 'timeout'.
+    bool wait_completion(const timespec* timeout = nullptr) {
+        size_t before = in_flight_.size();
+        int r = submit(1, IORING_ENTER_GETEVENTS, timeout);
+        reap();
+        if (r == -ETIME) return in_flight_.size() < before;
+        if (r >= 0 || r == -EINTR || r == -EAGAIN || r == -EBUSY) return true;
+        // Falha no próprio io_uring_enter: os envios em curso não voltarão.
+        while (!in_flight_.empty()) {
+            SendSlot& s = send_slots_[in_flight_.back()];
+            s.result_pending = s.notif_pending = false;
+            release_slot(in_flight_.back());
+        }
+        return false;
+    }
+
+    // false se nenhum slot vagar dentro de SEND_WAIT_NS.
+    bool acquire_slot(uint16_t& slot) {
+        timespec limit{0, SEND_WAIT_NS};
+        while (free_slots_.empty()) {
+            if (!wait_completion(&limit)) {
+                ++stalls_;
+                return false;
+            }
+        }
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+        send_slots_[slot].pos = static_cast<uint16_t>(in_flight_.size());
+        in_flight_.push_back(slot);
+        return true;
+    }
+
+    // Devolve um slot que não chegou a virar SQE.
+    void abandon_slot(uint16_t slot) {
+        send_slots_[slot].result_pending = send_slots_[slot].notif_pending = false;
+        release_slot(slot);
+    }
+
+    void release_slot(uint16_t slot) {
+        SendSlot& s = send_slots_[slot];
+        if (s.result_pending || s.notif_pending) return;
+        uint16_t last = in_flight_.back();
+        in_flight_[s.pos] = last;
+        send_slots_[last].pos = s.pos;
+        in_flight_.pop_back();
+        free_slots_.push_back(slot);
+    }
+
+    bool reads_from(const uint8_t* base, size_t len) const {
+        for (uint16_t slot : in_flight_) {
+            const SendSlot& s = send_slots_[slot];
+            if (s.data < base + len && base < s.data + s.len) return true;
+        }
+        return false;
+    }
+
+    // Pacotes cheios e vizinhos na memória (fragmentos em slots consecutivos do armazenamento de
+    // retransmissão) formam um grupo enviado em um único SEND; o UDP_SEGMENT do socket o fatia
+    // em datagramas de SLOW_MAX_PACKET_SIZE bytes.
+    size_t group_length(const ByteSpan* pkts, size_t avail, const FixedRegion& r) const {
+        size_t n = 1, bytes = pkts[0].size();
+        while (gso_ && n < avail && n < GsoIO::MAX_SEGMENTS && pkts[n - 1].size() == SLOW_MAX_PACKET_SIZE
+               && pkts[n].data() == pkts[n - 1].data() + SLOW_MAX_PACKET_SIZE
+               && pkts[n].data() + pkts[n].size() <= r.base + r.len
+               && bytes + pkts[n].size() <= GsoIO::MAX_GSO_BYTES) {
+            bytes += pkts[n++].size();
+        }
+        return n;
+    }
+
+    // Grupos de uma região com buffer fixo saem por SEND_ZC (o único SEND que aceita buffers
+    // registrados): o kernel usa as páginas já fixadas em vez de copiá-las para o skb.
+    // Datagramas isolados vão por SEND comum, já que com ~1,4 KB a cópia custa menos que o aviso
+    // de conclusão do zero-copy. Esse aviso (o buffer foi liberado) chega num segundo CQE, e o
+    // slot fica ocupado até ele.
+    bool prep_send(uint16_t slot, const uint8_t* data, size_t len, size_t n, const FixedRegion* r) {
+        io_uring_sqe* sqe = next_sqe();
+        if (!sqe) return false;
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = sock_;
+        sqe->addr = reinterpret_cast<uintptr_t>(data);
+        sqe->len = static_cast<uint32_t>(len);
+        sqe->addr2 = reinterpret_cast<uintptr_t>(&dest_);
+        sqe->addr_len = static_cast<uint16_t>(dest_len_);
+        sqe->user_data = slot;
+        SendSlot& s = send_slots_[slot];
+        s = {data, static_cast<uint32_t>(len), static_cast<uint16_t>(n), false, true, false, s.pos};
+        if (n > 1 && fixed_ && r && r->index >= 0) {
+            sqe->opcode = IORING_OP_SEND_ZC;
+            sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+            sqe->buf_index = static_cast<uint16_t>(r->index);
+            s.fixed = true;
+            fixed_sends_ += n;
+        }
+        return true;
+    }
+
+    // Reenvia um grupo recusado, agora sem buffer fixo ou, se foi a segmentação que falhou,
+    // datagrama a datagrama. A memória continua sendo da região registrada.
+    // Sem slot ou SQE, o resto do grupo se perde como um datagrama descartado; a
+    // retransmissão da sessão o recupera.
+    void resend(const Resend& g) {
+        const FixedRegion* r = region_of(g.data, g.len);
+        bool split = g.packets > 1 && !gso_;
+        uint32_t step = split ? SLOW_MAX_PACKET_SIZE : g.len;
+        for (uint32_t off = 0; off < g.len; off += step) {
+            uint16_t slot;
+            if (!acquire_slot(slot)) return;
+            uint32_t len = std::min(step, g.len - off);
+            if (!prep_send(slot, g.data + off, len, split ? 1 : g.packets, r)) {
+                abandon_slot(slot);
+                return;
+            }
+        }
+    }
+
+    const FixedRegion* region_of(const uint8_t* p, size_t len) {
+        if (regions_.empty()) return nullptr;
+        // Os pacotes de um lote costumam vir da mesma sessão.
+        if (last_region_ && p >= last_region_->base && p + len <= last_region_->base + last_region_->len) {
+            return last_region_;
+        }
+        auto it = regions_.upper_bound(p);
+        if (it == regions_.begin()) return nullptr;
+        --it;
+        const FixedRegion& r = it->second;
+        if (p + len > r.base + r.len) return nullptr;
+        last_region_ = &r;
+        return last_region_;
+    }
+
+    int update_fixed(unsigned index, iovec iov) {
+        io_uring_rsrc_update2 up{};
+        up.offset = index;
+        up.data = reinterpret_cast<uintptr_t>(&iov);
+        up.nr = 1;
+        return sys_register(IORING_REGISTER_BUFFERS_UPDATE, &up, sizeof(up));
+    }
+
+    void ensure_recv_armed() {
+        if (recv_armed_) return;
+        io_uring_sqe* sqe = next_sqe();
+        if (!sqe) return;   // rearma na próxima chamada
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = sock_;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = RX_GROUP;
+        if (multishot_) sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->user_data = RECV_TAG;
+        recv_armed_ = true;
+    }
+
+    // Consome as conclusões disponíveis: resultados de envio e datagramas recebidos.
+    void reap() {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        bool returned = false;
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+            if (cqe.user_data != RECV_TAG) {
+                if (cqe.user_data < SEND_SLOTS) on_send_completion(static_cast<uint16_t>(cqe.user_data), cqe);
+                continue;
+            }
+            if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                recv_armed_ = false;
+                // Erro (ex.: socket ainda sem porta): send_batch não rearma até o próximo recv_batch.
+                if (cqe.res < 0 && cqe.res != -ENOBUFS) recv_failed_ = true;
+            }
+            if (cqe.res == -EINVAL && multishot_) multishot_ = false;   // rearma sem multishot
+            if (!(cqe.flags & IORING_CQE_F_BUFFER)) continue;
+            auto bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            if (cqe.res < 0) {
+                provide(bid);
+                returned = true;
+                continue;
+            }
+            unsigned slot = (rx_head_ + rx_count_) & (RX_BUFFERS - 1);
+            rx_ready_[slot] = {bid, static_cast<uint32_t>(cqe.res)};
+            ++rx_count_;
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        if (returned) publish_buffers();
+        // Só depois de liberar os CQEs: o reenvio pode precisar esperar por um slot.
+        while (!resends_.empty()) {
+            Resend g = resends_.back();
+            resends_.pop_back();
+            resend(g);
+        }
+    }
+
+    void on_send_completion(uint16_t slot, const io_uring_cqe& cqe) {
+        SendSlot& s = send_slots_[slot];
+        if (cqe.flags & IORING_CQE_F_NOTIF) {
+            s.notif_pending = false;
+        } else if (s.result_pending) {
+            s.result_pending = false;
+            // SEND_ZC: com F_MORE, ainda vem o aviso de buffer liberado.
+            s.notif_pending = cqe.flags & IORING_CQE_F_MORE;
+            if (cqe.res < 0) on_send_error(s, cqe.res);
+        }
+        release_slot(slot);
+    }
+
+    // Recurso recusado pelo kernel: desliga-o e reenvia só o grupo que falhou; os outros do
+    // lote já saíram. Demais erros (ex.: ECONNREFUSED) perdem o datagrama, como um sendmsg.
+    void on_send_error(const SendSlot& s, int err) {
+        ++send_errors_;
+        if (err != -EINVAL && err != -EIO && err != -ENOPROTOOPT && err != -EOPNOTSUPP) return;
+        if (s.fixed) fixed_ = false;
+        else if (s.packets > 1 && gso_) gso_ = false;
+        else return;
+        resends_.push_back({s.data, s.len, s.packets});
+    }
+
+    uint8_t* rx_buffer(uint16_t bid) { return rx_storage_.data() + size_t(bid) * SLOW_MAX_PACKET_SIZE; }
+
+    void provide(uint16_t bid) {
+        // Não usa br_->bufs: em C++ o __DECLARE_FLEX_ARRAY do cabeçalho desloca o array em 8
+        // bytes. As entradas começam no início do anel (a cauda ocupa o 'resv' da primeira).
+        io_uring_buf* b = reinterpret_cast<io_uring_buf*>(br_) + (br_tail_ & (RX_BUFFERS - 1));
+        b->addr = reinterpret_cast<uintptr_t>(rx_buffer(bid));
+        b->len = SLOW_MAX_PACKET_SIZE;
+        b->bid = bid;
+        ++br_tail_;
+    }
+
+    void publish_buffers() { __atomic_store_n(&br_->tail, br_tail_, __ATOMIC_RELEASE); }
+
+    // Devolve ao kernel os buffers entregues no recv_batch anterior.
+    void recycle_lent() {
+        if (lent_.empty()) return;
+        for (uint16_t bid : lent_) provide(bid);
+        lent_.clear();
+        publish_buffers();
+    }
+
+    int ring_fd_ = -1;
+    void* ring_ = nullptr;
+    size_t ring_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_local_tail_ = 0;
+    unsigned queued_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    std::array<SendSlot, SEND_SLOTS> send_slots_{};
+    std::vector<uint16_t> free_slots_;
+    std::vector<uint16_t> in_flight_;
+    std::vector<uint8_t> bounce_;   // cópias dos datagramas de fora das regiões, um por slot
+    std::vector<Resend> resends_;
+    uint64_t send_errors_ = 0;
+    bool gso_ = false;
+
+    bool fixed_ = false;
+    std::map<const uint8_t*, FixedRegion> regions_;
+    const FixedRegion* last_region_ = nullptr;
+    std::vector<unsigned> free_fixed_;
+    uint64_t fixed_sends_ = 0;
+    uint64_t fixed_failures_ = 0;
+    uint64_t stalls_ = 0;
+
+    io_uring_buf_ring* br_ = nullptr;
+    size_t br_size_ = 0;
+    uint16_t br_tail_ = 0;
+    std::vector<uint8_t> rx_storage_;
+    std::vector<RxCompletion> rx_ready_;
+    unsigned rx_head_ = 0;
+    unsigned rx_count_ = 0;
+    std::vector<uint16_t> lent_;
+    bool recv_armed_ = false;
+    bool recv_failed_ = false;
+    bool multishot_ = true;
+
+    bool blocking_ = false;
+    timespec rcvtimeo_{};
+};
+#endif
+
+// Espera até o socket ter dados para ler ou 'timeout' passar. Retorna true se houver dados.
+inline bool wait_readable(int fd, Duration timeout) {
+    pollfd pfd{fd, POLLIN, 0};
+    int ms = static_cast<int>(std::max<int64_t>(0, to_ms(timeout + std::chrono::microseconds(999))));
+    return poll(&pfd, 1, ms) > 0;
+}
+
+inline bool set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+inline const char* io_backend_name(IOBackend kind) {
+    switch (kind) {
+        case IOBackend::Simple: return "simple";
+        case IOBackend::Mmsg:   return "mmsg";
+        case IOBackend::Gso:    return "gso";
+        case IOBackend::Uring:  return "uring";
+        case IOBackend::Auto:   return "auto";
+    }
+    return "?";
+}
+
+inline bool parse_io_backend(const std::string& name, IOBackend& out) {
+    if (name == "simple")    out = IOBackend::Simple;
+    else if (name == "mmsg") out = IOBackend::Mmsg;
+    else if (name == "gso")  out = IOBackend::Gso;
+    else if (name == "uring") out = IOBackend::Uring;
+    else if (name == "auto") out = IOBackend::Auto;
+    else return false;
+    return true;
+}
+
+// Cria o backend pedido, recuando para o próximo mais simples quando o kernel não o suporta.
+inline std::unique_ptr<DatagramIO> make_datagram_io(IOBackend kind, int sock,
+                                                    const sockaddr* dest, socklen_t dest_len) {
+#ifdef SLOW_HAVE_IO_URING
+    if (kind == IOBackend::Uring) {
+        try {
+            return std::make_unique<UringIO>(sock, dest, dest_len);
+        } catch (const std::runtime_error&) {
+            // Kernel sem io_uring (ou com ele desabilitado): segue para o GSO.
+        }
+    }
+#endif
+    if (kind == IOBackend::Uring) kind = IOBackend::Gso;
+    if (kind == IOBackend::Auto || kind == IOBackend::Gso) {
+        if (GsoIO::supported(sock)) return std::make_unique<GsoIO>(sock, dest, dest_len);
+        kind = IOBackend::Mmsg;
+    }
+    if (kind == IOBackend::Mmsg) return std::make_unique<MmsgIO>(sock, dest, dest_len);
+    return std::make_unique<SimpleIO>(sock, dest, dest_len);
+}
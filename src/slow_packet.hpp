@@ -1,12 +1,19 @@
 #pragma once
 
+#include <cassert>
 #include <cstdint>
+#include <cstddef>
 #include <vector>
 #include <stdexcept>
 #include <array>
 #include <algorithm>
 #include <cstring>
 
+// Limites de tamanho definidos pela especificação do SLOW.
+constexpr size_t SLOW_HEADER_SIZE     = 32;
+constexpr size_t SLOW_MAX_DATA_SIZE   = 1440;
+constexpr size_t SLOW_MAX_PACKET_SIZE = SLOW_HEADER_SIZE + SLOW_MAX_DATA_SIZE; // 1472
+
 // Enumeração das flags do protocolo, com os valores de bit corretos.
 enum SlowFlags : uint8_t {
     FLAG_MORE_BITS     = 1 << 0, // 1
@@ -16,92 +23,174 @@ enum SlowFlags : uint8_t {
     FLAG_CONNECT       = 1 << 4  // 16
 };
 
-// Estrutura que representa um pacote SLOW, espelhando a especificação.
-struct SLOWPacket {
-    std::array<uint8_t, 16> sid;
-    uint8_t  flags;
-    uint32_t sttl;
-    uint32_t seqnum;
-    uint32_t acknum;
-    uint16_t window;
-    uint8_t  fid;
-    uint8_t  fo;
-    std::vector<uint8_t> data;
-
-    // Converte a struct para uma sequência de bytes pronta para transmissão.
-    std::vector<uint8_t> serialize() const {
-        if (data.size() > 1440) {
-            throw std::runtime_error("O campo 'data' excede o limite máximo de 1440 bytes.");
-        }
-
-        std::vector<uint8_t> buf;
-        // Otimização para pré-alocar a memória necessária (32 bytes de cabeçalho + dados).
-        buf.reserve(32 + data.size());
-
-        buf.insert(buf.end(), sid.begin(), sid.end());
+// Referência não-proprietária para uma sequência contígua de bytes (um std::span mínimo para C++17).
+struct ByteSpan {
+    const uint8_t* ptr = nullptr;
+    size_t len = 0;
+
+    ByteSpan() = default;
+    ByteSpan(const uint8_t* p, size_t n) : ptr(p), len(n) {}
+    ByteSpan(const std::vector<uint8_t>& v) : ptr(v.data()), len(v.size()) {}
+
+    const uint8_t* data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    const uint8_t* begin() const { return ptr; }
+    const uint8_t* end() const { return ptr + len; }
+    ByteSpan subspan(size_t offset, size_t count) const {
+        assert(offset <= len && count <= len - offset);
+        return {ptr + offset, count};
+    }
+};
 
+// Leitura/escrita de inteiros em little-endian, independente da arquitetura do host.
+inline void store_le32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+inline uint32_t load_le32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0])
+         | (static_cast<uint32_t>(p[1]) << 8)
+         | (static_cast<uint32_t>(p[2]) << 16)
+         | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Cabeçalho SLOW com um payload não-proprietário: aponta para o buffer de origem (envio)
+// ou para o buffer de recepção (chegada), sem nenhuma cópia ou alocação.
+struct SLOWPacketView {
+    std::array<uint8_t, 16> sid{};
+    uint8_t  flags  = 0;
+    uint32_t sttl   = 0;
+    uint32_t seqnum = 0;
+    uint32_t acknum = 0;
+    uint16_t window = 0;
+    uint8_t  fid    = 0;
+    uint8_t  fo     = 0;
+    ByteSpan data;
+
+    size_t encoded_size() const { return SLOW_HEADER_SIZE + data.size(); }
+
+    // Escreve apenas os 32 bytes do cabeçalho em 'out'.
+    void encode_header(uint8_t* out) const {
+        std::memcpy(out, sid.data(), 16);
         // enpacotamento: sttl nos bits altos, flags nos bits baixos.
-        uint32_t sttl_flags = ((sttl & 0x07FFFFFF) << 5) | (flags & 0x1F);
-        // Serializa o campo combinado em 4 bytes, respeitando o formato little-endian.
-        for (int i = 0; i < 4; ++i) {
-            buf.push_back((sttl_flags >> (i * 8)) & 0xFF);
-        }
+        store_le32(out + 16, ((sttl & 0x07FFFFFF) << 5) | (flags & 0x1F));
+        store_le32(out + 20, seqnum);
+        store_le32(out + 24, acknum);
+        // Empacota os campos window, fid e fo em um único inteiro de 32 bits.
+        store_le32(out + 28, (static_cast<uint32_t>(fo) << 24)
+                           | (static_cast<uint32_t>(fid) << 16)
+                           | window);
+    }
 
-        for (int i = 0; i < 4; ++i) {
-            buf.push_back((seqnum >> (i * 8)) & 0xFF);
+    // Codifica cabeçalho + payload no buffer do chamador e retorna o número de bytes escritos.
+    // Se o payload já estiver posicionado logo após o cabeçalho em 'out', nada é copiado.
+    size_t encode(uint8_t* out, size_t capacity) const {
+        if (data.size() > SLOW_MAX_DATA_SIZE) {
+            throw std::runtime_error("O campo 'data' excede o limite máximo de 1440 bytes.");
         }
-
-        for (int i = 0; i < 4; ++i) {
-            buf.push_back((acknum >> (i * 8)) & 0xFF);
+        if (capacity < encoded_size()) {
+            throw std::runtime_error("Buffer de saída muito pequeno para o pacote SLOW");
         }
-
-        // Empacota os campos window, fid e fo em um único inteiro de 32 bits.
-        uint32_t win_fid_fo = (static_cast<uint32_t>(fo) << 24)
-                             | (static_cast<uint32_t>(fid) << 16)
-                             | (window & 0xFFFF);
-        for (int i = 0; i < 4; ++i) {
-            buf.push_back((win_fid_fo >> (i * 8)) & 0xFF);
+        encode_header(out);
+        if (!data.empty() && data.data() != out + SLOW_HEADER_SIZE) {
+            std::memcpy(out + SLOW_HEADER_SIZE, data.data(), data.size());
         }
+        return encoded_size();
+    }
 
-        buf.insert(buf.end(), data.begin(), data.end());
-        return buf;
+    // Interpreta um datagrama recebido; 'data' passa a apontar para dentro de 'buf'.
+    static SLOWPacketView decode(const uint8_t* buf, size_t len) {
+        SLOWPacketView v;
+        decode_into(buf, len, v);
+        return v;
     }
 
-    // Converte uma sequência de bytes recebida da rede de volta para a struct.
-    static SLOWPacket deserialize(const std::vector<uint8_t>& buf) {
+    // Como decode, mas escreve direto em 'v'. Em lotes, evita montar a view numa temporária e
+    // copiá-la: a cópia lê em blocos de 16 bytes o que acabou de ser escrito campo a campo, e o
+    // encaminhamento store-to-load falha em cada pacote.
+    static void decode_into(const uint8_t* buf, size_t len, SLOWPacketView& v) {
         // Um pacote SLOW válido deve ter no mínimo o tamanho do cabeçalho.
-        if (buf.size() < 32) {
+        if (len < SLOW_HEADER_SIZE) {
             throw std::runtime_error("Buffer muito pequeno para o cabeçalho SLOW");
         }
 
-        SLOWPacket pkt;
-        size_t offset = 0;
-
-        std::copy_n(buf.begin(), 16, pkt.sid.begin());
-        offset += 16;
+        std::memcpy(v.sid.data(), buf, 16);
 
-        // Usa memcpy para ler 4 bytes do buffer e reconstruir o inteiro de 32 bits.
-        uint32_t sttl_flags = 0;
-        std::memcpy(&sttl_flags, &buf[offset], 4);
         // Desempacota os campos sttl e flags a partir do inteiro lido.
-        pkt.flags = sttl_flags & 0x1F;
-        pkt.sttl  = sttl_flags >> 5;
-        offset += 4;
+        uint32_t sttl_flags = load_le32(buf + 16);
+        v.flags = sttl_flags & 0x1F;
+        v.sttl  = sttl_flags >> 5;
 
-        std::memcpy(&pkt.seqnum, &buf[offset], 4);
-        offset += 4;
+        v.seqnum = load_le32(buf + 20);
+        v.acknum = load_le32(buf + 24);
 
-        std::memcpy(&pkt.acknum, &buf[offset], 4);
-        offset += 4;
+        uint32_t win_fid_fo = load_le32(buf + 28);
+        v.window = win_fid_fo & 0xFFFF;
+        v.fid = (win_fid_fo >> 16) & 0xFF;
+        v.fo = (win_fid_fo >> 24) & 0xFF;
 
-        uint32_t win_fid_fo = 0;
-        std::memcpy(&win_fid_fo, &buf[offset], 4);
-        pkt.window = win_fid_fo & 0xFFFF;
-        pkt.fid = (win_fid_fo >> 16) & 0xFF;
-        pkt.fo = (win_fid_fo >> 24) & 0xFF;
-        offset += 4;
+        v.data = {buf + SLOW_HEADER_SIZE, len - SLOW_HEADER_SIZE};
+    }
+};
 
-        pkt.data.assign(buf.begin() + offset, buf.end());
+// Estrutura que representa um pacote SLOW, espelhando a especificação.
+// É a forma proprietária (dona do payload) do pacote; a codificação em si é feita por SLOWPacketView.
+struct SLOWPacket {
+    std::array<uint8_t, 16> sid;
+    uint8_t  flags;
+    uint32_t sttl;
+    uint32_t seqnum;
+    uint32_t acknum;
+    uint16_t window;
+    uint8_t  fid;
+    uint8_t  fo;
+    std::vector<uint8_t> data;
+
+    // Visão não-proprietária deste pacote (o payload continua pertencendo a 'data').
+    SLOWPacketView view() const {
+        SLOWPacketView v;
+        v.sid = sid;
+        v.flags = flags;
+        v.sttl = sttl;
+        v.seqnum = seqnum;
+        v.acknum = acknum;
+        v.window = window;
+        v.fid = fid;
+        v.fo = fo;
+        v.data = data;
+        return v;
+    }
+
+    // Cria um pacote proprietário copiando o payload referenciado pela visão.
+    static SLOWPacket from_view(const SLOWPacketView& v) {
+        SLOWPacket pkt;
+        pkt.sid = v.sid;
+        pkt.flags = v.flags;
+        pkt.sttl = v.sttl;
+        pkt.seqnum = v.seqnum;
+        pkt.acknum = v.acknum;
+        pkt.window = v.window;
+        pkt.fid = v.fid;
+        pkt.fo = v.fo;
+        pkt.data.assign(v.data.begin(), v.data.end());
         return pkt;
     }
-};
\ No newline at end of file
+
+    // Converte a struct para uma sequência de bytes pronta para transmissão. O limite do
+    // payload é verificado por encode.
+    std::vector<uint8_t> serialize() const {
+        auto v = view();
+        std::vector<uint8_t> buf(v.encoded_size());
+        v.encode(buf.data(), buf.size());
+        return buf;
+    }
+
+    // Converte uma sequência de bytes recebida da rede de volta para a struct.
+    static SLOWPacket deserialize(const std::vector<uint8_t>& buf) {
+        return from_view(SLOWPacketView::decode(buf.data(), buf.size()));
+    }
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include "slow_packet.hpp"
+
+// Session ID em formato UUID padrão para melhor legibilidade.
+inline std::string sid_to_string(const std::array<uint8_t, 16>& sid) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(36);
+    for (size_t i = 0; i < sid.size(); ++i) {
+        out += digits[sid[i] >> 4];
+        out += digits[sid[i] & 0xf];
+        if (i == 3 || i == 5 || i == 7 || i == 9) out += '-';
+    }
+    return out;
+}
+
+// Bytes em hexadecimal, separados por espaço, para depuração.
+inline std::string bytes_to_hex(ByteSpan buf) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(buf.size() * 3);
+    for (auto b : buf) {
+        out += digits[b >> 4];
+        out += digits[b & 0xf];
+        out += ' ';
+    }
+    return out;
+}
+
+// Imprime um Session ID em formato UUID padrão para melhor legibilidade.
+inline void print_sid(const std::array<uint8_t, 16>& sid) {
+    std::cout << sid_to_string(sid);
+}
+
+// Imprime o conteúdo de um buffer de bytes em hexadecimal para depuração.
+inline void print_bytes(ByteSpan buf) {
+    std::cout << "Serialized (" << buf.size() << " bytes): " << bytes_to_hex(buf) << std::endl;
+}
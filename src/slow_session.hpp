@@ -0,0 +1,1017 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <vector>
+#include <memory>
+#include <optional>
+#include "slow_packet.hpp"
+#include "slow_io.hpp"
+#include "congestion.hpp"
+#include "metrics.hpp"
+#include "payload_source.hpp"
+#include "log.hpp"
+#include "reassembly.hpp"
+#include "retransmit_ring.hpp"
+#include "rtt_estimator.hpp"
+#include "session_cache.hpp"
+#include "timer_wheel.hpp"
+
+// Parâmetros de uma sessão; os padrões reproduzem o comportamento original do peripheral.
+struct SessionConfig {
+    size_t retransmit_slots = 256;          // pacotes em trânsito comportados pela fila
+    // Espaço para mensagens recebidas ainda incompletas; a janela anunciada é o que sobra dele.
+    size_t receive_buffer = SLOW_MAX_MESSAGE_SIZE;
+    int max_connect_attempts = 3;
+    Duration handshake_timeout = std::chrono::seconds(2);
+    int max_disconnect_attempts = 3;
+    bool verbose = true;                    // imprime o andamento da sessão
+    RttEstimator::Config rtt;
+    // Sem controle por padrão: com perda aleatória e o caminho livre, o NewReno corta a janela a
+    // cada perda e fica abaixo do envio limitado só pela janela do central. Ele compensa quando
+    // várias sessões disputam um gargalo (ver os testes do slow_sim no CMakeLists.txt).
+    CongestionAlgorithm congestion = CongestionAlgorithm::None;
+    bool pacing = true;                     // espaça os envios na taxa indicada pelo controlador
+};
+
+enum class SessionState {
+    Idle,          // criada, ainda sem handshake
+    Connecting,    // CONNECT enviado, aguardando ACCEPT
+    Reviving,      // Revive (com o primeiro fragmento de dados) enviado, aguardando ACK/ACCEPT
+    Established,   // handshake concluído, transmitindo
+    Disconnecting, // Disconnect enviado, aguardando ACK
+    Closed,        // encerrada normalmente
+    Expired,       // o STTL venceu sem notícias do central
+    Failed         // conexão rejeitada ou sem resposta
+};
+
+inline const char* session_state_name(SessionState s) {
+    switch (s) {
+        case SessionState::Idle:          return "idle";
+        case SessionState::Connecting:    return "connecting";
+        case SessionState::Reviving:      return "reviving";
+        case SessionState::Established:   return "established";
+        case SessionState::Disconnecting: return "disconnecting";
+        case SessionState::Closed:        return "closed";
+        case SessionState::Expired:       return "expired";
+        case SessionState::Failed:        return "failed";
+    }
+    return "?";
+}
+
+// --- Máquina de estados de uma sessão SLOW ---
+//
+// Reúne o estado que antes circulava solto entre main(), send_data() e disconnect() (sid,
+// sttl, seqnums, janela do central e fila de pendentes). A sessão não espera por nada: reage a
+// pacotes (on_packet) e aos seus temporizadores na roda compartilhada, e quem a dirige é o
+// laço de eventos que a possui.
+class SlowSession {
+public:
+    struct Callbacks {
+        std::function<void(SlowSession&)> on_established;
+        // Mensagem toda confirmada; 'latency' vai do send() até o ACK do último fragmento.
+        std::function<void(SlowSession&, size_t bytes, Duration latency)> on_message_sent;
+        std::function<void(SlowSession&)> on_closed;                     // Closed, Expired ou Failed
+        // Mensagem do central remontada; a visão aponta para o buffer interno e só vale
+        // durante a chamada.
+        std::function<void(SlowSession&, ByteSpan message)> on_message_received;
+    };
+
+    SlowSession(uint64_t id, DatagramIO& io, TimerWheel& timers, const SessionConfig& cfg = {})
+        : id_(id), io_(io), timers_(timers), cfg_(cfg),
+          pending_(cfg.retransmit_slots), inbound_(cfg.receive_buffer), rtt_(cfg.rtt),
+          cc_(make_congestion_controller(cfg.congestion)),
+          fragment_id_(static_cast<uint8_t>(rand() % 256)) {
+        tx_batch_.reserve(pending_.capacity());
+        retransmit_timer_.on_expire = [this](TimePoint now) { on_retransmit_timer(now); };
+        sttl_timer_.on_expire = [this](TimePoint now) { on_sttl_timer(now); };
+        pace_timer_.on_expire = [this](TimePoint now) { pump(now); };
+    }
+
+    ~SlowSession() {
+        timers_.cancel(retransmit_timer_);
+        timers_.cancel(sttl_timer_);
+        timers_.cancel(pace_timer_);
+    }
+
+    SlowSession(const SlowSession&) = delete;
+    SlowSession& operator=(const SlowSession&) = delete;
+
+    // --- PASSO 1 DO HANDSHAKE: envia CONNECT ---
+    // Com uma sessão anterior para reviver (resume_from) e dados na fila, tenta antes o Revive,
+    // que já leva o primeiro fragmento e dispensa o handshake.
+    void connect(TimePoint now) {
+        if (state_ != SessionState::Idle) return;
+        // O Revive leva o primeiro fragmento; se a fonte ainda não o tem, vai o handshake.
+        if (resume_ && !outbox_.empty() && outbox_.front().source->next(SLOW_MAX_DATA_SIZE).ready()) {
+            start_revive(now);
+            return;
+        }
+        state_ = SessionState::Connecting;
+        connect_attempts_ = 0;
+        handshake_started_ = now;
+        send_connect(now);
+    }
+
+    // Soma as métricas desta sessão também nas da thread (nullptr desliga).
+    void attach_metrics(ThreadMetrics* sink) { metrics_.attach(sink); }
+
+    // Transporte só para o CONNECT e o Revive: um socket efêmero do laço, em que as respostas do
+    // handshake chegam sem ambiguidade mesmo com vários handshakes em curso. O ACK que conclui o
+    // handshake e tudo o que vem depois saem pelo transporte da sessão. nullptr desliga.
+    void set_handshake_transport(DatagramIO* io) { handshake_io_ = io; }
+
+    // Espera por uma fonte sem dados prontos (PayloadSource::wait_fd): 'wait(fd)' retorna true
+    // se vai chamar resume_source() quando 'fd' ficar legível. Sem ele (ou com false), a sessão
+    // volta a tentar a cada milissegundo.
+    void set_source_waiter(std::function<bool(int fd)> wait) { source_waiter_ = std::move(wait); }
+
+    void resume_source(TimePoint now) {
+        source_wait_fd_ = -1;
+        pump(now);
+    }
+
+    // Descritor pelo qual a sessão espera dados da fonte, ou -1.
+    int source_wait_fd() const { return source_wait_fd_; }
+
+    // Semente da estimativa de RTT: o SRTT que outras sessões já mediram até o mesmo central.
+    // Com ela, um CONNECT perdido custa alguns RTTs, e não o handshake_timeout inteiro; num
+    // handshake já em curso, a espera pela resposta é reprogramada.
+    void seed_rtt(Duration srtt, TimePoint now) {
+        if (rtt_.has_sample()) return;
+        rtt_.on_sample(srtt);
+        int attempt = state_ == SessionState::Connecting ? connect_attempts_
+                    : state_ == SessionState::Reviving   ? revive_attempts_ : 0;
+        if (attempt > 0) timers_.schedule(retransmit_timer_, std::max(now, connect_sent_ + handshake_wait(attempt)));
+    }
+
+    // Indica uma sessão encerrada anteriormente que o próximo connect() deve tentar reviver.
+    void resume_from(const CachedSession& cached) {
+        if (state_ == SessionState::Idle) resume_ = cached;
+    }
+
+    // Estado para reviver esta sessão no futuro; só existe após um encerramento normal.
+    std::optional<CachedSession> resumption() const {
+        if (state_ != SessionState::Closed || sid_ == std::array<uint8_t, 16>{}) return std::nullopt;
+        return CachedSession{sid_, sttl_, disconnect_seqnum_, last_acknum_, wall_clock_ms()};
+    }
+
+    // Enfileira uma mensagem; ela é fragmentada e transmitida assim que a sessão estiver pronta.
+    // Retorna o número de ordem do envio (ver sends_completed()).
+    uint64_t send(std::vector<uint8_t> message, TimePoint now) {
+        return send(std::make_unique<MemorySource>(std::move(message)), now);
+    }
+
+    // Enfileira um fluxo de tamanho arbitrário. Ele é lido aos poucos, conforme a janela abre, e
+    // dividido em quantas mensagens forem necessárias (no máximo 256 fragmentos cada, o limite
+    // do 'fo' de 8 bits).
+    uint64_t send(std::unique_ptr<PayloadSource> source, TimePoint now) {
+        outbox_.push_back({std::move(source), now});
+        if (state_ == SessionState::Established) pump(now);
+        return ++sends_queued_;
+    }
+
+    // Encerra a sessão assim que todas as mensagens enfileiradas forem confirmadas.
+    void close(TimePoint now) {
+        close_requested_ = true;
+        if (state_ == SessionState::Established) pump(now);
+    }
+
+    // Processa um datagrama do central já encaminhado para esta sessão.
+    void on_packet(const SLOWPacketView& pkt, TimePoint now) {
+        switch (state_) {
+            case SessionState::Connecting:
+                handle_setup(pkt, now);
+                break;
+            case SessionState::Reviving:
+                handle_revive_reply(pkt, now);
+                break;
+            case SessionState::Established:
+            case SessionState::Disconnecting:
+                handle_packet(pkt, now);
+                break;
+            default:
+                // Pacotes em sessões inativas são ignorados, conforme a especificação.
+                break;
+        }
+    }
+
+    uint64_t id() const { return id_; }
+    SessionState state() const { return state_; }
+    bool finished() const {
+        return state_ == SessionState::Closed || state_ == SessionState::Expired || state_ == SessionState::Failed;
+    }
+    const std::array<uint8_t, 16>& sid() const { return sid_; }
+    uint32_t sttl() const { return sttl_; }
+    uint32_t next_seqnum() const { return next_seqnum_; }
+    uint32_t last_acknum() const { return last_acknum_; }
+    uint16_t peer_window() const { return peer_window_; }
+    size_t bytes_in_flight() const { return pending_.bytes_in_flight(); }
+    // Memória de onde saem todos os pacotes de dados (e suas retransmissões); o laço a registra
+    // no transporte, que pode enviá-los como buffers fixos (io_uring).
+    uint8_t* tx_storage() { return pending_.storage(); }
+    size_t tx_storage_size() const { return pending_.storage_size(); }
+    const RttEstimator& rtt() const { return rtt_; }
+    const CongestionController& congestion() const { return *cc_; }
+    const SessionMetrics& metrics() const { return metrics_; }
+    uint64_t retransmissions() const { return metrics_.get(Counter::Retransmits); }
+    uint64_t fast_retransmissions() const { return metrics_.get(Counter::FastRetransmits); }
+    uint16_t receive_window() const { return inbound_.window(); }
+    bool revived() const { return revived_; }                  // estabelecida via Revive
+    // RTT medido pelo próprio handshake (sem reenvio), se houve.
+    std::optional<Duration> handshake_rtt() const { return handshake_rtt_; }
+    bool revive_rejected() const { return revive_rejected_; }  // Revive recusado; houve handshake
+    // Envios (send()) totalmente confirmados. Terminam na ordem em que foram enfileirados, então
+    // o envio de número n está confirmado quando sends_completed() >= n.
+    uint64_t sends_completed() const { return sends_completed_; }
+
+    // Dados do central chegaram e o ACK ainda não seguiu de carona em nenhum pacote de dados.
+    bool ack_pending() const { return ack_pending_; }
+
+    // Chamado pelo laço depois de drenar um lote de datagramas: se nenhum envio levou o ACK
+    // de carona, confirma com um ACK puro (um só por lote, não um por fragmento recebido).
+    void flush_ack() {
+        if (!ack_pending_) return;
+        ack_pending_ = false;
+        if (state_ != SessionState::Established && state_ != SessionState::Disconnecting) return;
+        send_pure_ack();
+    }
+
+    Callbacks callbacks;
+
+private:
+    void send_pure_ack() {
+        SLOWPacketView ack;
+        ack.sid = sid_;
+        ack.sttl = sttl_;
+        ack.flags = FLAG_ACK;
+        ack.seqnum = last_acknum_; // ACK puro: seqnum igual ao acknum
+        ack.acknum = last_acknum_;
+        ack.window = inbound_.window();
+        size_t len = ack.encode(ctrl_buf_.data(), ctrl_buf_.size());
+        io_.send_one({ctrl_buf_.data(), len});
+        metrics_.add(Counter::PureAcksSent);
+    }
+
+    struct OutMessage {
+        std::unique_ptr<PayloadSource> source;
+        TimePoint enqueued;
+    };
+
+    // Última posição de cada mensagem na sequência, para saber quando ela foi toda confirmada.
+    struct Completion {
+        uint32_t last_seqnum;
+        size_t bytes;
+        TimePoint enqueued;
+        bool end_of_send; // última mensagem da fonte passada ao send()
+    };
+
+    void send_connect(TimePoint now) {
+        SLOWPacketView pkt;
+        pkt.flags = FLAG_CONNECT;
+        pkt.window = inbound_.window();
+        size_t len = pkt.encode(ctrl_buf_.data(), ctrl_buf_.size());
+        ++connect_attempts_;
+        if (cfg_.verbose) {
+            SLOW_LOG_DEBUG("[sessão {}] Serialized ({} bytes): {}", id_, len, ByteSpan(ctrl_buf_.data(), len));
+            SLOW_LOG_INFO("[sessão {}] Enviando CONNECT (tentativa {})...", id_, connect_attempts_);
+        }
+        connect_sent_ = now;
+        handshake_transport().send_one({ctrl_buf_.data(), len});
+        timers_.schedule(retransmit_timer_, now + handshake_wait(connect_attempts_));
+    }
+
+    DatagramIO& handshake_transport() { return handshake_io_ ? *handshake_io_ : io_; }
+
+    // Espera pela resposta à tentativa 'attempt' do handshake: o RTO do caminho, dobrado a cada
+    // tentativa, limitado ao handshake_timeout; sem medida do caminho, o próprio
+    // handshake_timeout.
+    Duration handshake_wait(int attempt) const {
+        if (!rtt_.has_sample()) return cfg_.handshake_timeout;
+        return std::min(cfg_.handshake_timeout, rtt_.rto() * (1 << std::min(attempt - 1, 10)));
+    }
+
+    // --- PASSO 2 e 3 DO HANDSHAKE: recebe ACCEPT/REJECT e confirma ---
+    void handle_setup(const SLOWPacketView& resp, TimePoint now) {
+        handshake_io_ = nullptr;
+        if (!(resp.flags & FLAG_ACCEPT_REJECT)) {
+            if (cfg_.verbose) {
+                SLOW_LOG_WARN("[sessão {}] Conexão REJEITADA pelo Central (flags={})", id_, resp.flags);
+                if (!resp.data.empty()) {
+                    std::string msg(resp.data.begin(), resp.data.end());
+                    SLOW_LOG_WARN("  > Mensagem do servidor: {}", msg);
+                }
+            }
+            finish(SessionState::Failed);
+            return;
+        }
+
+        sid_ = resp.sid;
+        sttl_ = resp.sttl;
+        // O primeiro seqnum da sessão é o que o servidor me dá.
+        // O próximo que enviaremos será ele.
+        // O acknum que eu envio é o seqnum que que eu recebo.
+        next_seqnum_ = resp.seqnum;
+        last_acknum_ = resp.seqnum;
+        // Os dados do central, se vierem, começam logo depois do ACCEPT.
+        inbound_.reset(resp.seqnum + 1);
+        peer_window_ = resp.window;
+        // O handshake já fornece a primeira amostra de RTT (se não houve reenvio).
+        if (connect_attempts_ == 1) {
+            handshake_rtt_ = now - connect_sent_;
+            rtt_.on_sample(*handshake_rtt_);
+        }
+
+        if (cfg_.verbose) {
+            SLOW_LOG_INFO("[sessão {}] Conexão ACEITA pelo Central (passo 2/3 do handshake).", id_);
+            SLOW_LOG_DEBUG("  > Session ID: {}", sid_);
+            SLOW_LOG_INFO("  > Session STTL: {} ms", sttl_);
+            SLOW_LOG_INFO("  > Janela inicial do servidor: {} bytes", peer_window_);
+        }
+
+        SLOWPacketView confirm;
+        confirm.sid = sid_;
+        confirm.sttl = sttl_;
+        confirm.flags = FLAG_ACK;
+        confirm.seqnum = next_seqnum_; // ACK puro: seqnum igual ao acknum, conforme especificação.
+        confirm.acknum = last_acknum_; // acknum confirmando o pacote ACCEPT do servidor
+        confirm.window = inbound_.window();
+        size_t len = confirm.encode(ctrl_buf_.data(), ctrl_buf_.size());
+        if (cfg_.verbose) {
+            SLOW_LOG_DEBUG("[sessão {}] Serialized ({} bytes): {}", id_, len, ByteSpan(ctrl_buf_.data(), len));
+        }
+        io_.send_one({ctrl_buf_.data(), len});
+
+        timers_.cancel(retransmit_timer_);
+        state_ = SessionState::Established;
+        metrics_.add(Counter::Handshakes);
+        metrics_.set_handshake_duration(now - handshake_started_);
+        refresh_sttl(now);
+        if (cfg_.verbose) {
+            SLOW_LOG_INFO("[sessão {}] Conexão estabelecida com sucesso! Pronto para transmitir dados.", id_);
+        }
+        if (callbacks.on_established) callbacks.on_established(*this);
+        pump(now);
+    }
+
+    // Um pacote do central pode trazer um ACK dos nossos dados, dados dele, ou ambos.
+    void handle_packet(const SLOWPacketView& resp, TimePoint now) {
+        refresh_sttl(now);
+        if (!resp.data.empty()) handle_data(resp);
+        if (resp.flags & FLAG_ACK) handle_ack(resp, now);
+        else pump(now);
+    }
+
+    // --- Recepção: remonta os fragmentos e agenda o ACK ---
+    void handle_data(const SLOWPacketView& pkt) {
+        inbound_.on_fragment(pkt, [&](ByteSpan message) {
+            if (cfg_.verbose) SLOW_LOG_INFO("[sessão {}] ## MENSAGEM DE {} BYTES RECEBIDA ##", id_, message.size());
+            metrics_.add(Counter::MessagesReceived);
+            metrics_.add(Counter::BytesReceived, message.size());
+            if (callbacks.on_message_received) callbacks.on_message_received(*this, message);
+        });
+        // Duplicatas e fragmentos descartados também são (re)confirmados, com o ACK cumulativo.
+        last_acknum_ = inbound_.cumulative_ack();
+        ack_pending_ = true;
+    }
+
+    void handle_ack(const SLOWPacketView& resp, TimePoint now) {
+        if (cfg_.verbose) {
+            SLOW_LOG_DEBUG("[sessão {}] ACK recebido para Seqnum <== {}. Janela do servidor: {} bytes.",
+                           id_, resp.acknum, resp.window);
+        }
+        peer_window_ = resp.window;
+        sttl_ = resp.sttl;
+
+        if (state_ == SessionState::Disconnecting) {
+            if (seq_leq(disconnect_seqnum_, resp.acknum)) {
+                if (cfg_.verbose) SLOW_LOG_INFO("[sessão {}] Disconnect confirmado => Sessão encerrada!", id_);
+                finish(SessionState::Closed);
+            }
+            return;
+        }
+
+        // Amostra de RTT apenas de pacotes nunca retransmitidos (regra de Karn).
+        Duration sample{};
+        auto acked = pending_.find(resp.acknum);
+        if (acked && acked->retransmits == 0) {
+            sample = now - acked->sent_time;
+            rtt_.on_sample(sample);
+            metrics_.record(Histogram::Rtt, sample);
+        }
+
+        // Libera da fila os pacotes confirmados pelo ACK cumulativo.
+        size_t prior_in_flight = pending_.bytes_in_flight();
+        size_t prior_packets = pending_.size();
+        size_t acked_bytes = pending_.ack(resp.acknum);
+        if (acked_bytes > 0) {
+            metrics_.add(Counter::PacketsAcked, prior_packets - pending_.size());
+            metrics_.add(Counter::BytesAcked, acked_bytes);
+            on_ack_progress(resp.acknum, acked_bytes, prior_in_flight, sample, now);
+        } else if (resp.data.empty() && !pending_.empty() && resp.acknum + 1 == pending_.base()) {
+            on_duplicate_ack(now);
+        }
+
+        complete_messages(resp.acknum, now);
+        pump(now);
+    }
+
+    // --- Recuperação de perdas (com controle de congestionamento) ---
+    // O central confirma cada fragmento com o ACK cumulativo, então um fragmento perdido gera um
+    // ACK repetido para cada um que chega depois dele. Três repetidos indicam a perda: o
+    // fragmento é retransmitido na hora, sem esperar o RTO, e cada ACK parcial durante a
+    // recuperação aponta a próxima lacuna (NewReno, RFC 6582), reenviando-a só se ela já estava
+    // em trânsito quando a recuperação começou. Cada ACK repetido antes do limiar libera um
+    // fragmento novo além da cwnd (RFC 3042), que gera mais repetidos; só quando não há dados
+    // novos para isso o limiar cai para o que os pacotes em trânsito ainda podem gerar (RFC 5827).
+    static constexpr int DUPACK_THRESHOLD = 3;
+
+    int dupack_threshold() const {
+        if (can_send_new_data()) return DUPACK_THRESHOLD;
+        int later = static_cast<int>(pending_.size()) - 1;
+        return std::max(1, std::min(DUPACK_THRESHOLD, later));
+    }
+
+    // Há um fragmento novo pronto e espaço para ele fora da cwnd (fila e janela do central).
+    bool can_send_new_data() const {
+        return !outbox_.empty() && !pending_.full() && pending_.bytes_in_flight() < peer_window_;
+    }
+
+    bool loss_recovery_enabled() const { return cc_->algorithm() != CongestionAlgorithm::None; }
+
+    void on_ack_progress(uint32_t acknum, size_t acked_bytes, size_t prior_in_flight, Duration sample, TimePoint now) {
+        dupacks_ = 0;
+        rto_restarted_ = now;
+        if (frto_ != Frto::Off) {
+            frto_on_progress(acknum, now);
+        } else if (in_recovery_) {
+            if (seq_leq(recover_, acknum)) {
+                in_recovery_ = false;
+            } else {
+                retransmit_hole(now);
+            }
+        }
+        AckSample ack;
+        ack.acked_bytes = acked_bytes;
+        ack.prior_in_flight = prior_in_flight;
+        ack.rtt = sample;
+        ack.srtt = rtt_.srtt();
+        ack.in_recovery = in_recovery_ || frto_ != Frto::Off;
+        ack.app_limited = app_limited_;
+        ack.now = now;
+        cc_->on_ack(ack);
+    }
+
+    void on_duplicate_ack(TimePoint now) {
+        if (!loss_recovery_enabled()) return;
+        if (frto_ != Frto::Off) {
+            // A lacuna continua lá: o RTO foi legítimo e segue a recuperação convencional, como se
+            // tivesse começado no RTO. Na segunda etapa, a nova base ainda não foi reenviada.
+            frto_ = Frto::Off;
+            enter_recovery(frto_started_);
+            retransmit_hole(now);
+            return;
+        }
+        if (in_recovery_ || ++dupacks_ < dupack_threshold()) return;
+        cc_->on_loss(pending_.bytes_in_flight(), now);
+        enter_recovery(now);
+        if (cfg_.verbose) SLOW_LOG_DEBUG("[sessão {}] ACKs duplicados: retransmitindo Seqnum {}", id_, pending_.base());
+        retransmit_now(pending_.base(), now);
+    }
+
+    // A recuperação termina quando tudo o que estava em trânsito na perda for confirmado.
+    void enter_recovery(TimePoint started) {
+        in_recovery_ = true;
+        recover_ = next_seqnum_ - 1;
+        recovery_started_ = started;
+        dupacks_ = 0;
+    }
+
+    // ACK parcial: reenvia a nova base só se ela saiu antes da recuperação começar. Uma que já
+    // foi reenviada durante a recuperação (ou que saiu depois dela) ainda pode estar a caminho.
+    void retransmit_hole(TimePoint now) {
+        const RetransmitRing::Slot* next = pending_.find(pending_.base());
+        if (next && next->sent_time < recovery_started_) retransmit_now(next->seqnum, now);
+    }
+
+    // --- Detecção de RTO espúrio (F-RTO, RFC 5682) ---
+    // Um RTO pode vencer só porque os ACKs atrasaram. Depois dele, a sessão reenvia apenas a
+    // base e espera: se o primeiro ACK avança a sequência, saem dois fragmentos novos em vez de
+    // retransmissões; se o segundo também avança, ele confirmou pacotes enviados antes do RTO e
+    // nunca reenviados, então nada se perdeu e a cwnd volta ao que era. Um ACK repetido em
+    // qualquer das etapas confirma a perda.
+    enum class Frto : uint8_t { Off, FirstAck, SecondAck };
+
+    void frto_on_progress(uint32_t acknum, TimePoint now) {
+        if (seq_leq(frto_high_, acknum)) {
+            // Tudo o que estava em trânsito no RTO foi confirmado: não há o que decidir.
+            frto_ = Frto::Off;
+        } else if (frto_ == Frto::FirstAck) {
+            if (can_send_new_data()) {
+                frto_ = Frto::SecondAck;
+                frto_cwnd_ = pending_.bytes_in_flight() + 2 * SLOW_MAX_DATA_SIZE;
+            } else {
+                // Sem dados novos para testar o caminho, segue a recuperação convencional.
+                frto_ = Frto::Off;
+                enter_recovery(frto_started_);
+                retransmit_hole(now);
+            }
+        } else {
+            frto_ = Frto::Off;
+            cc_->on_spurious_timeout();
+            metrics_.add(Counter::SpuriousTimeouts);
+            if (cfg_.verbose) SLOW_LOG_DEBUG("[sessão {}] RTO espúrio: janela restaurada", id_);
+        }
+    }
+
+    // O RTO passa a contar do reenvio: a resposta a ele leva um RTT inteiro.
+    void retransmit_now(uint32_t seqnum, TimePoint now) {
+        if (auto slot = pending_.retransmit(seqnum, now)) {
+            io_.send_one(slot->packet());
+            rto_restarted_ = now;
+            metrics_.add(Counter::Retransmits);
+            metrics_.add(Counter::FastRetransmits);
+        }
+    }
+
+    // Quanto ainda pode entrar em trânsito agora: o que cabe na janela do central e, na cwnd,
+    // apenas fragmentos inteiros (a cwnd nunca é menor que um fragmento).
+    size_t send_room() const {
+        size_t in_flight = pending_.bytes_in_flight();
+        if (in_flight >= peer_window_) return 0;
+        size_t cwnd = cc_->cwnd();
+        if (frto_ == Frto::SecondAck) cwnd = std::max(cwnd, frto_cwnd_);
+        if (!in_recovery_ && cwnd < SIZE_MAX - DUPACK_THRESHOLD * SLOW_MAX_DATA_SIZE) {
+            cwnd += dupacks_ * SLOW_MAX_DATA_SIZE;
+        }
+        if (cwnd - std::min(in_flight, cwnd) < SLOW_MAX_DATA_SIZE) return 0;
+        return std::min<size_t>(SLOW_MAX_DATA_SIZE, peer_window_ - in_flight);
+    }
+
+    // Pacing por balde de fichas, reabastecido na taxa do controlador. Acumula no máximo o
+    // equivalente a 1 ms (a resolução da roda de temporização), e nunca menos que dois
+    // fragmentos, para que cada tique libere um pequeno lote em vez da janela inteira.
+    bool pacing_allows(double rate, TimePoint now) {
+        if (rate <= 0) return true;
+        double burst = std::max(2.0 * SLOW_MAX_DATA_SIZE, rate * 1e-3);
+        if (pace_last_ == TimePoint{}) {
+            pace_tokens_ = burst;
+        } else {
+            pace_tokens_ = std::min(burst, pace_tokens_ + rate * std::chrono::duration<double>(now - pace_last_).count());
+        }
+        pace_last_ = now;
+        return pace_tokens_ > 0;
+    }
+
+    void complete_messages(uint32_t acknum, TimePoint now) {
+        while (!completions_.empty() && seq_leq(completions_.front().last_seqnum, acknum)) {
+            Completion done = completions_.front();
+            completions_.pop_front();
+            if (done.end_of_send) ++sends_completed_;
+            if (cfg_.verbose) SLOW_LOG_INFO("[sessão {}] ## MENSAGEM DE {} BYTES CONFIRMADA ##", id_, done.bytes);
+            metrics_.add(Counter::MessagesAcked);
+            metrics_.record(Histogram::MessageLatency, now - done.enqueued);
+            if (callbacks.on_message_sent) callbacks.on_message_sent(*this, done.bytes, now - done.enqueued);
+        }
+    }
+
+    // --- 0-WAY CONNECT: Revive ---
+    // Retoma sid e seqnums da sessão guardada e envia o primeiro fragmento com a flag Revive. O
+    // fragmento só é consumido da fonte quando o central aceita; se ele recusar, a mensagem segue
+    // intacta para o handshake completo.
+    void start_revive(TimePoint now) {
+        state_ = SessionState::Reviving;
+        handshake_started_ = now;
+        sid_ = resume_->sid;
+        sttl_ = resume_->sttl;
+        next_seqnum_ = resume_->seqnum + 1;
+        last_acknum_ = resume_->acknum;
+        inbound_.reset(resume_->acknum + 1);
+        revive_attempts_ = 0;
+        if (cfg_.verbose) {
+            SLOW_LOG_INFO("[sessão {}] Tentando REVIVE da sessão anterior...", id_);
+            SLOW_LOG_DEBUG("  > Session ID: {}", sid_);
+        }
+        send_revive(now);
+    }
+
+    void send_revive(TimePoint now) {
+        PayloadSource::Chunk chunk = outbox_.front().source->next(SLOW_MAX_DATA_SIZE);
+        revive_len_ = chunk.data.size();
+        revive_last_ = chunk.last;
+
+        SLOWPacketView pkt;
+        pkt.sid = sid_;
+        pkt.sttl = sttl_;
+        pkt.flags = FLAG_REVIVE | FLAG_ACK | (chunk.last ? 0 : FLAG_MORE_BITS);
+        pkt.seqnum = next_seqnum_;
+        pkt.acknum = last_acknum_;
+        pkt.window = inbound_.window();
+        pkt.fid = fragment_id_;
+        pkt.fo = fragment_offset_;
+        pkt.data = chunk.data;
+        size_t len = pkt.encode(ctrl_buf_.data(), ctrl_buf_.size());
+        ++revive_attempts_;
+        connect_sent_ = now;
+        handshake_transport().send_one({ctrl_buf_.data(), len});
+        timers_.schedule(retransmit_timer_, now + handshake_wait(revive_attempts_));
+    }
+
+    void handle_revive_reply(const SLOWPacketView& resp, TimePoint now) {
+        bool accepted = resp.sid == sid_ && (resp.flags & FLAG_ACCEPT_REJECT) && (resp.flags & FLAG_ACK)
+                        && seq_leq(next_seqnum_, resp.acknum);
+        bool rejected = resp.sid == std::array<uint8_t, 16>{} && !(resp.flags & FLAG_ACCEPT_REJECT);
+        if (rejected) {
+            fall_back_to_connect(now, "recusado pelo Central");
+            return;
+        }
+        if (!accepted) return;
+
+        timers_.cancel(retransmit_timer_);
+        if (revive_attempts_ == 1) {
+            handshake_rtt_ = now - connect_sent_;
+            rtt_.on_sample(*handshake_rtt_);
+        }
+        resume_.reset();
+        revived_ = true;
+        state_ = SessionState::Established;
+        sttl_ = resp.sttl;
+        peer_window_ = resp.window;
+        refresh_sttl(now);
+        if (cfg_.verbose) SLOW_LOG_INFO("[sessão {}] Sessão REVIVIDA (0-way): dados enviados sem handshake.", id_);
+        if (handshake_io_) {
+            // O Revive saiu pelo socket efêmero: um ACK pelo transporte da sessão leva ao central
+            // o endereço para onde mandar o que vier depois.
+            handshake_io_ = nullptr;
+            send_pure_ack();
+        }
+
+        // O fragmento do Revive já foi confirmado pelo próprio ACCEPT.
+        OutMessage& msg = outbox_.front();
+        msg.source->consume(revive_len_);
+        message_bytes_ += revive_len_;
+        metrics_.add(Counter::Revives);
+        metrics_.add(Counter::PacketsSent);
+        metrics_.add(Counter::BytesSent, revive_len_);
+        metrics_.add(Counter::PacketsAcked);
+        metrics_.add(Counter::BytesAcked, revive_len_);
+        uint32_t seq = next_seqnum_++;
+        if (revive_last_) {
+            completions_.push_back({seq, message_bytes_, msg.enqueued, true});
+            message_bytes_ = 0;
+            fragment_id_++;
+            fragment_offset_ = 0;
+            outbox_.pop_front();
+        } else {
+            fragment_offset_++;
+        }
+
+        if (callbacks.on_established) callbacks.on_established(*this);
+        complete_messages(resp.acknum, now);
+        pump(now);
+    }
+
+    void fall_back_to_connect(TimePoint now, const char* why) {
+        if (cfg_.verbose) SLOW_LOG_INFO("[sessão {}] Revive {}; recorrendo ao handshake completo.", id_, why);
+        resume_.reset();
+        revive_rejected_ = true;
+        sid_ = {};
+        timers_.cancel(retransmit_timer_);
+        state_ = SessionState::Connecting;
+        connect_attempts_ = 0;
+        send_connect(now);
+    }
+
+    // --- Envio de Dados com Fragmentação e Janela Deslizante ---
+    // Preenche a janela do central com novos fragmentos e os entrega ao kernel em um único lote.
+    void pump(TimePoint now) {
+        if (state_ != SessionState::Established) return;
+
+        end_window_stall(now);
+        tx_batch_.clear();
+        double rate = cfg_.pacing ? cc_->pacing_rate() : 0;
+        size_t batch_bytes = 0;
+        bool source_dry = false;   // a fonte ainda não tem o próximo fragmento
+        size_t room;
+        while (!outbox_.empty() && !pending_.full() && (room = send_room()) > 0) {
+            // Sem fichas, o resto espera o próximo tique.
+            if (!pacing_allows(rate, now)) {
+                timers_.schedule(pace_timer_, now + std::chrono::milliseconds(1));
+                break;
+            }
+            OutMessage& msg = outbox_.front();
+
+            // O fragmento nunca excede o espaço disponível na janela.
+            PayloadSource::Chunk chunk = msg.source->next(room);
+            if (!chunk.ready()) {
+                if (const char* err = msg.source->error()) {
+                    if (cfg_.verbose) SLOW_LOG_ERROR("[sessão {}] Falha ao ler os dados a enviar: {}", id_, err);
+                    finish(SessionState::Failed);
+                    return;
+                }
+                wait_for_source(msg.source->wait_fd(), now);
+                source_dry = true;
+                break;
+            }
+
+            SLOWPacketView data_pkt;
+            data_pkt.sid = sid_;
+            data_pkt.sttl = sttl_;
+            data_pkt.seqnum = next_seqnum_;
+            data_pkt.acknum = last_acknum_;
+            data_pkt.window = inbound_.window();
+            data_pkt.fid = fragment_id_;
+            data_pkt.fo = fragment_offset_;
+
+            // Define a flag ACK e, se não for o último fragmento, a flag More Bits. Um fluxo
+            // longo é cortado em mensagens de 256 fragmentos, antes que o 'fo' dê a volta.
+            data_pkt.flags = FLAG_ACK;
+            bool last = chunk.last || fragment_offset_ == UINT8_MAX;
+            if (!last) {
+                data_pkt.flags |= FLAG_MORE_BITS;
+            }
+
+            // O payload vai da fonte direto para o slot de retransmissão, sem cópia intermediária.
+            data_pkt.data = chunk.data;
+            auto& slot = pending_.push(data_pkt.seqnum);
+            io_.reclaim(slot.buf, SLOW_MAX_PACKET_SIZE);   // um envio anterior do slot pode estar em curso
+            size_t pkt_len = data_pkt.encode(slot.buf, SLOW_MAX_PACKET_SIZE);
+            pending_.commit(slot, pkt_len, chunk.data.size(), now);
+            tx_batch_.push_back(slot.packet());
+            msg.source->consume(chunk.data.size());
+            if (rate > 0) pace_tokens_ -= pkt_len;
+            batch_bytes += chunk.data.size();
+
+            message_bytes_ += chunk.data.size();
+            next_seqnum_++;
+            fragment_offset_++;
+
+            if (last) {
+                completions_.push_back({data_pkt.seqnum, message_bytes_, msg.enqueued, chunk.last});
+                message_bytes_ = 0;
+                // ID único para agrupar todos os fragmentos da próxima mensagem.
+                fragment_id_++;
+                fragment_offset_ = 0;
+                // A próxima mensagem (ou o resto do fluxo) segue no mesmo lote.
+                if (chunk.last) outbox_.pop_front();
+            }
+        }
+        if (!tx_batch_.empty()) {
+            io_.send_batch(tx_batch_.data(), tx_batch_.size());
+            // O ACK pendente seguiu de carona nos dados.
+            ack_pending_ = false;
+            metrics_.add(Counter::PacketsSent, tx_batch_.size());
+            metrics_.add(Counter::BytesSent, batch_bytes);
+        }
+        app_limited_ = outbox_.empty() || source_dry;
+        track_window_stall(now);
+
+        if (close_requested_ && outbox_.empty() && pending_.empty()) {
+            start_disconnect(now);
+            return;
+        }
+        arm_retransmit_timer(now);
+    }
+
+    void wait_for_source(int fd, TimePoint now) {
+        if (source_wait_fd_ >= 0) return;
+        if (fd >= 0 && source_waiter_ && source_waiter_(fd)) {
+            source_wait_fd_ = fd;
+        } else {
+            timers_.schedule(pace_timer_, now + std::chrono::milliseconds(1));
+        }
+    }
+
+    // Conta o tempo em que havia dados para enviar, mas a janela (do central ou a cwnd) ou a
+    // fila de retransmissão estava cheia: começa quando um envio para por falta de espaço e
+    // termina no próximo pump() que encontra espaço. Esperas de pacing não contam.
+    bool window_stalled() const { return !outbox_.empty() && (pending_.full() || send_room() == 0); }
+
+    void track_window_stall(TimePoint now) {
+        if (stall_since_ == TimePoint{} && window_stalled()) stall_since_ = now;
+    }
+
+    void end_window_stall(TimePoint now) {
+        if (stall_since_ == TimePoint{} || window_stalled()) return;
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - stall_since_).count();
+        metrics_.add(Counter::WindowStallNs, static_cast<uint64_t>(ns));
+        stall_since_ = TimePoint{};
+    }
+
+    // O temporizador de retransmissão aponta para o pacote mais antigo da fila. Com controle de
+    // congestionamento ele também é reiniciado a cada ACK que confirma dados novos (RFC 6298,
+    // 5.3): com o envio espaçado, os ACKs repetidos de uma perda chegam alguns intervalos de
+    // pacing depois do RTT, e o RTO não deve vencer antes deles. Numa recuperação, os pacotes
+    // anteriores à perda ainda não confirmados são reenviados pelos ACKs parciais, não pelo RTO.
+    void arm_retransmit_timer(TimePoint) {
+        if (auto oldest = pending_.oldest()) {
+            TimePoint from = oldest->sent_time;
+            if (loss_recovery_enabled()) from = std::max(from, rto_restarted_);
+            timers_.schedule(retransmit_timer_, from + rtt_.rto());
+        } else {
+            timers_.cancel(retransmit_timer_);
+        }
+    }
+
+    void on_retransmit_timer(TimePoint now) {
+        switch (state_) {
+            case SessionState::Connecting:
+                if (cfg_.verbose) SLOW_LOG_WARN("[sessão {}] Timeout aguardando resposta do Central.", id_);
+                metrics_.add(Counter::Timeouts);
+                if (connect_attempts_ >= cfg_.max_connect_attempts) {
+                    if (cfg_.verbose) {
+                        SLOW_LOG_ERROR("[sessão {}] Falha ao estabelecer conexão após {} tentativas.", id_, connect_attempts_);
+                    }
+                    finish(SessionState::Failed);
+                } else {
+                    send_connect(now);
+                }
+                break;
+            case SessionState::Reviving:
+                metrics_.add(Counter::Timeouts);
+                if (revive_attempts_ >= cfg_.max_connect_attempts) {
+                    fall_back_to_connect(now, "sem resposta");
+                } else {
+                    send_revive(now);
+                }
+                break;
+            case SessionState::Established: {
+                if (loss_recovery_enabled()) {
+                    on_rto(now);
+                    break;
+                }
+                // Retransmite somente os pacotes que completaram um RTO sem confirmação.
+                tx_batch_.clear();
+                pending_.for_each_expired(now, rtt_.rto(), [&](const RetransmitRing::Slot& slot) {
+                    tx_batch_.push_back(slot.packet());
+                });
+                if (!tx_batch_.empty()) {
+                    if (cfg_.verbose) {
+                        SLOW_LOG_DEBUG("[sessão {}] Timeout! Retransmitindo {} pacote(s) (RTO: {})...",
+                                       id_, tx_batch_.size(), rtt_.rto());
+                    }
+                    io_.send_batch(tx_batch_.data(), tx_batch_.size());
+                    metrics_.add(Counter::Retransmits, tx_batch_.size());
+                    metrics_.add(Counter::Timeouts);
+                    rtt_.on_timeout();
+                }
+                arm_retransmit_timer(now);
+                break;
+            }
+            case SessionState::Disconnecting:
+                if (disconnect_attempts_ >= cfg_.max_disconnect_attempts) {
+                    // O central não é obrigado a responder; a sessão é encerrada de qualquer forma.
+                    if (cfg_.verbose) SLOW_LOG_INFO("[sessão {}] Disconnect enviado => Sessão encerrada!", id_);
+                    finish(SessionState::Closed);
+                } else {
+                    send_disconnect(now);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Com controle de congestionamento, um RTO retransmite só o primeiro pacote não confirmado
+    // (a cwnd acabou de cair). Fora de uma recuperação, os ACKs seguintes decidem se ele foi
+    // espúrio (F-RTO); dentro dela, ou num segundo RTO seguido, a perda é certa e a recuperação
+    // recomeça, com os ACKs parciais trazendo o resto.
+    void on_rto(TimePoint now) {
+        const RetransmitRing::Slot* oldest = pending_.oldest();
+        if (!oldest) return;
+        if (now - std::max(oldest->sent_time, rto_restarted_) < rtt_.rto()) {
+            arm_retransmit_timer(now);
+            return;
+        }
+        if (cfg_.verbose) {
+            SLOW_LOG_DEBUG("[sessão {}] Timeout! Retransmitindo Seqnum {} (RTO: {})...", id_, pending_.base(), rtt_.rto());
+        }
+        bool frto = !in_recovery_ && frto_ == Frto::Off;
+        cc_->on_timeout(pending_.bytes_in_flight(), now);
+        rtt_.on_timeout();
+        dupacks_ = 0;
+        rto_restarted_ = now;
+        if (frto) {
+            frto_ = Frto::FirstAck;
+            frto_high_ = next_seqnum_ - 1;
+            frto_started_ = now;
+        } else {
+            frto_ = Frto::Off;
+            enter_recovery(now);
+        }
+        if (auto slot = pending_.retransmit(pending_.base(), now)) {
+            io_.send_one(slot->packet());
+            metrics_.add(Counter::Retransmits);
+        }
+        metrics_.add(Counter::Timeouts);
+        arm_retransmit_timer(now);
+    }
+
+    // --- Desconexão ---
+    void start_disconnect(TimePoint now) {
+        if (cfg_.verbose) SLOW_LOG_INFO("[sessão {}] ## ENCERRANDO SESSÃO ##", id_);
+        state_ = SessionState::Disconnecting;
+        disconnect_attempts_ = 0;
+        metrics_.add(Counter::Disconnects);
+        disconnect_seqnum_ = next_seqnum_;
+        send_disconnect(now);
+    }
+
+    void send_disconnect(TimePoint now) {
+        SLOWPacketView disc_pkt;
+        disc_pkt.sid = sid_;
+        disc_pkt.sttl = sttl_;
+        // Conforme especificação, a combinação das flags Connect, Revive e Ack sinaliza um Disconnect.
+        disc_pkt.flags = FLAG_CONNECT | FLAG_REVIVE | FLAG_ACK;
+        disc_pkt.seqnum = disconnect_seqnum_;
+        disc_pkt.acknum = last_acknum_;
+        size_t len = disc_pkt.encode(ctrl_buf_.data(), ctrl_buf_.size());
+        io_.send_one({ctrl_buf_.data(), len});
+        ++disconnect_attempts_;
+        timers_.schedule(retransmit_timer_, now + rtt_.rto());
+    }
+
+    // --- STTL: a sessão expira se o central ficar 'sttl' ms sem se manifestar ---
+    void refresh_sttl(TimePoint now) {
+        if (sttl_ > 0) timers_.schedule(sttl_timer_, now + std::chrono::milliseconds(sttl_));
+    }
+
+    void on_sttl_timer(TimePoint) {
+        if (state_ != SessionState::Established && state_ != SessionState::Disconnecting) return;
+        if (cfg_.verbose) SLOW_LOG_WARN("[sessão {}] STTL de {} ms expirado sem resposta do Central.", id_, sttl_);
+        finish(state_ == SessionState::Disconnecting ? SessionState::Closed : SessionState::Expired);
+    }
+
+    void finish(SessionState final_state) {
+        state_ = final_state;
+        handshake_io_ = nullptr;
+        timers_.cancel(retransmit_timer_);
+        timers_.cancel(sttl_timer_);
+        timers_.cancel(pace_timer_);
+        if (callbacks.on_closed) callbacks.on_closed(*this);
+    }
+
+    uint64_t id_;
+    DatagramIO& io_;
+    DatagramIO* handshake_io_ = nullptr;
+    std::function<bool(int)> source_waiter_;
+    int source_wait_fd_ = -1;
+    std::optional<Duration> handshake_rtt_;
+    TimerWheel& timers_;
+    SessionConfig cfg_;
+    SessionState state_ = SessionState::Idle;
+
+    std::array<uint8_t, 16> sid_{};
+    uint32_t sttl_ = 0;
+    uint32_t next_seqnum_ = 0;
+    uint32_t last_acknum_ = 0;
+    uint16_t peer_window_ = 0;
+
+    RetransmitRing pending_;
+    Reassembler inbound_;
+    bool ack_pending_ = false;
+    RttEstimator rtt_;
+    std::unique_ptr<CongestionController> cc_;
+    int dupacks_ = 0;
+    bool in_recovery_ = false;
+    uint32_t recover_ = 0;      // último seqnum em trânsito quando a perda foi detectada
+    TimePoint recovery_started_{};
+    TimePoint rto_restarted_{};  // último ACK com dados novos (ou RTO), de onde o RTO conta
+    Frto frto_ = Frto::Off;
+    uint32_t frto_high_ = 0;    // último seqnum em trânsito no RTO
+    TimePoint frto_started_{};
+    size_t frto_cwnd_ = 0;      // permite os dois fragmentos novos da segunda etapa
+    bool app_limited_ = false;  // o último envio parou por falta de dados
+    double pace_tokens_ = 0;    // bytes que podem sair agora sem exceder a taxa
+    TimePoint pace_last_{};
+    std::deque<OutMessage> outbox_;
+    std::deque<Completion> completions_;
+    uint64_t sends_queued_ = 0;
+    uint64_t sends_completed_ = 0;
+    uint8_t fragment_id_;
+    uint8_t fragment_offset_ = 0;
+    size_t message_bytes_ = 0;       // bytes da mensagem em fragmentação
+    bool close_requested_ = false;
+    SessionMetrics metrics_;
+    TimePoint stall_since_{};   // início da espera por janela em curso
+
+    int connect_attempts_ = 0;
+    std::optional<CachedSession> resume_;
+    int revive_attempts_ = 0;
+    size_t revive_len_ = 0;     // bytes do fragmento levado pelo Revive (ainda não consumidos)
+    bool revive_last_ = false;
+    bool revived_ = false;
+    bool revive_rejected_ = false;
+    TimePoint connect_sent_{};
+    TimePoint handshake_started_{};
+    int disconnect_attempts_ = 0;
+    uint32_t disconnect_seqnum_ = 0;
+
+    TimerNode retransmit_timer_;
+    TimerNode sttl_timer_;
+    TimerNode pace_timer_;
+    std::vector<ByteSpan> tx_batch_;
+    std::array<uint8_t, SLOW_MAX_PACKET_SIZE> ctrl_buf_{};
+};
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "slow_io.hpp"
+
+// --- Traces de datagramas: gravação e reprodução ---
+//
+// Um trace guarda cada datagrama que passou pelo transporte do peripheral, nos dois sentidos,
+// com o instante em que passou. O formato é compacto e só acrescenta no fim:
+//
+//   cabeçalho: "SLOWTRC" + versão (1 byte)
+//   registro:  sentido (1 byte) | ns desde o registro anterior (varint) | tamanho (varint) | bytes
+//
+// O RecordingIO grava um trace em volta de qualquer backend (real ou simulado). O ReplayIO
+// faz o caminho inverso: entrega ao peripheral os datagramas recebidos na gravação, nos mesmos
+// instantes do relógio virtual, e confere os que ele envia com os gravados. Com a mesma carga,
+// um peripheral determinístico reproduz o trace pacote a pacote; a primeira divergência aponta
+// onde o comportamento mudou.
+
+enum class TraceDirection : uint8_t {
+    Sent = 0,     // peripheral -> central
+    Received = 1  // central -> peripheral
+};
+
+struct TraceRecord {
+    TraceDirection direction;
+    Duration at;                 // desde o início da gravação
+    std::vector<uint8_t> data;
+};
+
+namespace trace_detail {
+
+constexpr char MAGIC[7] = {'S', 'L', 'O', 'W', 'T', 'R', 'C'};
+constexpr uint8_t VERSION = 1;
+
+inline void put_varint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+inline bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        v |= uint64_t(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+} // namespace trace_detail
+
+// Grava registros em um arquivo; os dados vão para um buffer e são escritos em blocos.
+class TraceWriter {
+public:
+    static constexpr size_t FLUSH_BYTES = 1 << 20;
+
+    TraceWriter(const std::string& path, TimePoint start) : last_(start) {
+        file_ = std::fopen(path.c_str(), "wb");
+        if (!file_) throw std::runtime_error("Não foi possível criar o trace " + path);
+        buf_.insert(buf_.end(), std::begin(trace_detail::MAGIC), std::end(trace_detail::MAGIC));
+        buf_.push_back(trace_detail::VERSION);
+    }
+
+    ~TraceWriter() {
+        flush();
+        std::fclose(file_);
+    }
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    void write(TraceDirection dir, TimePoint at, ByteSpan data) {
+        // Instantes fora de ordem (não deveriam ocorrer) viram delta zero.
+        int64_t delta = std::chrono::duration_cast<std::chrono::nanoseconds>(at - last_).count();
+        if (delta > 0) last_ = at;
+        buf_.push_back(static_cast<uint8_t>(dir));
+        trace_detail::put_varint(buf_, delta > 0 ? delta : 0);
+        trace_detail::put_varint(buf_, data.size());
+        buf_.insert(buf_.end(), data.begin(), data.end());
+        ++records_;
+        if (buf_.size() >= FLUSH_BYTES) flush();
+    }
+
+    void flush() {
+        if (!buf_.empty()) std::fwrite(buf_.data(), 1, buf_.size(), file_);
+        buf_.clear();
+        std::fflush(file_);
+    }
+
+    uint64_t records() const { return records_; }
+
+private:
+    std::FILE* file_ = nullptr;
+    TimePoint last_;
+    std::vector<uint8_t> buf_;
+    uint64_t records_ = 0;
+};
+
+// Lê um trace inteiro; lança std::runtime_error se o arquivo não for um trace válido.
+inline std::vector<TraceRecord> read_trace(const std::string& path) {
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) throw std::runtime_error("Não foi possível abrir o trace " + path);
+    std::vector<uint8_t> bytes;
+    uint8_t chunk[1 << 16];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), f)) > 0) bytes.insert(bytes.end(), chunk, chunk + n);
+    std::fclose(f);
+
+    constexpr size_t HEADER = sizeof(trace_detail::MAGIC) + 1;
+    if (bytes.size() < HEADER || std::memcmp(bytes.data(), trace_detail::MAGIC, sizeof(trace_detail::MAGIC)) != 0) {
+        throw std::runtime_error(path + " não é um trace SLOW");
+    }
+    if (bytes[HEADER - 1] != trace_detail::VERSION) throw std::runtime_error(path + ": versão de trace não suportada");
+
+    std::vector<TraceRecord> records;
+    const uint8_t* p = bytes.data() + HEADER;
+    const uint8_t* end = bytes.data() + bytes.size();
+    Duration at = Duration::zero();
+    while (p < end) {
+        uint8_t dir = *p++;
+        uint64_t delta, len;
+        if (dir > 1 || !trace_detail::get_varint(p, end, delta) || !trace_detail::get_varint(p, end, len)
+            || len > static_cast<uint64_t>(end - p)) {
+            throw std::runtime_error(path + ": registro truncado ou inválido");
+        }
+        at += std::chrono::duration_cast<Duration>(std::chrono::nanoseconds(delta));
+        records.push_back({static_cast<TraceDirection>(dir), at, std::vector<uint8_t>(p, p + len)});
+        p += len;
+    }
+    return records;
+}
+
+// --- Gravação: decora outro transporte ---
+class RecordingIO : public DatagramIO {
+public:
+    using Clock = std::function<TimePoint()>;
+
+    // 'clock' dá o instante de cada datagrama: o relógio real, por padrão, ou o virtual do
+    // simulador.
+    RecordingIO(std::unique_ptr<DatagramIO> inner, const std::string& path,
+                Clock clock = [] { return SlowClock::now(); })
+        : RecordingIO(std::move(inner), std::make_shared<TraceWriter>(path, clock()), clock) {}
+
+    // Grava em um trace compartilhado com outros transportes do mesmo laço (ex.: os sockets
+    // efêmeros dos handshakes), na ordem em que os datagramas passam.
+    RecordingIO(std::unique_ptr<DatagramIO> inner, std::shared_ptr<TraceWriter> writer,
+                Clock clock = [] { return SlowClock::now(); })
+        : DatagramIO(inner->socket_fd()), inner_(std::move(inner)), clock_(std::move(clock)),
+          writer_(std::move(writer)) {}
+
+    const char* name() const override { return inner_->name(); }
+    int poll_fd() const override { return inner_->poll_fd(); }
+    bool rx_pending() const override { return inner_->rx_pending(); }
+    void register_buffer(uint8_t* base, size_t len) override { inner_->register_buffer(base, len); }
+    void unregister_buffer(const uint8_t* base) override { inner_->unregister_buffer(base); }
+    void flush() override { inner_->flush(); }
+    void reclaim(const uint8_t* base, size_t len) override { inner_->reclaim(base, len); }
+
+    size_t send_batch(const ByteSpan* pkts, size_t count) override {
+        size_t sent = inner_->send_batch(pkts, count);
+        syscalls_ = inner_->syscalls();
+        TimePoint now = clock_();
+        for (size_t i = 0; i < sent; ++i) writer_->write(TraceDirection::Sent, now, pkts[i]);
+        return sent;
+    }
+
+    size_t recv_batch(RxDatagram* slots, size_t count) override {
+        size_t got = inner_->recv_batch(slots, count);
+        syscalls_ = inner_->syscalls();
+        TimePoint now = clock_();
+        for (size_t i = 0; i < got; ++i) writer_->write(TraceDirection::Received, now, {slots[i].buf, slots[i].len});
+        return got;
+    }
+
+    TraceWriter& writer() { return *writer_; }
+
+private:
+    std::unique_ptr<DatagramIO> inner_;
+    Clock clock_;
+    std::shared_ptr<TraceWriter> writer_;
+};
+
+// --- Reprodução: o trace faz o papel do central ---
+//
+// Os datagramas recebidos na gravação são entregues quando o relógio virtual alcança o
+// instante gravado (medido a partir de 'start'). Os enviados pelo peripheral são comparados,
+// em ordem, com os gravados: mesmos campos do cabeçalho (exceto o fid, sorteado por sessão) e
+// mesmo tamanho de payload.
+class ReplayIO : public DatagramIO {
+public:
+    ReplayIO(std::vector<TraceRecord> records, const TimePoint& now, TimePoint start)
+        : now_(now), start_(start) {
+        for (TraceRecord& r : records) {
+            (r.direction == TraceDirection::Received ? inbound_ : expected_).push_back(std::move(r));
+        }
+    }
+
+    const char* name() const override { return "replay"; }
+
+    size_t send_batch(const ByteSpan* pkts, size_t count) override {
+        for (size_t i = 0; i < count; ++i) {
+            if (next_expected_ < expected_.size() && same_shape(pkts[i], expected_[next_expected_].data)) {
+                ++matched_;
+            } else {
+                if (diverged_ == 0) first_divergence_ = sent_;
+                ++diverged_;
+            }
+            ++sent_;
+            ++next_expected_;
+        }
+        return count;
+    }
+
+    size_t recv_batch(RxDatagram* slots, size_t count) override {
+        size_t got = 0;
+        while (got < count && next_inbound_ < inbound_.size() && start_ + inbound_[next_inbound_].at <= now_) {
+            const std::vector<uint8_t>& data = inbound_[next_inbound_++].data;
+            size_t len = std::min(data.size(), slots[got].capacity);
+            std::memcpy(slots[got].buf, data.data(), len);
+            slots[got++].len = len;
+        }
+        return got;
+    }
+
+    // Instante da próxima entrega, ou nullopt se o trace acabou.
+    std::optional<TimePoint> next_delivery() const {
+        if (next_inbound_ == inbound_.size()) return std::nullopt;
+        return start_ + inbound_[next_inbound_].at;
+    }
+
+    bool exhausted() const { return next_inbound_ == inbound_.size(); }
+    uint64_t sent() const { return sent_; }
+    uint64_t matched() const { return matched_; }
+    uint64_t diverged() const { return diverged_; }   // enviados diferentes do gravado (ou a mais)
+    uint64_t missing() const { return expected_.size() > next_expected_ ? expected_.size() - next_expected_ : 0; }
+    uint64_t first_divergence() const { return first_divergence_; }
+    size_t expected_count() const { return expected_.size(); }
+    size_t inbound_count() const { return inbound_.size(); }
+
+private:
+    static bool same_shape(ByteSpan got, const std::vector<uint8_t>& want) {
+        if (got.size() != want.size() || got.size() < SLOW_HEADER_SIZE) return false;
+        SLOWPacketView a = SLOWPacketView::decode(got.data(), got.size());
+        SLOWPacketView b = SLOWPacketView::decode(want.data(), want.size());
+        return a.sid == b.sid && a.flags == b.flags && a.sttl == b.sttl && a.seqnum == b.seqnum
+            && a.acknum == b.acknum && a.window == b.window && a.fo == b.fo;
+    }
+
+    const TimePoint& now_;
+    TimePoint start_;
+    std::vector<TraceRecord> inbound_;
+    std::vector<TraceRecord> expected_;
+    size_t next_inbound_ = 0;
+    size_t next_expected_ = 0;
+    uint64_t sent_ = 0;
+    uint64_t matched_ = 0;
+    uint64_t diverged_ = 0;
+    uint64_t first_divergence_ = 0;
+};
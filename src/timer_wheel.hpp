@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include "slow_clock.hpp"
+
+// Temporizador intrusivo: fica embutido no objeto dono (ex.: uma sessão) e é encadeado
+// diretamente nos slots da roda, sem alocação ao ser armado ou cancelado.
+struct TimerNode {
+    std::function<void(TimePoint)> on_expire;
+
+    bool armed() const { return next_ != nullptr; }
+    TimePoint deadline() const { return deadline_; }
+
+private:
+    friend class TimerWheel;
+    TimerNode* prev_ = nullptr;
+    TimerNode* next_ = nullptr;
+    uint64_t expires_ = 0; // em ticks
+    TimePoint deadline_{};
+};
+
+// Roda de temporização hierárquica (4 níveis de 256 slots).
+//
+// O nível 0 tem resolução de um tick (1 ms por padrão) e cobre os próximos 256 ticks; cada
+// nível acima cobre 256 vezes mais. Temporizadores distantes descem de nível ("cascata") à
+// medida que o tempo avança. Armar, cancelar e disparar são O(1).
+class TimerWheel {
+public:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 8;
+    static constexpr uint64_t SLOTS = 1u << SLOT_BITS;
+    static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+
+    explicit TimerWheel(TimePoint start, Duration tick = std::chrono::milliseconds(1))
+        : origin_(start), tick_(tick) {
+        for (auto& level : wheel_) {
+            for (auto& head : level) head.prev_ = head.next_ = &head;
+        }
+    }
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // Arma (ou rearma) o temporizador para disparar em 'deadline'.
+    void schedule(TimerNode& t, TimePoint deadline) {
+        if (t.armed()) unlink(t);
+        t.deadline_ = deadline;
+        // Arredonda para cima: um temporizador nunca dispara antes do prazo.
+        Duration since = deadline - origin_;
+        uint64_t ticks = since <= Duration::zero() ? 0 : static_cast<uint64_t>((since + tick_ - Duration(1)) / tick_);
+        t.expires_ = ticks;
+        insert(t);
+        ++count_;
+    }
+
+    void cancel(TimerNode& t) {
+        if (!t.armed()) return;
+        unlink(t);
+        --count_;
+    }
+
+    size_t size() const { return count_; }
+
+    // Dispara todos os temporizadores vencidos até 'now'. Retorna quantos dispararam.
+    size_t advance(TimePoint now) {
+        uint64_t target = tick_of(now);
+        size_t fired = 0;
+        while (current_ < target) {
+            if (count_ == 0) {
+                current_ = target;
+                break;
+            }
+            ++current_;
+            // Ao completar uma volta de um nível, redistribui o slot correspondente do nível acima.
+            for (int level = 1; level < LEVELS; ++level) {
+                if ((current_ & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) != 0) break;
+                cascade(level);
+            }
+            fired += fire_slot(wheel_[0][current_ & SLOT_MASK], now);
+        }
+        return fired;
+    }
+
+    // Tempo até o próximo evento da roda (disparo ou cascata), ou nullopt se estiver vazia.
+    std::optional<Duration> next_timeout(TimePoint now) const {
+        if (count_ == 0) return std::nullopt;
+        uint64_t next_tick = current_ + SLOTS - (current_ & SLOT_MASK);
+        for (uint64_t t = current_ + 1; t <= current_ + SLOTS; ++t) {
+            const TimerNode& head = wheel_[0][t & SLOT_MASK];
+            if (head.next_ != &head) {
+                next_tick = t;
+                break;
+            }
+            if ((t & SLOT_MASK) == 0) {
+                next_tick = t;
+                break;
+            }
+        }
+        Duration d = origin_ + tick_ * static_cast<int64_t>(next_tick) - now;
+        return d < Duration::zero() ? Duration::zero() : d;
+    }
+
+private:
+    uint64_t tick_of(TimePoint tp) const {
+        Duration since = tp - origin_;
+        return since <= Duration::zero() ? 0 : static_cast<uint64_t>(since / tick_);
+    }
+
+    void insert(TimerNode& t) {
+        uint64_t expires = t.expires_ <= current_ ? current_ + 1 : t.expires_;
+        uint64_t delta = expires - current_;
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) ++level;
+        if (level == LEVELS - 1) {
+            // Além do alcance da roda: fica no último nível e é reavaliado a cada cascata.
+            uint64_t max_delta = (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+            if (delta > max_delta) expires = current_ + max_delta;
+        }
+        TimerNode& head = wheel_[level][(expires >> (SLOT_BITS * level)) & SLOT_MASK];
+        t.prev_ = head.prev_;
+        t.next_ = &head;
+        head.prev_->next_ = &t;
+        head.prev_ = &t;
+    }
+
+    static void unlink(TimerNode& t) {
+        t.prev_->next_ = t.next_;
+        t.next_->prev_ = t.prev_;
+        t.prev_ = t.next_ = nullptr;
+    }
+
+    void cascade(int level) {
+        TimerNode& head = wheel_[level][(current_ >> (SLOT_BITS * level)) & SLOT_MASK];
+        TimerNode* n = head.next_;
+        head.prev_ = head.next_ = &head;
+        while (n != &head) {
+            TimerNode* next = n->next_;
+            n->prev_ = n->next_ = nullptr;
+            insert(*n);
+            n = next;
+        }
+    }
+
+    size_t fire_slot(TimerNode& head, TimePoint now) {
+        size_t fired = 0;
+        // Retira um nó por vez: o callback pode armar ou cancelar outros temporizadores.
+        while (head.next_ != &head) {
+            TimerNode* n = head.next_;
+            if (n->expires_ > current_) {
+                // Caiu neste slot pelo limite de alcance; volta para a roda.
+                unlink(*n);
+                insert(*n);
+                continue;
+            }
+            unlink(*n);
+            --count_;
+            ++fired;
+            if (n->on_expire) n->on_expire(now);
+        }
+        return fired;
+    }
+
+    TimerNode wheel_[LEVELS][SLOTS];
+    TimePoint origin_;
+    Duration tick_;
+    uint64_t current_ = 0;
+    size_t count_ = 0;
+};
@@ -0,0 +1,364 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "metrics.hpp"
+#include "mpsc_queue.hpp"
+#include "peripheral_engine.hpp"
+#include "session_cache.hpp"
+#include "slow_trace.hpp"
+
+struct WorkerPoolConfig {
+    size_t workers = 1;
+    bool pin_threads = true;        // fixa cada worker em um núcleo
+    IOBackend backend = IOBackend::Auto;
+    SessionConfig session;
+    size_t command_queue_capacity = 4096;
+    // Cache para o Revive (compartilhado entre os workers); nullptr desliga o recurso.
+    SessionCache* session_cache = nullptr;
+    // Métricas detalhadas (contadores e histogramas por worker); nullptr desliga o recurso.
+    MetricsRegistry* metrics = nullptr;
+    // Grava um trace dos datagramas de cada worker (slow_trace.hpp), com sufixo ".N" se houver
+    // mais de um; vazio desliga o recurso.
+    std::string record_path;
+    // Chamado na thread do worker a cada mensagem confirmada pelo central.
+    std::function<void(size_t worker, uint64_t key, size_t bytes, Duration latency)> on_message_acked;
+    // Chamado na thread do worker a cada mensagem recebida do central (visão válida só na chamada).
+    std::function<void(size_t worker, uint64_t key, ByteSpan message)> on_message_received;
+};
+
+// Contadores de um worker, escritos só pela thread dele e lidos por qualquer uma.
+struct alignas(64) WorkerStats {
+    std::atomic<uint64_t> sessions_opened{0};
+    std::atomic<uint64_t> sessions_established{0};
+    std::atomic<uint64_t> sessions_revived{0};     // estabelecidas por Revive, sem handshake
+    std::atomic<uint64_t> revives_rejected{0};     // Revive recusado, seguido de handshake
+    std::atomic<uint64_t> sessions_finished{0};
+    std::atomic<uint64_t> sessions_failed{0};
+    std::atomic<uint64_t> messages_acked{0};
+    std::atomic<uint64_t> bytes_acked{0};
+    std::atomic<uint64_t> retransmits{0};   // somados quando a sessão termina
+    std::atomic<uint64_t> fast_retransmits{0}; // parte delas disparada por ACKs duplicados
+    std::atomic<uint64_t> messages_received{0};
+    std::atomic<uint64_t> bytes_received{0};
+};
+
+// --- Pool de workers: um laço de eventos por núcleo ---
+//
+// Cada worker é uma thread com o seu próprio socket UDP, o seu próprio PeripheralEngine (tabela
+// de sessões, roda de temporização e buffers) e, opcionalmente, fixada em um núcleo. As sessões
+// são identificadas por uma chave escolhida pela aplicação e distribuídas pelo hash dessa chave,
+// então cada sessão vive a vida toda em um único worker e o caminho de cada pacote não toca em
+// nenhum estado compartilhado. A única comunicação entre threads são os comandos (abrir, enviar,
+// fechar), que chegam por uma fila lock-free e acordam o worker por um eventfd.
+class WorkerPool {
+public:
+    WorkerPool(const sockaddr* central, socklen_t central_len, const WorkerPoolConfig& cfg)
+        : cfg_(cfg), central_len_(central_len) {
+        if (cfg_.workers == 0) cfg_.workers = 1;
+        std::memcpy(&central_, central, central_len);
+        for (size_t i = 0; i < cfg_.workers; ++i) {
+            workers_.push_back(std::make_unique<Worker>(*this, i));
+        }
+    }
+
+    ~WorkerPool() { stop(); }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void start() {
+        for (auto& w : workers_) w->start();
+    }
+
+    void stop() {
+        for (auto& w : workers_) w->stop();
+    }
+
+    // As operações abaixo podem ser chamadas de qualquer thread. Retornam false se a fila de
+    // comandos do worker dono da sessão estiver cheia.
+    bool open(uint64_t key) { return submit({Command::Open, key, nullptr}); }
+    bool send(uint64_t key, std::vector<uint8_t> message) {
+        return submit({Command::Send, key, std::make_unique<MemorySource>(std::move(message))});
+    }
+    // A fonte é lida pela thread do worker dono da sessão.
+    bool send(uint64_t key, std::unique_ptr<PayloadSource> source) {
+        return submit({Command::Send, key, std::move(source)});
+    }
+    bool close(uint64_t key) { return submit({Command::Close, key, nullptr}); }
+
+    size_t worker_of(uint64_t key) const {
+        // Mistura os bits da chave para não depender de como a aplicação as numera.
+        uint64_t h = key * 0x9E3779B97F4A7C15ULL;
+        return static_cast<size_t>((h >> 32) % workers_.size());
+    }
+
+    size_t worker_count() const { return workers_.size(); }
+    const WorkerStats& stats(size_t worker) const { return workers_[worker]->stats; }
+
+    uint64_t total(std::atomic<uint64_t> WorkerStats::*field) const {
+        uint64_t sum = 0;
+        for (const auto& w : workers_) sum += (w->stats.*field).load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    // Espera até todas as sessões abertas terminarem (ou 'timeout' passar).
+    bool wait_all_finished(Duration timeout) {
+        TimePoint deadline = SlowClock::now() + timeout;
+        for (;;) {
+            bool done = true;
+            for (const auto& w : workers_) {
+                if (w->dead()) continue;
+                if (w->stats.sessions_finished.load(std::memory_order_acquire)
+                    < w->submitted_opens.load(std::memory_order_acquire)) {
+                    done = false;
+                    break;
+                }
+            }
+            if (done) return true;
+            if (SlowClock::now() >= deadline) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+private:
+    struct Command {
+        enum Op : uint8_t { Open, Send, Close } op;
+        uint64_t key;
+        std::unique_ptr<PayloadSource> source;
+    };
+
+    class Worker {
+    public:
+        Worker(WorkerPool& pool, size_t index)
+            : pool_(pool), index_(index), commands_(pool.cfg_.command_queue_capacity) {
+            // Socket próprio, em porta efêmera própria: as respostas do central voltam direto
+            // para o worker que enviou, sem passar por nenhuma outra thread. Criado aqui para que
+            // a falha apareça na construção do pool, e não numa thread que ninguém observa.
+            sock_ = socket(pool.central_.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+            if (sock_ < 0) throw std::runtime_error(std::string("socket falhou: ") + std::strerror(errno));
+            wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (wake_fd_ < 0) {
+                ::close(sock_);
+                throw std::runtime_error("eventfd falhou");
+            }
+            if (MetricsRegistry* registry = pool.cfg_.metrics) {
+                metrics_ = &registry->register_thread("worker-" + std::to_string(index));
+            }
+        }
+
+        ~Worker() {
+            stop();
+            ::close(wake_fd_);
+            if (sock_ >= 0) ::close(sock_);
+        }
+
+        void start() {
+            running_.store(true);
+            thread_ = std::thread([this] { run(); });
+        }
+
+        void stop() {
+            if (!thread_.joinable()) return;
+            running_.store(false);
+            wake();
+            thread_.join();
+        }
+
+        bool dead() const { return dead_.load(std::memory_order_acquire); }
+
+        bool submit(Command&& cmd) {
+            if (dead_.load(std::memory_order_acquire)) return false;
+            bool is_open = cmd.op == Command::Open;
+            if (!commands_.try_push(std::move(cmd))) return false;
+            if (is_open) submitted_opens.fetch_add(1, std::memory_order_release);
+            wake();
+            return true;
+        }
+
+        WorkerStats stats;
+        std::atomic<uint64_t> submitted_opens{0};
+
+    private:
+        void wake() {
+            uint64_t one = 1;
+            ssize_t r = ::write(wake_fd_, &one, sizeof(one));
+            (void)r;
+        }
+
+        void pin() {
+            unsigned cpus = std::thread::hardware_concurrency();
+            if (!pool_.cfg_.pin_threads || cpus == 0) return;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(index_ % cpus, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+
+        void run() {
+            pin();
+            // O engine (e os seus buffers) nasce na thread já fixada no núcleo. Se não puder ser
+            // criado, o worker fica morto: recusa novos comandos, conta como falhas as sessões que
+            // já estavam na fila e deixa de ser esperado por wait_all_finished.
+            std::unique_ptr<PeripheralEngine> owned;
+            try {
+                owned = std::make_unique<PeripheralEngine>(sock_, reinterpret_cast<const sockaddr*>(&pool_.central_),
+                                                           pool_.central_len_, pool_.cfg_.backend);
+                sock_ = -1; // agora é do engine
+                if (!pool_.cfg_.record_path.empty()) {
+                    std::string path = pool_.cfg_.record_path;
+                    if (pool_.cfg_.workers > 1) path += "." + std::to_string(index_);
+                    auto writer = std::make_shared<TraceWriter>(path, SlowClock::now());
+                    owned->wrap_io([writer](std::unique_ptr<DatagramIO> io) {
+                        return std::make_unique<RecordingIO>(std::move(io), writer);
+                    });
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "worker-" << index_ << ": " << e.what() << std::endl;
+                dead_.store(true, std::memory_order_release);
+                fail_queued_opens();
+                return;
+            }
+            PeripheralEngine& engine = *owned;
+            engine_ = &engine;
+            engine.set_metrics(metrics_);
+            engine.watch_fd(wake_fd_, [this] { drain_commands(); });
+
+            while (running_.load(std::memory_order_relaxed)) {
+                engine.run_once(std::chrono::milliseconds(100));
+                reap_finished();
+            }
+            drain_commands();
+            engine_ = nullptr;
+        }
+
+        void drain_commands() {
+            uint64_t counter;
+            while (::read(wake_fd_, &counter, sizeof(counter)) > 0) {}
+            TimePoint now = SlowClock::now();
+            while (auto cmd = commands_.try_pop()) {
+                if (!engine_) continue;
+                apply(*cmd, now);
+            }
+        }
+
+        void fail_queued_opens() {
+            while (auto cmd = commands_.try_pop()) {
+                if (cmd->op == Command::Open) stats.sessions_failed.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void apply(Command& cmd, TimePoint now) {
+            if (cmd.op == Command::Open) {
+                if (sessions_.count(cmd.key)) {
+                    // Chave já aberta: o open não cria sessão nem vai terminar uma.
+                    submitted_opens.fetch_sub(1, std::memory_order_release);
+                    return;
+                }
+                SlowSession& s = engine_->create_session(pool_.cfg_.session);
+                s.callbacks.on_established = [this](SlowSession& est) {
+                    stats.sessions_established.fetch_add(1, std::memory_order_relaxed);
+                    if (est.revived()) stats.sessions_revived.fetch_add(1, std::memory_order_relaxed);
+                    if (est.revive_rejected()) stats.revives_rejected.fetch_add(1, std::memory_order_relaxed);
+                };
+                s.callbacks.on_message_sent = [this, key = cmd.key](SlowSession&, size_t bytes, Duration latency) {
+                    stats.messages_acked.fetch_add(1, std::memory_order_relaxed);
+                    stats.bytes_acked.fetch_add(bytes, std::memory_order_relaxed);
+                    if (pool_.cfg_.on_message_acked) pool_.cfg_.on_message_acked(index_, key, bytes, latency);
+                };
+                s.callbacks.on_message_received = [this, key = cmd.key](SlowSession&, ByteSpan message) {
+                    stats.messages_received.fetch_add(1, std::memory_order_relaxed);
+                    stats.bytes_received.fetch_add(message.size(), std::memory_order_relaxed);
+                    if (pool_.cfg_.on_message_received) pool_.cfg_.on_message_received(index_, key, message);
+                };
+                s.callbacks.on_closed = [this, key = cmd.key](SlowSession& closed) {
+                    if (closed.state() != SessionState::Closed) {
+                        stats.sessions_failed.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    stats.retransmits.fetch_add(closed.retransmissions(), std::memory_order_relaxed);
+                    stats.fast_retransmits.fetch_add(closed.fast_retransmissions(), std::memory_order_relaxed);
+                    if (SessionCache* cache = pool_.cfg_.session_cache) {
+                        if (auto entry = closed.resumption()) cache->store(pool_.cache_key(key), *entry);
+                    }
+                    finished_keys_.push_back(key);
+                    stats.sessions_finished.fetch_add(1, std::memory_order_release);
+                };
+                sessions_.emplace(cmd.key, &s);
+                stats.sessions_opened.fetch_add(1, std::memory_order_relaxed);
+                if (SessionCache* cache = pool_.cfg_.session_cache) {
+                    if (auto entry = cache->take(pool_.cache_key(cmd.key))) {
+                        // O Revive leva o primeiro fragmento: a conexão espera o primeiro send (ou
+                        // o close), que pode ainda não ter chegado à fila de comandos.
+                        s.resume_from(*entry);
+                        awaiting_data_.insert(cmd.key);
+                        return;
+                    }
+                }
+                engine_->connect(s);
+                return;
+            }
+
+            auto it = sessions_.find(cmd.key);
+            if (it == sessions_.end()) return;
+            SlowSession& s = *it->second;
+            if (cmd.op == Command::Send) s.send(std::move(cmd.source), now);
+            if (awaiting_data_.erase(cmd.key)) engine_->connect(s);
+            if (cmd.op == Command::Close) s.close(now);
+        }
+
+        // Sessões encerradas saem da tabela fora dos callbacks, quando é seguro destruí-las.
+        void reap_finished() {
+            for (uint64_t key : finished_keys_) {
+                auto it = sessions_.find(key);
+                if (it == sessions_.end()) continue;
+                engine_->release(*it->second);
+                sessions_.erase(it);
+            }
+            finished_keys_.clear();
+        }
+
+        WorkerPool& pool_;
+        size_t index_;
+        MpscQueue<Command> commands_;
+        int sock_ = -1;       // até ser entregue ao engine
+        int wake_fd_ = -1;
+        std::atomic<bool> running_{false};
+        std::atomic<bool> dead_{false};
+        std::thread thread_;
+        PeripheralEngine* engine_ = nullptr;
+        ThreadMetrics* metrics_ = nullptr;
+        std::unordered_map<uint64_t, SlowSession*> sessions_;
+        std::unordered_set<uint64_t> awaiting_data_; // abertas para Revive, ainda sem dados
+        std::vector<uint64_t> finished_keys_;
+    };
+
+    bool submit(Command&& cmd) {
+        return workers_[worker_of(cmd.key)]->submit(std::move(cmd));
+    }
+
+    std::string cache_key(uint64_t key) const {
+        return SessionCache::key_for(reinterpret_cast<const sockaddr*>(&central_), central_len_, key);
+    }
+
+    WorkerPoolConfig cfg_;
+    sockaddr_storage central_{};
+    socklen_t central_len_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+};
@@ -0,0 +1,120 @@
+/**
+ * Verificação do Reassembler com sequências de fragmentos que já causaram problemas. Cada
+ * caso alimenta os fragmentos em ordem e confere o resultado de cada um, as mensagens entregues
+ * e, ao final, que nada ficou retido (bytes em 'buffered' ou janela reduzida).
+ *
+ * Qualquer divergência encerra o programa com erro.
+ *
+ * Uso: slow_reassembly_check
+ */
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "../src/reassembly.hpp"
+
+using Result = Reassembler::Result;
+
+struct Fragment {
+    uint32_t seqnum;
+    uint8_t fid;
+    uint8_t fo;
+    bool more;
+    size_t len;
+    Result expected;
+};
+
+static const char* result_name(Result r) {
+    switch (r) {
+        case Result::Accepted:    return "Accepted";
+        case Result::Duplicate:   return "Duplicate";
+        case Result::OutOfWindow: return "OutOfWindow";
+        case Result::Malformed:   return "Malformed";
+    }
+    return "?";
+}
+
+// Roda um caso a partir de rcv_next = 1 e confere as entregas (tamanho de cada mensagem).
+static bool run_case(const char* name, const std::vector<Fragment>& fragments, const std::vector<size_t>& delivered_sizes,
+                     uint32_t final_rcv_next) {
+    Reassembler r;
+    r.reset(1);
+    uint16_t full_window = r.window();
+    std::vector<uint8_t> payload(SLOW_MAX_DATA_SIZE, 0xAB);
+    std::vector<size_t> delivered;
+    bool ok = true;
+
+    for (const Fragment& f : fragments) {
+        SLOWPacketView pkt;
+        pkt.seqnum = f.seqnum;
+        pkt.fid = f.fid;
+        pkt.fo = f.fo;
+        pkt.flags = f.more ? FLAG_MORE_BITS : 0;
+        pkt.data = ByteSpan(payload.data(), f.len);
+        Result got = r.on_fragment(pkt, [&](ByteSpan msg) { delivered.push_back(msg.size()); });
+        if (got != f.expected) {
+            std::cerr << "[" << name << "] seqnum " << f.seqnum << " (fid " << int(f.fid) << ", fo " << int(f.fo)
+                      << "): " << result_name(got) << ", esperado " << result_name(f.expected) << std::endl;
+            ok = false;
+        }
+    }
+
+    if (delivered != delivered_sizes) {
+        std::cerr << "[" << name << "] " << delivered.size() << " mensagem(ns) entregue(s), esperado "
+                  << delivered_sizes.size() << std::endl;
+        ok = false;
+    }
+    if (r.rcv_next() != final_rcv_next) {
+        std::cerr << "[" << name << "] rcv_next " << r.rcv_next() << ", esperado " << final_rcv_next << std::endl;
+        ok = false;
+    }
+    if (r.buffered() != 0 || r.window() != full_window) {
+        std::cerr << "[" << name << "] " << r.buffered() << " bytes retidos, janela " << r.window() << " de "
+                  << full_window << std::endl;
+        ok = false;
+    }
+    std::cout << (ok ? "ok    " : "FALHA ") << name << std::endl;
+    return ok;
+}
+
+int main() {
+    constexpr size_t MAX = SLOW_MAX_DATA_SIZE;
+    bool ok = true;
+
+    // fid 0 com fo 0,1,2 e uma duplicata do fo 0 em outro seqnum: a mensagem é descartada e o
+    // resto dela (fo 2) não pode abrir outra mensagem, que nunca se completaria.
+    ok &= run_case("fo duplicado no meio da mensagem",
+                   {{1, 0, 0, true, MAX, Result::Accepted},
+                    {2, 0, 1, true, MAX, Result::Accepted},
+                    {3, 0, 0, true, MAX, Result::Malformed},
+                    {4, 0, 2, false, 100, Result::Malformed},
+                    {5, 1, 0, false, 10, Result::Accepted}},
+                   {10}, 6);
+
+    // O resto chega antes da duplicata, fora de ordem: o fo 2 fica retido até o descarte.
+    ok &= run_case("resto fora de ordem",
+                   {{1, 0, 0, true, MAX, Result::Accepted},
+                    {4, 0, 2, true, MAX, Result::Accepted},
+                    {3, 0, 0, true, MAX, Result::Malformed},
+                    {5, 0, 3, false, 50, Result::Malformed},
+                    {2, 0, 1, true, MAX, Result::Malformed},
+                    {6, 1, 0, false, 20, Result::Accepted}},
+                   {20}, 7);
+
+    // Depois de 256 mensagens o fid 0 volta: a mensagem nova não pode cair na faixa descartada.
+    std::vector<Fragment> wrap = {{1, 0, 0, false, 10, Result::Accepted},
+                                  {2, 1, 0, true, MAX, Result::Accepted},
+                                  {3, 1, 0, false, 5, Result::Malformed}};
+    std::vector<size_t> wrap_sizes = {10};
+    for (uint32_t i = 2; i < 256; ++i) {
+        wrap.push_back({i + 2, static_cast<uint8_t>(i), 0, false, 1, Result::Accepted});
+        wrap_sizes.push_back(1);
+    }
+    wrap.push_back({258, 0, 0, false, 30, Result::Accepted});
+    wrap.push_back({259, 1, 0, false, 40, Result::Accepted});
+    wrap_sizes.push_back(30);
+    wrap_sizes.push_back(40);
+    ok &= run_case("fid reutilizado após o descarte", wrap, wrap_sizes, 260);
+
+    return ok ? 0 : 1;
+}